@@ -0,0 +1,346 @@
+/*
+ * async_io.hpp for BWT Tunneling
+ * Copyright (c) 2020 Uwe Baier All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ASYNC_IO_HPP
+#define ASYNC_IO_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <ios>
+#include <mutex>
+#include <ostream>
+#include <stdint.h>
+#include <streambuf>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//! a stream buffer reading ahead from another stream buffer in a background thread.
+/*! the source is read sequentially in chunks, such that reading the next chunks
+   overlaps with the computation on the current one. Seeking outside of the current
+   chunk discards all chunks read ahead and restarts reading at the new position.
+ */
+class async_input_buf : public std::streambuf {
+	private:
+		typedef std::chrono::high_resolution_clock timer;
+
+		std::streambuf *m_src;
+		const size_t m_chunk_size;
+		const size_t m_max_chunks; //maximal number of chunks read ahead
+		std::vector<char> m_cur; //chunk currently read from
+		uint64_t m_pos = 0; //position of the current chunk in the source
+		std::chrono::nanoseconds m_stall{ 0 };
+
+		//state shared with the reading thread
+		std::deque<std::vector<char>> m_ready;
+		bool m_eof = false;
+		bool m_stop = false;
+		std::exception_ptr m_error;
+		std::mutex m_mtx;
+		std::condition_variable m_cv;
+		std::thread m_reader;
+
+		void read_loop() {
+			for (;;) {
+				std::vector<char> chunk( m_chunk_size );
+				std::streamsize cnt = 0;
+				std::exception_ptr error;
+				try {
+					cnt = m_src->sgetn( chunk.data(), chunk.size() );
+				} catch (...) {
+					error = std::current_exception();
+				}
+				chunk.resize( cnt );
+
+				std::unique_lock<std::mutex> lock( m_mtx );
+				m_cv.wait( lock, [this]() { return m_stop || m_ready.size() < m_max_chunks; } );
+				if (m_stop)	return;
+				if (cnt != 0)	m_ready.push_back( std::move( chunk ) );
+				if (cnt == 0 || error) {
+					m_error = error;
+					m_eof = true;
+				}
+				m_cv.notify_all();
+				if (m_eof)	return;
+			}
+		};
+
+		//stops reading ahead and discards all chunks read so far
+		void stop() {
+			{
+				std::lock_guard<std::mutex> lock( m_mtx );
+				m_stop = true;
+			}
+			m_cv.notify_all();
+			if (m_reader.joinable())	m_reader.join();
+			m_ready.clear();
+			m_eof = m_stop = false;
+			m_error = nullptr;
+		};
+	public:
+		//! constructor, expects the source to be read from, the size of a chunk and
+		//! the maximal number of chunks to be read ahead.
+		async_input_buf( std::streambuf *src, size_t chunk_size = 1 << 20, size_t max_chunks = 4 )
+		               : m_src( src ), m_chunk_size( chunk_size ), m_max_chunks( max_chunks ) {
+			auto p = m_src->pubseekoff( 0, std::ios_base::cur, std::ios_base::in );
+			m_pos = (p == std::streampos( -1 )) ? 0 : (uint64_t)(std::streamoff)p;
+			setg( m_cur.data(), m_cur.data(), m_cur.data() );
+		};
+
+		async_input_buf( const async_input_buf & ) = delete;
+		async_input_buf &operator=( const async_input_buf & ) = delete;
+
+		~async_input_buf() {
+			stop();
+		};
+
+		//! returns the time spent waiting for chunks to be read
+		std::chrono::nanoseconds stall_time() const {
+			return m_stall;
+		};
+	protected:
+		virtual int_type underflow() {
+			if (gptr() < egptr())	return traits_type::to_int_type( *gptr() );
+			m_pos += m_cur.size();
+			m_cur.clear();
+			setg( m_cur.data(), m_cur.data(), m_cur.data() );
+			if (!m_reader.joinable()) {
+				m_reader = std::thread( &async_input_buf::read_loop, this );
+			}
+
+			//wait for the next chunk
+			auto start = timer::now();
+			std::unique_lock<std::mutex> lock( m_mtx );
+			m_cv.wait( lock, [this]() { return !m_ready.empty() || m_eof; } );
+			m_stall += timer::now() - start;
+			if (m_ready.empty()) {
+				if (m_error)	std::rethrow_exception( m_error );
+				return traits_type::eof();
+			}
+			m_cur = std::move( m_ready.front() );
+			m_ready.pop_front();
+			m_cv.notify_all();
+			setg( m_cur.data(), m_cur.data(), m_cur.data() + m_cur.size() );
+			return traits_type::to_int_type( *gptr() );
+		};
+
+		virtual pos_type seekoff( off_type off, std::ios_base::seekdir dir,
+		                          std::ios_base::openmode which = std::ios_base::in ) {
+			uint64_t cur = m_pos + (gptr() - eback());
+			if (dir == std::ios_base::beg)	return seekpos( off, which );
+			if (dir == std::ios_base::cur)	return seekpos( cur + off, which );
+
+			//position of the end is only known by the source
+			stop();
+			m_cur.clear();
+			auto p = m_src->pubseekoff( off, dir, which );
+			if (p == pos_type( off_type( -1 ) ))	m_src->pubseekpos( cur, which ); //keep position on errors
+			else					cur = (uint64_t)(off_type)p;
+			m_pos = cur;
+			setg( m_cur.data(), m_cur.data(), m_cur.data() );
+			return p;
+		};
+
+		virtual pos_type seekpos( pos_type pos, std::ios_base::openmode which = std::ios_base::in ) {
+			if (!(which & std::ios_base::in) || pos < 0)	return pos_type( off_type( -1 ) );
+			uint64_t p = (uint64_t)(off_type)pos;
+			if (p >= m_pos && p <= m_pos + m_cur.size()) { //position is in current chunk
+				setg( eback(), eback() + (p - m_pos), egptr() );
+				return pos;
+			}
+			stop();
+			m_cur.clear();
+			auto res = m_src->pubseekpos( pos, which );
+			if (res != pos_type( off_type( -1 ) ))	m_pos = p;
+			else					m_src->pubseekpos( m_pos, which );
+			setg( m_cur.data(), m_cur.data(), m_cur.data() );
+			return res;
+		};
+};
+
+//! a stream buffer writing to another stream buffer in a background thread.
+/*! output is collected in chunks, and full chunks are written behind the computation.
+   Synchronizing (e.g. flushing a stream) and seeking wait until all chunks are written.
+ */
+class async_output_buf : public std::streambuf {
+	private:
+		typedef std::chrono::high_resolution_clock timer;
+
+		std::streambuf *m_dst;
+		const size_t m_chunk_size;
+		const size_t m_max_chunks; //maximal number of chunks waiting to be written
+		std::vector<char> m_cur; //chunk currently written to
+		uint64_t m_pos = 0; //position of the current chunk in the destination
+		std::chrono::nanoseconds m_stall{ 0 };
+
+		//state shared with the writing thread
+		std::deque<std::vector<char>> m_pending;
+		std::vector<std::vector<char>> m_free; //written chunks, which can be reused
+		bool m_writing = false;
+		bool m_stop = false;
+		std::exception_ptr m_error;
+		std::mutex m_mtx;
+		std::condition_variable m_cv;
+		std::thread m_writer;
+
+		void write_loop() {
+			std::unique_lock<std::mutex> lock( m_mtx );
+			for (;;) {
+				m_cv.wait( lock, [this]() { return m_stop || !m_pending.empty(); } );
+				if (m_pending.empty())	return;
+				std::vector<char> chunk = std::move( m_pending.front() );
+				m_pending.pop_front();
+				m_writing = true;
+				lock.unlock();
+
+				std::exception_ptr error;
+				try {
+					if (m_dst->sputn( chunk.data(), chunk.size() ) != (std::streamsize)chunk.size()) {
+						throw std::ios_base::failure("unable to write output");
+					}
+				} catch (...) {
+					error = std::current_exception();
+				}
+
+				lock.lock();
+				if (error && !m_error)	m_error = error;
+				m_free.push_back( std::move( chunk ) );
+				m_writing = false;
+				m_cv.notify_all();
+			}
+		};
+
+		//hands the current chunk over to the writing thread
+		void flush_chunk() {
+			size_t size = pptr() - pbase();
+			if (size == 0)	return;
+			m_cur.resize( size );
+			m_pos += size;
+			if (!m_writer.joinable()) {
+				m_writer = std::thread( &async_output_buf::write_loop, this );
+			}
+
+			auto start = timer::now();
+			std::unique_lock<std::mutex> lock( m_mtx );
+			m_cv.wait( lock, [this]() { return m_pending.size() < m_max_chunks || m_error; } );
+			m_stall += timer::now() - start;
+			if (m_error)	std::rethrow_exception( m_error );
+			m_pending.push_back( std::move( m_cur ) );
+			if (!m_free.empty()) {
+				m_cur = std::move( m_free.back() );
+				m_free.pop_back();
+			} else {
+				m_cur = std::vector<char>();
+			}
+			m_cv.notify_all();
+			lock.unlock();
+
+			m_cur.resize( m_chunk_size );
+			setp( m_cur.data(), m_cur.data() + m_cur.size() );
+		};
+
+		//writes all chunks, and waits until they are written
+		void drain() {
+			flush_chunk();
+			auto start = timer::now();
+			std::unique_lock<std::mutex> lock( m_mtx );
+			m_cv.wait( lock, [this]() { return (m_pending.empty() && !m_writing) || m_error; } );
+			m_stall += timer::now() - start;
+			if (m_error)	std::rethrow_exception( m_error );
+		};
+	public:
+		//! constructor, expects the destination to be written to, the size of a chunk and
+		//! the maximal number of chunks waiting to be written.
+		async_output_buf( std::streambuf *dst, size_t chunk_size = 1 << 20, size_t max_chunks = 4 )
+		                : m_dst( dst ), m_chunk_size( chunk_size ), m_max_chunks( max_chunks ), m_cur( chunk_size ) {
+			auto p = m_dst->pubseekoff( 0, std::ios_base::cur, std::ios_base::out );
+			m_pos = (p == std::streampos( -1 )) ? 0 : (uint64_t)(std::streamoff)p;
+			setp( m_cur.data(), m_cur.data() + m_cur.size() );
+		};
+
+		async_output_buf( const async_output_buf & ) = delete;
+		async_output_buf &operator=( const async_output_buf & ) = delete;
+
+		~async_output_buf() {
+			try {
+				drain();
+			} catch (...) {} //errors are reported on sync only
+			{
+				std::lock_guard<std::mutex> lock( m_mtx );
+				m_stop = true;
+			}
+			m_cv.notify_all();
+			if (m_writer.joinable())	m_writer.join();
+		};
+
+		//! returns the time spent waiting for chunks to be written
+		std::chrono::nanoseconds stall_time() const {
+			return m_stall;
+		};
+	protected:
+		virtual int_type overflow( int_type c ) {
+			flush_chunk();
+			if (!traits_type::eq_int_type( c, traits_type::eof() )) {
+				*pptr() = traits_type::to_char_type( c );
+				pbump( 1 );
+			}
+			return traits_type::not_eof( c );
+		};
+
+		virtual int sync() {
+			drain();
+			return m_dst->pubsync();
+		};
+
+		virtual pos_type seekoff( off_type off, std::ios_base::seekdir dir,
+		                          std::ios_base::openmode which = std::ios_base::out ) {
+			if (dir == std::ios_base::cur && off == 0) { //tell position
+				return pos_type( off_type( m_pos + (pptr() - pbase()) ) );
+			}
+			drain();
+			auto p = m_dst->pubseekoff( off, dir, which );
+			if (p != pos_type( off_type( -1 ) ))	m_pos = (uint64_t)(off_type)p;
+			return p;
+		};
+
+		virtual pos_type seekpos( pos_type pos, std::ios_base::openmode which = std::ios_base::out ) {
+			drain();
+			auto p = m_dst->pubseekpos( pos, which );
+			if (p != pos_type( off_type( -1 ) ))	m_pos = (uint64_t)(off_type)p;
+			return p;
+		};
+};
+
+//! calls f with a stream writing behind to dst, and returns the time waited for writes.
+template<class t_write_fn>
+std::chrono::nanoseconds write_behind( std::streambuf *dst, t_write_fn f ) {
+	async_output_buf buf( dst );
+	std::ostream out( &buf );
+	f( out );
+	out.flush();
+	return buf.stall_time();
+}
+
+#endif
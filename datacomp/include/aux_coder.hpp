@@ -0,0 +1,232 @@
+/*
+ * aux_coder.hpp for BWT Tunneling
+ * Copyright (c) 2020 Uwe Baier All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef AUX_CODER_HPP
+#define AUX_CODER_HPP
+
+#include <istream>
+#include <ostream>
+#include <stdint.h>
+#include <streambuf>
+#include <vector>
+
+#include "bwt_config.hpp"
+
+//! dedicated coder for auxiliary data, where each entry takes one of at most four values.
+/*! each entry is coded with two binary decisions using an adaptive binary
+   arithmetic coder. Three context models predict each decision: one using the
+   two previous entries and the length of the current run of equal entries,
+   one using the four previous entries, and one using the previous entry and a
+   context character provided by the caller (e.g. the run character of the
+   entry). Their predictions are combined by a logistic mixer. The decoder
+   consumes exactly the bytes written by the encoder.
+ */
+class aux_coder {
+	private:
+		static const uint32_t NODES = 3; //binary decisions of the code tree
+		static const uint32_t INPUTS = 3; //number of mixed models
+		static const uint32_t COUNT_LIMIT = 60; //adaption limit of counters
+
+		//adaptive probability of a 1-bit (16 bit precision), adapting fast while it is young
+		struct counter {
+			uint16_t p = 1u << 15;
+			uint16_t n = 0;
+
+			void update( uint32_t bit ) {
+				int32_t target = bit ? 65535 : 0;
+				p += (int32_t)(((int64_t)(target - p) * 2) / (2 * n + 3));
+				if (n < COUNT_LIMIT)	++n;
+			};
+		};
+
+		counter m_run_ctx[64][NODES]; //two previous entries and run length
+		counter m_aux_ctx[256][NODES]; //four previous entries
+		counter m_chr_ctx[256*4][NODES]; //context character and previous entry
+		int32_t m_weights[4][NODES][INPUTS]; //mixer weights (16.16 fixed point), selected by previous entry
+		int32_t m_st[INPUTS]; //stretched predictions of the current decision
+		uint32_t m_pr = 2048; //mixed prediction of the current decision (12 bits)
+		uint32_t m_low = 0;
+		uint32_t m_high = 0xFFFFFFFFu;
+		uint32_t m_code = 0;
+
+		//// LOGISTIC HELPERS ///////////////////////////////////////////
+
+		//returns 4096 / (1 + e^(-d/256)), computed by interpolation
+		static int32_t squash( int32_t d ) {
+			static const int32_t t[33] = { 1, 2, 3, 6, 10, 16, 27, 45, 73, 120, 194, 310, 488, 747, 1101,
+			                               1546, 2047, 2549, 2994, 3348, 3607, 3785, 3901, 3975, 4022,
+			                               4050, 4068, 4079, 4085, 4089, 4092, 4093, 4094 };
+			if (d > 2047)	return 4095;
+			if (d < -2047)	return 1;
+			int32_t w = d & 127;
+			d = (d >> 7) + 16;
+			return (t[d] * (128 - w) + t[d+1] * w + 64) >> 7;
+		};
+
+		//inverse of squash
+		static int32_t stretch( uint32_t p ) {
+			static const std::vector<int16_t> t = []() {
+				std::vector<int16_t> t( 4096 );
+				int32_t pi = 0;
+				for (int32_t x = -2047; x <= 2047; x++) {
+					int32_t v = squash( x );
+					for (int32_t j = pi; j <= v; j++)	t[j] = x;
+					pi = v + 1;
+				}
+				for (int32_t j = pi; j < 4096; j++)	t[j] = 2047;
+				return t;
+			}();
+			return t[p];
+		};
+
+		//// MODELLING //////////////////////////////////////////////////
+
+		//computes the probability of a 1-bit for the given node and contexts
+		uint32_t predict( const uint32_t ctx[INPUTS], uint32_t sel, uint32_t node ) {
+			m_st[0] = stretch( m_run_ctx[ctx[0]][node].p >> 4 );
+			m_st[1] = stretch( m_aux_ctx[ctx[1]][node].p >> 4 );
+			m_st[2] = stretch( m_chr_ctx[ctx[2]][node].p >> 4 );
+			int64_t dot = 0;
+			for (uint32_t i = 0; i < INPUTS; i++)	dot += (int64_t)m_weights[sel][node][i] * m_st[i];
+			int32_t p = squash( (int32_t)(dot >> 16) );
+			m_pr = (p < 1) ? 1 : ((p > 4095) ? 4095 : p);
+			return m_pr;
+		};
+
+		void update( const uint32_t ctx[INPUTS], uint32_t sel, uint32_t node, uint32_t bit ) {
+			int32_t err = ((int32_t)bit << 12) - (int32_t)m_pr;
+			for (uint32_t i = 0; i < INPUTS; i++) {
+				m_weights[sel][node][i] += (m_st[i] * err) >> 12;
+			}
+			m_run_ctx[ctx[0]][node].update( bit );
+			m_aux_ctx[ctx[1]][node].update( bit );
+			m_chr_ctx[ctx[2]][node].update( bit );
+		};
+
+		//// BINARY ARITHMETIC CODING ///////////////////////////////////
+
+		void encode_bit( uint32_t bit, uint32_t p, std::vector<uint8_t> &out ) {
+			uint32_t mid = m_low + (uint32_t)(((uint64_t)(m_high - m_low) * p) >> 12);
+			if (bit)	m_high = mid;
+			else		m_low = mid + 1;
+			while ((m_low ^ m_high) < (1u << 24)) { //shift out equal leading bytes
+				out.push_back( (uint8_t)(m_low >> 24) );
+				m_low <<= 8;
+				m_high = (m_high << 8) | 0xFFu;
+			}
+		};
+
+		uint32_t decode_bit( uint32_t p, std::streambuf *in ) {
+			uint32_t mid = m_low + (uint32_t)(((uint64_t)(m_high - m_low) * p) >> 12);
+			uint32_t bit = (m_code <= mid);
+			if (bit)	m_high = mid;
+			else		m_low = mid + 1;
+			while ((m_low ^ m_high) < (1u << 24)) {
+				m_low <<= 8;
+				m_high = (m_high << 8) | 0xFFu;
+				m_code = (m_code << 8) | (uint8_t)in->sbumpc();
+			}
+			return bit;
+		};
+
+		//// CONTEXT HISTORY ////////////////////////////////////////////
+
+		uint32_t m_hist = 0; //previous entries, 2 bits each
+		uint32_t m_run = 0; //number of repetitions of the previous entry
+
+		aux_coder() {
+			for (uint32_t s = 0; s < 4; s++) {
+				for (uint32_t j = 0; j < NODES; j++) {
+					for (uint32_t i = 0; i < INPUTS; i++)	m_weights[s][j][i] = (1 << 16) / 2;
+				}
+			}
+		};
+
+		//computes the contexts of the next entry, returns the mixer selector
+		uint32_t contexts( uint32_t ch, uint32_t ctx[INPUTS] ) const {
+			uint32_t a1 = m_hist & 3u;
+			ctx[0] = ((m_hist & 15u) << 2) | (m_run < 3 ? m_run : 3);
+			ctx[1] = m_hist & 255u;
+			ctx[2] = (ch << 2) | a1;
+			return a1;
+		};
+
+		void push( uint32_t v ) {
+			m_run = ((m_hist & 3u) == v) ? m_run + 1 : 0;
+			m_hist = (m_hist << 2) | v;
+		};
+
+		static uint32_t context_char( const t_string_t &ctx, uint64_t i ) {
+			return (i < ctx.size()) ? ctx[i] : 0u;
+		};
+	public:
+		//! encodes aux, where entry aux[i] uses context character ctx[i]
+		//! (or 0 if ctx is too short).
+		template<class T>
+		static void encode( const T &aux, const t_string_t &aux_ctx, std::ostream &out ) {
+			if (aux.size() == 0u)	return;
+			aux_coder coder;
+			std::vector<uint8_t> buf;
+			uint32_t ctx[INPUTS];
+			for (uint64_t i = 0; i < aux.size(); i++) {
+				uint32_t v = aux[i] & 3u;
+				uint32_t sel = coder.contexts( context_char( aux_ctx, i ), ctx );
+				uint32_t hi = v >> 1, lo = v & 1u;
+				coder.encode_bit( hi, coder.predict( ctx, sel, 0 ), buf );
+				coder.update( ctx, sel, 0, hi );
+				coder.encode_bit( lo, coder.predict( ctx, sel, 1 + hi ), buf );
+				coder.update( ctx, sel, 1 + hi, lo );
+				coder.push( v );
+			}
+			for (int i = 0; i < 4; i++) { //flush
+				buf.push_back( (uint8_t)(coder.m_low >> 24) );
+				coder.m_low <<= 8;
+			}
+			out.write( (const char *)buf.data(), buf.size() );
+		};
+
+		//! decodes aux (which must have the length of the output), where entry
+		//! aux[i] uses context character ctx[i] (or 0 if ctx is too short).
+		template<class T>
+		static void decode( std::istream &in, T &aux, const t_string_t &aux_ctx ) {
+			if (aux.size() == 0u)	return;
+			aux_coder coder;
+			std::streambuf *sb = in.rdbuf();
+			for (int i = 0; i < 4; i++) {
+				coder.m_code = (coder.m_code << 8) | (uint8_t)sb->sbumpc();
+			}
+			uint32_t ctx[INPUTS];
+			for (uint64_t i = 0; i < aux.size(); i++) {
+				uint32_t sel = coder.contexts( context_char( aux_ctx, i ), ctx );
+				uint32_t hi = coder.decode_bit( coder.predict( ctx, sel, 0 ), sb );
+				coder.update( ctx, sel, 0, hi );
+				uint32_t lo = coder.decode_bit( coder.predict( ctx, sel, 1 + hi ), sb );
+				coder.update( ctx, sel, 1 + hi, lo );
+				uint32_t v = (hi << 1) | lo;
+				aux[i] = v;
+				coder.push( v );
+			}
+		};
+};
+
+#endif
@@ -39,6 +39,7 @@
 #include <ostream>
 #include <sstream>
 #include <stdexcept>
+#include <stdint.h>
 #include <string>
 
 //! abstract base class for a block compressor.
@@ -60,6 +61,29 @@ class block_compressor {
 		// decompress function may check itself if output is smaller than maxblocksize.
 		virtual void compress_block( std::istream &in, std::streampos end, std::ostream &out ) const = 0;
 		virtual void decompress_block( std::istream &in, std::streampos end, std::ostream &out ) const = 0;
+		//called before the first block of an input is compressed or decompressed, can be
+		// used to reset state which is carried from block to block.
+		virtual void start_stream() const {};
+		//returns whether blocks can be decompressed without decompressing their predecessors.
+		virtual bool independent_blocks() const { return true; };
+
+		//reads the header of a compressed input, i.e. the end positions of all
+		// blocks in the input stream
+		static std::forward_list<std::streampos> read_block_ends( std::istream &in ) {
+			std::forward_list<std::streampos> blockend;
+			blockend.push_front( read_primitive<std::streamoff>( in ) );
+
+			auto it = blockend.begin();
+			while (in.tellg() != blockend.front()) {
+				auto p = read_primitive<std::streamoff>( in );
+				if (p < *it)
+					throw std::invalid_argument("invalid header end positions");
+
+				it = blockend.insert_after( it, p );
+			}
+			blockend.pop_front();
+			return blockend;
+		};
 
 		//a function to print information during encoding (function will not print
 		// something if compressor is set to be quiet, what is the default)
@@ -123,6 +147,7 @@ class block_compressor {
 			in.seekg(0, std::ios_base::end);
 			std::streamsize n = in.tellg();
 			in.seekg(0, std::ios_base::beg); //jump to start of stream again
+			start_stream();
 
 			//compute block sizes and store the end of each encoding
 			size_t b = n / get_block_size();
@@ -180,20 +205,10 @@ class block_compressor {
 			out.exceptions( std::ostream::badbit );
 
 			//read header
-			std::forward_list<std::streampos> blockend;
-			blockend.push_front( read_primitive<std::streamoff>( in ) );
-
-			auto it = blockend.begin();
-			while (in.tellg() != blockend.front()) {
-				auto p = read_primitive<std::streamoff>( in );
-				if (p < *it)
-					throw std::invalid_argument("invalid header end positions");
-
-				it = blockend.insert_after( it, p );
-			}
+			auto blockend = read_block_ends( in );
 			
 			//decompress each block
-			blockend.pop_front();
+			start_stream();
 			for (auto be : blockend) {
 				decompress_block( in, be, out );
 				if (in.tellg() != be) {
@@ -205,6 +220,48 @@ class block_compressor {
 			out.flush();
 		};
 
+		//! decompresses the characters [from,from+len) of a compressed input.
+		/*! only blocks overlapping this range are decompressed, unless blocks depend on
+		  their predecessors. The block size must be the one used for compression.
+		  Throws the same exceptions as decompress, and an invalid argument exception
+		  if the range exceeds the input.
+		*/
+		void decompress_range( std::istream &in, std::ostream &out, uint64_t from, uint64_t len ) const {
+			//set exception mask of streams
+			in.exceptions( std::istream::badbit | std::istream::eofbit );
+			out.exceptions( std::ostream::badbit );
+
+			auto blockend = read_block_ends( in );
+			start_stream();
+			uint64_t block_start = 0; //position of the current block in the decompressed input
+			uint64_t written = 0;
+			for (auto be : blockend) {
+				if (written == len)	break;
+				uint64_t block_end = block_start + get_block_size();
+				if (block_end <= from && independent_blocks()) {
+					in.seekg( be ); //skip block
+				} else {
+					std::ostringstream block_out;
+					decompress_block( in, be, block_out );
+					if (in.tellg() != be) {
+						throw std::invalid_argument("invalid block decompression");
+					}
+					if (block_end > from) {
+						const std::string block = block_out.str();
+						uint64_t b = from + written - block_start;
+						uint64_t cnt = std::min<uint64_t>( len - written, (b < block.size()) ? block.size() - b : 0 );
+						out.write( block.data() + b, cnt );
+						written += cnt;
+					}
+				}
+				block_start = block_end;
+			}
+			if (written != len) {
+				throw std::invalid_argument("range exceeds the compressed input");
+			}
+			out.flush();
+		};
+
 		//! decompresses a compressed input.
 		/*! function throws a runtime error if decoding failed, an invalid 
 		  argument exception if encoding was manipulated or a stream exception
@@ -29,32 +29,87 @@
 #ifndef BWT_COMPRESSOR_HPP
 #define BWT_COMPRESSOR_HPP
 
+#include "aux_coder.hpp"
 #include "block_compressor.hpp"
 #include "bwt_config.hpp"
+#include "dedup.hpp"
 #include "divsufsort.h"
 #include "twobitvector.hpp"
+#include "working_memory.hpp"
 
 #include <sdsl/util.hpp>
 
 #include <assert.h>
 #include <chrono>
+#include <future>
 #include <ios>
+#include <iterator>
 #include <limits>
 #include <sstream>
 #include <stdexcept>
 #include <stdint.h>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 //! a bwt-based compressor with second stage transform as defined in t_2st_encoder
 template<class tp_strategy, class t_post_stages>
 class bwt_compressor : public block_compressor {
+	private:
+		//working memory, reused from block to block
+		mutable working_memory m_wm;
+		//whether aux is encoded using the dedicated aux coder or the post stages
+		bool m_dedicated_aux = false;
+		//window of the long-range match removal (0 if disabled), and its state
+		uint64_t m_dedup_window = 0;
+		mutable dedup_encoder m_dedup_enc;
+		mutable dedup_decoder m_dedup_dec;
 	public:
 		//! constructor
 		bwt_compressor() : block_compressor( t_max_size ) {};
+
+		//! enables backing of big buffers with transparent huge pages (if supported by the os)
+		void set_huge_pages( bool hp ) {
+			m_wm.set_huge_pages( hp );
+		};
+
+		//! chooses whether aux is encoded using the dedicated aux coder (true)
+		//! or the post stages (false, default).
+		void set_dedicated_aux( bool da ) {
+			m_dedicated_aux = da;
+		};
+
+		//! enables the removal of long-range matches before the bwt, where matches
+		//! may refer up to window characters back, also into previous blocks
+		//! (0 disables match removal, default). Compressor and decompressor
+		//! must use the same window.
+		void set_dedup_window( uint64_t window ) {
+			m_dedup_window = window;
+		};
+
+		//! decodes the tunneled bwt of each block of a compressed input without inverting it.
+		/*! for each block, f( block, blocks, n, tbwt, aux, tbwt_idx ) is called, where block is
+		   the number of the block, blocks the number of all blocks and n the length of the block.
+		   aux is given expanded, i.e. it contains one entry per entry of the tunneled bwt plus
+		   a terminating entry, see tp_strategy::decode_aux. Throws an invalid argument exception if long-range matches
+		   were removed, as the tunneled bwt then does not represent the whole block.
+		 */
+		template<class t_block_fn>
+		void decode_tbwts( std::istream &in, t_block_fn f ) const;
 	protected:
 		virtual void compress_block( std::istream &in, std::streampos end, std::ostream &out ) const;
 		virtual void decompress_block( std::istream &in, std::streampos end, std::ostream &out ) const;
+		virtual void start_stream() const {
+			m_dedup_enc = dedup_encoder( m_dedup_window );
+			m_dedup_dec = dedup_decoder( m_dedup_window );
+		};
+		virtual bool independent_blocks() const {
+			return m_dedup_window == 0; //long-range matches may refer into previous blocks
+		};
+	private:
+		//decodes long-range matches, header, tunneled bwt and (expanded) aux of a block into the
+		// working memory. Returns false if the block consists of long-range matches only.
+		bool decode_block( std::istream &in, std::vector<dedup_match> &matches, t_size_t &n, t_idx_t &tbwt_idx ) const;
 };
 
 //// COMPRESSION //////////////////////////////////////////////////////////////
@@ -76,17 +131,50 @@ void bwt_compressor<tp_strategy,t_post_stages>::compress_block( std::istream &in
 	//get length of input
 	t_size_t n = (t_size_t)(end - in.tellg());
 	assert(n <= t_max_size );
+	auto reused_bytes = m_wm.reused_bytes();
 
 	//read string from input
-	t_string_t S( n );
+	t_string_t &S = m_wm.text;
+	m_wm.prepare( S, n );
 	in.read( (schar_t *)S.data(), n );
 
+	//// REMOVE LONG-RANGE MATCHES ////////////////////////////////////////
+
+	std::vector<dedup_match> matches;
+	if (m_dedup_window != 0) {
+		auto start = timer::now();
+		m_dedup_enc.parse( S, matches );
+		n = S.size();
+		auto stop = timer::now();
+		print_info("dedup_matches", (uint64_t)matches.size() );
+		print_info("dedup_literals", (uint64_t)n );
+		print_info("dedup_time", (uint64_t)duration_cast<milliseconds>( stop - start ).count() );
+
+		write_primitive<t_size_t>( matches.size(), out );
+		for (const dedup_match &m : matches) {
+			write_primitive<t_size_t>( m.lit_len, out );
+			write_primitive<uint64_t>( m.dist, out );
+			write_primitive<t_size_t>( m.len, out );
+		}
+		if (n == 0) { //whole block consists of matches, so there is nothing to transform
+			for (unsigned i = 0; i < 3; i++)	write_primitive<t_size_t>( 0, out );
+			write_primitive<t_idx_t>( 0, out );
+			return;
+		}
+	}
+
 	//// BW-TRANSFORM INPUT ///////////////////////////////////////////////
 
 	auto start = timer::now();
 	saidx_t bwt_idx = 0;
-	if (bw_transform(S.data(), S.data(), NULL, (saidx_t)n, &bwt_idx) < 0) {
-		throw runtime_error( string("BW Transformation failed") );
+	{
+		//use a buffer of the working memory as work space for divsufsort
+		static_assert( sizeof(saidx_t) == sizeof(t_idx_t), "saidx_t and t_idx_t must have the same size" );
+		auto SA = m_wm.acquire( n + 1 );	SA.resize( n + 1 );
+		if (bw_transform(S.data(), S.data(), (saidx_t *)SA.data(), (saidx_t)n, &bwt_idx) < 0) {
+			throw runtime_error( string("BW Transformation failed") );
+		}
+		m_wm.release( std::move( SA ) );
 	}
 	auto stop = timer::now();
 	print_info("bwt_construct_time", (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>( stop - start ).count() );
@@ -95,14 +183,19 @@ void bwt_compressor<tp_strategy,t_post_stages>::compress_block( std::istream &in
 
 	start = timer::now();
 	t_idx_t tbwt_idx = bwt_idx;
-	twobitvector aux;
-	tp_strategy tps( S, bwt_idx );
-	tps.plan();
-	auto costs = tps.plan();
-	print_info("num_tunnels", (uint64_t)costs.first );
-	print_info("exp_tunnelcosts", (uint64_t)( costs.second / 8u) );
-
-	auto benefit = tps.tunnel_bwt( S, aux, tbwt_idx );
+	twobitvector &aux = m_wm.aux;
+	m_wm.prepare_aux( n + 1 );
+	std::pair<t_size_t,t_bitsize_t> benefit;
+	t_string_t aux_ctx;
+	{
+		tp_strategy tps( S, bwt_idx, m_wm );
+		tps.plan();
+		auto costs = tps.plan();
+		print_info("num_tunnels", (uint64_t)costs.first );
+		print_info("exp_tunnelcosts", (uint64_t)( costs.second / 8u) );
+
+		benefit = tps.tunnel_bwt( S, aux, tbwt_idx, aux_ctx );
+	}
 	print_info("num_rle_tc", (uint64_t)benefit.first );
 	print_info("exp_benefit", (uint64_t)( benefit.second / 8u) );
 
@@ -117,16 +210,26 @@ void bwt_compressor<tp_strategy,t_post_stages>::compress_block( std::istream &in
 	write_primitive<t_size_t>( aux.size(), out );
 	write_primitive<t_idx_t>(  tbwt_idx, out );
 
+	//encode aux concurrently to the tunneled bwt, and append it afterwards. Decoding is serial
+	//by design, as the contexts of aux are taken from the decoded tunneled bwt (see decode_block)
+	ostringstream aux_out;
+	auto aux_job = async( launch::async, [this, &aux, &aux_ctx, &aux_out]() {
+		if (m_dedicated_aux)	aux_coder::encode( aux, aux_ctx, aux_out );
+		else			t_post_stages::encode( aux, aux_out );
+	} );
+
 	auto out_pos = out.tellp();
 	t_post_stages::encode( S, out );
 	print_info("size_bwt", (uint64_t)( out.tellp() - out_pos ) );
-	
-	out_pos = out.tellp();
-	t_post_stages::encode( aux, out );
-	print_info("size_aux", (uint64_t)( out.tellp() - out_pos ) );
+
+	aux_job.get();
+	const string aux_enc = aux_out.str();
+	out.write( aux_enc.data(), aux_enc.size() );
+	print_info("size_aux", (uint64_t)aux_enc.size() );
 
 	stop = timer::now();
 	print_info("encoding_time", (uint64_t)duration_cast<milliseconds>( stop - start ).count() );
+	print_info("reused_memory", m_wm.reused_bytes() - reused_bytes );
 }
 
 //// DECOMPRESSION ////////////////////////////////////////////////////////////
@@ -145,10 +248,69 @@ void bwt_compressor<tp_strategy,t_post_stages>::decompress_block( std::istream &
 
 	//// READ INPUT ///////////////////////////////////////////////////////
 	auto start = timer::now();
-	auto n = read_primitive<t_size_t>( in );
+	auto reused_bytes = m_wm.reused_bytes();
+	std::vector<dedup_match> matches;
+	t_size_t n;
+	t_idx_t tbwt_idx;
+	if (!decode_block( in, matches, n, tbwt_idx )) { //whole block consists of matches
+		m_dedup_dec.resolve( nullptr, 0, matches, out );
+		return;
+	}
+	t_string_t &tbwt = m_wm.text;
+	twobitvector &aux = m_wm.aux;
+	auto stop = timer::now();
+	print_info("decoding_time", (uint64_t)duration_cast<milliseconds>( stop - start ).count() );
+
+	//// INVERT TUNNELED BWT //////////////////////////////////////////////
+	start = timer::now();
+	if (m_dedup_window == 0) {
+		tp_strategy::invert_tbwt( tbwt, aux, n, tbwt_idx, m_wm, out );
+	} else {
+		//invert residual literals into the working memory, and resolve long-range matches from there
+		t_string_t &lits = m_wm.output;
+		m_wm.prepare( lits, n );
+		memory_outbuf lit_buf( lits );
+		ostream lit_out( &lit_buf );
+		tp_strategy::invert_tbwt( tbwt, aux, n, tbwt_idx, m_wm, lit_out );
+		if (!lit_out || lit_buf.written() != n) {
+			throw invalid_argument("invalid number of residual literals");
+		}
+		m_dedup_dec.resolve( lits.data(), n, matches, out );
+	}
+	stop = timer::now();
+	print_info("inversion_time", (uint64_t)duration_cast<milliseconds>( stop - start ).count() );
+	print_info("reused_memory", m_wm.reused_bytes() - reused_bytes );
+}
+
+//// DECODING OF TUNNELED BWTS ////////////////////////////////////////////////
+
+template<class tp_strategy, class t_post_stages>
+bool bwt_compressor<tp_strategy,t_post_stages>::decode_block( std::istream &in, std::vector<dedup_match> &matches,
+                                                                t_size_t &n, t_idx_t &tbwt_idx ) const {
+	using namespace std;
+	if (m_dedup_window != 0) {
+		//each match covers at least MIN_MATCH characters of the block. Matches are appended one by one,
+		//so a corrupt count fails at the end of the stream instead of allocating all matches up front
+		auto num_matches = read_primitive<t_size_t>( in );
+		if (num_matches > t_max_size / dedup_encoder::MIN_MATCH) {
+			throw invalid_argument("too many long-range matches");
+		}
+		matches.clear();
+		for (t_size_t k = 0; k < num_matches; k++) {
+			dedup_match m;
+			m.lit_len = read_primitive<t_size_t>( in );
+			m.dist = read_primitive<uint64_t>( in );
+			m.len = read_primitive<t_size_t>( in );
+			if (m.len < dedup_encoder::MIN_MATCH) {
+				throw invalid_argument("long-range match is too short");
+			}
+			matches.push_back( m );
+		}
+	}
+	n = read_primitive<t_size_t>( in );
 	auto tbwt_size = read_primitive<t_size_t>( in );
 	auto aux_size = read_primitive<t_size_t>( in );
-	auto tbwt_idx = read_primitive<t_idx_t>( in );
+	tbwt_idx = read_primitive<t_idx_t>( in );
 	//do some checks
 	if (n > t_max_size) {
 		throw invalid_argument("text(part) is too long to be decoded!");
@@ -159,18 +321,41 @@ void bwt_compressor<tp_strategy,t_post_stages>::decompress_block( std::istream &
 	if (aux_size > tbwt_size+1) {
 		throw invalid_argument("aux size is longer than tbwt size");
 	}
-	t_string_t tbwt; tbwt.resize( tbwt_size );
-	twobitvector aux; aux.resize( aux_size );
+	if (m_dedup_window != 0 && n == 0) {
+		return false;
+	}
+	t_string_t &tbwt = m_wm.text; m_wm.prepare( tbwt, tbwt_size );
+	twobitvector &aux = m_wm.aux; m_wm.prepare_aux( aux_size );
 	t_post_stages::decode( in, tbwt );
-	t_post_stages::decode( in, aux );
-	auto stop = timer::now();
-	print_info("decoding_time", (uint64_t)duration_cast<milliseconds>( stop - start ).count() );
+	tp_strategy::decode_aux( tbwt, tbwt_idx, m_wm, aux, [this, &in, &aux]( const t_string_t &aux_ctx ) {
+		if (m_dedicated_aux)	aux_coder::decode( in, aux, aux_ctx );
+		else			t_post_stages::decode( in, aux );
+	} );
+	return true;
+}
 
-	//// INVERT TUNNELED BWT //////////////////////////////////////////////
-	start = timer::now();
-	tp_strategy::invert_tbwt( std::move(tbwt), std::move(aux), n, tbwt_idx, out );
-	stop = timer::now();
-	print_info("inversion_time", (uint64_t)duration_cast<milliseconds>( stop - start ).count() );
+template<class tp_strategy, class t_post_stages>
+template<class t_block_fn>
+void bwt_compressor<tp_strategy,t_post_stages>::decode_tbwts( std::istream &in, t_block_fn f ) const {
+	if (m_dedup_window != 0) {
+		throw std::invalid_argument("blocks with removed long-range matches can not be decoded to tunneled bwts");
+	}
+	in.exceptions( std::istream::badbit | std::istream::eofbit );
+
+	auto blockend = read_block_ends( in );
+	size_t blocks = std::distance( blockend.begin(), blockend.end() );
+	size_t block = 0;
+	start_stream();
+	std::vector<dedup_match> matches;
+	for (auto be : blockend) {
+		t_size_t n;
+		t_idx_t tbwt_idx;
+		decode_block( in, matches, n, tbwt_idx );
+		if (in.tellg() != be) {
+			throw std::invalid_argument("invalid block decompression");
+		}
+		f( block++, blocks, n, m_wm.text, m_wm.aux, tbwt_idx );
+	}
 }
 
 #endif
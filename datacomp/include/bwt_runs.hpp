@@ -0,0 +1,206 @@
+/*
+ * bwt_runs.hpp for BWT Tunneling
+ * Copyright (c) 2020 Uwe Baier All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BWT_RUNS_HPP
+#define BWT_RUNS_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include <sdsl/bits.hpp>
+
+#include "bwt_config.hpp"
+#include "working_memory.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BWT_RUNS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+//! run boundaries of an indexed BWT, where runs are split at the primary index.
+/*! boundaries are detected in one vectorized pass (AVX2 or SSE2 if supported
+   by the cpu, a word-wise scan otherwise), such that all consumers
+   (run-lf support, rle length and aux transformation) can share them.
+ */
+class bwt_runs {
+	private:
+		typedef void (*scan_fn)( const t_uchar_t *, t_idx_t, t_idx_t, std::vector<t_idx_t> & );
+
+		const t_uchar_t *m_bwt; //underlying bwt
+		std::vector<t_idx_t> m_rs; //start positions of all runs, sorted ascending.
+		                           //additionally, m_rs[runs()] = n holds.
+		t_idx_t m_bwt_idx; //primary index
+		working_memory *m_wm; //working memory to take buffers from (may be null)
+
+		//// SCAN KERNELS /////////////////////////////////////////////
+
+		//appends all positions i in [b,e) where s[i] starts a new run (including b) to rs.
+		static void scan_portable( const t_uchar_t *s, t_idx_t b, t_idx_t e, std::vector<t_idx_t> &rs ) {
+			rs.push_back( b );
+			t_idx_t i = b + 1;
+			//skip equal words of 8 characters at once
+			while (i + 8 <= e) {
+				uint64_t x, y;
+				memcpy( &x, s + i, sizeof(x) );
+				memcpy( &y, s + i - 1, sizeof(y) );
+				if (x != y) {
+					for (t_idx_t j = i; j < i + 8; j++) {
+						if (s[j] != s[j-1])	rs.push_back( j );
+					}
+				}
+				i += 8;
+			}
+			for (; i < e; i++) {
+				if (s[i] != s[i-1])	rs.push_back( i );
+			}
+		};
+
+#ifdef BWT_RUNS_X86_SIMD
+		__attribute__((target("sse2")))
+		static void scan_sse2( const t_uchar_t *s, t_idx_t b, t_idx_t e, std::vector<t_idx_t> &rs ) {
+			rs.push_back( b );
+			t_idx_t i = b + 1;
+			while (i + 16 <= e) {
+				__m128i x = _mm_loadu_si128( (const __m128i *)(s + i) );
+				__m128i y = _mm_loadu_si128( (const __m128i *)(s + i - 1) );
+				uint32_t m = ~(uint32_t)_mm_movemask_epi8( _mm_cmpeq_epi8( x, y ) ) & 0xFFFFu;
+				while (m != 0) { //report each run start
+					rs.push_back( i + __builtin_ctz( m ) );
+					m &= m - 1;
+				}
+				i += 16;
+			}
+			for (; i < e; i++) {
+				if (s[i] != s[i-1])	rs.push_back( i );
+			}
+		};
+
+		__attribute__((target("avx2")))
+		static void scan_avx2( const t_uchar_t *s, t_idx_t b, t_idx_t e, std::vector<t_idx_t> &rs ) {
+			rs.push_back( b );
+			t_idx_t i = b + 1;
+			while (i + 32 <= e) {
+				__m256i x = _mm256_loadu_si256( (const __m256i *)(s + i) );
+				__m256i y = _mm256_loadu_si256( (const __m256i *)(s + i - 1) );
+				uint32_t m = ~(uint32_t)_mm256_movemask_epi8( _mm256_cmpeq_epi8( x, y ) );
+				while (m != 0) { //report each run start
+					rs.push_back( i + __builtin_ctz( m ) );
+					m &= m - 1;
+				}
+				i += 32;
+			}
+			for (; i < e; i++) {
+				if (s[i] != s[i-1])	rs.push_back( i );
+			}
+		};
+#endif
+
+		//chooses the best scan kernel supported by the running cpu
+		static scan_fn choose_scan() {
+#ifdef BWT_RUNS_X86_SIMD
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx2"))	return &scan_avx2;
+			if (__builtin_cpu_supports("sse2"))	return &scan_sse2;
+#endif
+			return &scan_portable;
+		};
+
+	public:
+		//! appends the start positions of all runs in s[b..e) to rs
+		//! using the fastest kernel available.
+		static void scan( const t_uchar_t *s, t_idx_t b, t_idx_t e, std::vector<t_idx_t> &rs ) {
+			static const scan_fn fn = choose_scan();
+			if (b < e)	fn( s, b, e, rs );
+		};
+
+		//! constructor, expects an indexed BWT of length n and its primary index.
+		//! If a working memory is given, the run starts are stored in one of its buffers.
+		bwt_runs( const t_uchar_t *bwt, t_size_t n, t_idx_t idx, working_memory *wm = nullptr )
+		        : m_bwt( bwt ), m_bwt_idx( idx ), m_wm( wm ) {
+			if (m_wm)	m_rs = m_wm->acquire();
+			scan( bwt, 0, idx, m_rs ); //to split runs at primary index
+			scan( bwt, idx, n, m_rs );
+			m_rs.push_back( n );
+		};
+
+		bwt_runs( const bwt_runs & ) = delete;
+		bwt_runs &operator=( const bwt_runs & ) = delete;
+
+		//! destructor, returns buffers to the working memory
+		~bwt_runs() {
+			if (m_wm)	m_wm->release( std::move( m_rs ) );
+		};
+
+		//! length of the bwt
+		t_size_t size() const {
+			return m_rs.back();
+		};
+
+		//! number of runs
+		t_size_t runs() const {
+			return m_rs.size() - 1;
+		};
+
+		//! primary index of the bwt
+		t_idx_t bwt_idx() const {
+			return m_bwt_idx;
+		};
+
+		//! start of a run
+		t_idx_t start( t_idx_t r ) const {
+			return m_rs[r];
+		};
+
+		//! exclusive end of a run
+		t_idx_t end( t_idx_t r ) const {
+			return m_rs[r+1];
+		};
+
+		//! height of a run
+		t_size_t height( t_idx_t r ) const {
+			return m_rs[r+1] - m_rs[r];
+		};
+
+		//! character of a run
+		t_uchar_t character( t_idx_t r ) const {
+			return m_bwt[m_rs[r]];
+		};
+
+		//! computes the length of a run-length encoding of the bwt, where each run
+		//! of length l requires 1 + floor(log2(l)) characters. Runs are not split
+		//! at the primary index for this.
+		t_size_t rle_len() const {
+			t_size_t rle_len = 0;
+			for (t_idx_t r = 0; r < runs(); ) {
+				t_size_t rlen = height( r );
+				while (++r < runs() && character( r ) == character( r-1 )) { //join runs split at primary index
+					rlen += height( r );
+				}
+				rle_len += 1 + sdsl::bits::hi( rlen );
+			}
+			return rle_len;
+		};
+};
+
+#endif
@@ -0,0 +1,242 @@
+/*
+ * dedup.hpp for BWT Tunneling
+ * Copyright (c) 2020 Uwe Baier All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef DEDUP_HPP
+#define DEDUP_HPP
+
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+#include <stdint.h>
+#include <vector>
+
+#include "bwt_config.hpp"
+
+//! a long-range match, i.e. a copy of len characters from dist characters before,
+//! preceded by lit_len literal characters.
+struct dedup_match {
+	t_size_t lit_len;
+	uint64_t dist;
+	t_size_t len;
+};
+
+//! history of the last (at least) window characters of the input, which
+//! can be referenced by long-range matches.
+class dedup_history {
+	private:
+		t_string_t m_buf; //history, m_buf[0] is located at position m_base of the input
+		uint64_t m_base = 0;
+		uint64_t m_window;
+	public:
+		//! constructor, expects the number of characters which must remain referenceable
+		dedup_history( uint64_t window = 0 ) : m_window( window ) {};
+
+		//! returns the size of the window
+		uint64_t window() const {
+			return m_window;
+		};
+
+		//! returns the position of the first character which is still referenceable
+		uint64_t begin() const {
+			uint64_t e = end();
+			return (e - m_base > m_window) ? e - m_window : m_base;
+		};
+
+		//! returns the position behind the last character of the history
+		uint64_t end() const {
+			return m_base + m_buf.size();
+		};
+
+		//! returns the character at position p, which must be in [begin(),end())
+		t_uchar_t operator[]( uint64_t p ) const {
+			return m_buf[p - m_base];
+		};
+
+		//! appends n characters to the history, discarding characters which fell
+		//! out of the window, and returns a pointer to the appended characters,
+		//! which have to be filled by the caller
+		t_uchar_t *extend( uint64_t n ) {
+			if (m_buf.size() > m_window && m_buf.size() + n > 2 * m_window) {
+				uint64_t drop = m_buf.size() - m_window;
+				m_buf.erase( m_buf.begin(), m_buf.begin() + drop );
+				m_base += drop;
+			}
+			m_buf.resize( m_buf.size() + n );
+			return m_buf.data() + m_buf.size() - n;
+		};
+
+		//! appends characters [b,e) to the history, discarding characters
+		//! which fell out of the window
+		void append( const t_uchar_t *b, const t_uchar_t *e ) {
+			std::copy( b, e, extend( e - b ) );
+		};
+
+		//! discards the whole history
+		void clear() {
+			t_string_t().swap( m_buf );
+			m_base = 0;
+		};
+};
+
+//! finds long-range matches in the input using sampled rolling hashes.
+/*! a polynomial rolling hash is computed for each window of HASH_LEN characters,
+   and a sample of those (chosen by the hash value itself, such that repeated
+   contents is sampled at the same places) is stored in a hash table. Samples
+   found in the table are verified and extended into matches, matches shorter
+   than MIN_MATCH are discarded. The table and the history persist from block
+   to block, so matches may refer to previous blocks.
+ */
+class dedup_encoder {
+	public:
+		static const uint64_t MIN_MATCH = 256; //minimal length of a match
+	private:
+		static const uint64_t HASH_LEN = 32; //length of hashed windows
+		static const uint64_t SAMPLE_BITS = 5; //each 2^SAMPLE_BITS-th window is sampled (on average)
+		static const uint64_t MIN_TABLE_BITS = 12;
+		static const uint64_t MAX_TABLE_BITS = 22;
+		static const uint64_t PRIME = 0x100000001B3ull; //base of the rolling hash
+		static const uint64_t MIX = 0x9E3779B97F4A7C15ull; //multiplier to scatter hash values
+
+		dedup_history m_hist;
+		std::vector<uint64_t> m_table; //sampled positions plus one, 0 marks an empty slot
+		uint64_t m_table_bits;
+		uint64_t m_prime_pow; //PRIME^(HASH_LEN-1)
+	public:
+		//! constructor, expects the window in which matches are searched
+		dedup_encoder( uint64_t window = 0 ) : m_hist( window ) {
+			m_table_bits = MIN_TABLE_BITS;
+			while (m_table_bits < MAX_TABLE_BITS && (1ull << (m_table_bits + SAMPLE_BITS)) < window) {
+				++m_table_bits;
+			}
+			m_prime_pow = 1;
+			for (uint64_t i = 1; i < HASH_LEN; i++)	m_prime_pow *= PRIME;
+		};
+
+		//! returns the history of this encoder
+		const dedup_history &history() const {
+			return m_hist;
+		};
+
+		//! forgets all previously seen input
+		void clear() {
+			m_hist.clear();
+			std::vector<uint64_t>().swap( m_table );
+		};
+
+		//! searches long-range matches in block S, and replaces S by the residual literals.
+		/*! matches are appended to matches, the block is appended to the history.
+		 */
+		void parse( t_string_t &S, std::vector<dedup_match> &matches ) {
+			if (m_table.empty())	m_table.resize( 1ull << m_table_bits );
+			const uint64_t n = S.size();
+			const uint64_t p0 = m_hist.end(); //position of S[0] in the input
+			m_hist.append( S.data(), S.data() + n );
+			const uint64_t hbegin = m_hist.begin();
+
+			uint64_t lit = 0; //start of current literal run in S
+			uint64_t w = 0; //end of residual literals written to S
+			uint64_t h = 0;
+			for (uint64_t i = 0; i + HASH_LEN <= n; i++) {
+				//compute rolling hash of S[i..i+HASH_LEN)
+				if (i == 0) {
+					for (uint64_t j = 0; j < HASH_LEN; j++)	h = h * PRIME + m_hist[p0 + j];
+				} else {
+					h = (h - m_prime_pow * m_hist[p0 + i - 1]) * PRIME + m_hist[p0 + i + HASH_LEN - 1];
+				}
+				uint64_t x = h * MIX;
+				if ((x >> (64 - SAMPLE_BITS)) != 0)	continue; //not sampled
+				uint64_t &slot = m_table[(x >> (64 - SAMPLE_BITS - m_table_bits)) & ((1ull << m_table_bits) - 1)];
+				uint64_t c = slot; //candidate plus one
+				slot = p0 + i + 1;
+				if (i < lit || c == 0 || c - 1 < hbegin)	continue;
+
+				//verify and extend candidate
+				uint64_t s = c - 1, t = p0 + i;
+				uint64_t len = 0;
+				while (t + len < p0 + n && m_hist[s + len] == m_hist[t + len])	++len;
+				if (len < HASH_LEN)	continue; //hash collision
+				while (t > p0 + lit && s > hbegin && m_hist[s - 1] == m_hist[t - 1]) {
+					--s; --t; ++len;
+				}
+				if (len < MIN_MATCH)	continue;
+
+				//emit literals and match
+				uint64_t b = t - p0;
+				for (uint64_t j = lit; j < b; j++)	S[w++] = m_hist[p0 + j];
+				matches.push_back( dedup_match{ (t_size_t)(b - lit), t - s, (t_size_t)len } );
+				lit = b + len;
+			}
+			for (uint64_t j = lit; j < n; j++)	S[w++] = m_hist[p0 + j];
+			S.resize( w );
+		};
+};
+
+//! resolves long-range matches found by the dedup_encoder.
+class dedup_decoder {
+	private:
+		dedup_history m_hist;
+	public:
+		//! constructor, expects the window used by the encoder
+		dedup_decoder( uint64_t window = 0 ) : m_hist( window ) {};
+
+		//! forgets all previously seen output
+		void clear() {
+			m_hist.clear();
+		};
+
+		//! reconstructs a block from its residual literals [lits,lits+n) and matches directly
+		//! in the history, and writes it to out. Throws an invalid_argument if a match is invalid.
+		void resolve( const t_uchar_t *lits, uint64_t n, const std::vector<dedup_match> &matches, std::ostream &out ) {
+			typedef typename std::ostream::char_type schar_t;
+
+			//check matches and compute the length of the block before touching the history
+			const uint64_t p0 = m_hist.end();
+			const uint64_t hbegin = m_hist.begin();
+			uint64_t l = 0; //literals consumed
+			uint64_t len = 0; //length of the block
+			for (const dedup_match &m : matches) {
+				if (m.lit_len > n - l)
+					throw std::invalid_argument("dedup literals exceed residual");
+				l += m.lit_len;
+				len += m.lit_len;
+				if (m.dist == 0 || m.dist > p0 + len - hbegin || len + m.len > t_max_size)
+					throw std::invalid_argument("invalid dedup match");
+				len += m.len;
+			}
+			len += n - l;
+
+			//copy literals and matches (which may overlap) into the history
+			t_uchar_t *blk = m_hist.extend( len );
+			t_uchar_t *w = blk;
+			l = 0;
+			for (const dedup_match &m : matches) {
+				w = std::copy( lits + l, lits + l + m.lit_len, w );
+				l += m.lit_len;
+				for (const t_uchar_t *s = w - m.dist, *e = w + m.len; w < e; )	*w++ = *s++;
+			}
+			std::copy( lits + l, lits + n, w );
+			out.write( (const schar_t *)blk, len );
+		};
+};
+
+#endif
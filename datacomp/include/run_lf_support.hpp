@@ -29,6 +29,8 @@
 #include <vector>
 
 #include "bwt_config.hpp"
+#include "bwt_runs.hpp"
+#include "working_memory.hpp"
 
 //! support structure for bwt navigation and bwt run support
 class run_lf_support {
@@ -45,9 +47,27 @@ class run_lf_support {
 		std::vector<t_idx_t> m_rs; //start positions of all runs, sorted ascending.
 		                           //additionally, m_rs[m_runs] = n+1 holds.
 
+		working_memory *m_wm; //working memory to take buffers from (may be null)
+
 	public:
 		//! constructor, expects a indexed BWT and its primary index.
-		run_lf_support( const t_uchar_t *bwt, t_size_t _n, t_idx_t _idx );
+		run_lf_support( const t_uchar_t *bwt, t_size_t _n, t_idx_t _idx )
+		              : run_lf_support( bwt_runs( bwt, _n, _idx ) ) {};
+
+		//! constructor, expects the runs of an indexed BWT. If a working memory
+		//! is given, buffers are taken from it and returned on destruction.
+		run_lf_support( const bwt_runs &runs, working_memory *wm = nullptr );
+
+		run_lf_support( const run_lf_support & ) = delete;
+		run_lf_support &operator=( const run_lf_support & ) = delete;
+
+		//! destructor
+		~run_lf_support() {
+			if (m_wm) {
+				m_wm->release( std::move( m_lfr ) );
+				m_wm->release( std::move( m_rs ) );
+			}
+		};
 
 		//! logical number of runs in BWT
 		const t_size_t &runs = m_runs;
@@ -113,28 +133,18 @@ t_idx_t run_lf_support::run_of( t_idx_t i ) const {
 	return (t_idx_t)(it - m_rs.begin()) - 1;
 }
 
-run_lf_support::run_lf_support( const t_uchar_t *bwt, t_size_t _n, t_idx_t idx ) {
+run_lf_support::run_lf_support( const bwt_runs &runs, working_memory *wm ) : m_wm( wm ) {
 	//init some basic variables
-	m_bwt_idx = idx;
-	m_idx_n = _n;
-	m_idx_runs = 0;
+	m_bwt_idx = runs.bwt_idx();
+	m_idx_n = runs.size();
+	m_idx_runs = runs.runs();
 	m_sigma = 0;
 	m_max_char_val = 0;
 
-	//build C Array and count runs
+	//build C Array using run heights
 	std::vector<t_size_t> C( std::numeric_limits<t_uchar_t>::max() + 1 );
-	t_idx_t borders[] = {bwt_idx,idx_n};
-	t_idx_t i = 0;
-	for (t_idx_t b : borders) { //to split runs at primary index
-		t_uchar_t lastchar = (i < idx_n) ? bwt[i]+1 : 0;
-		while (i < b) {
-			if (lastchar != bwt[i]) { //start of a run
-				++m_idx_runs;
-				lastchar = bwt[i];
-			}
-			++C[lastchar];
-			++i;
-		}
+	for (t_idx_t r = 0; r < idx_runs; r++) {
+		C[runs.character( r )] += runs.height( r );
 	}
 	m_n = idx_n + 1;
 	m_runs = idx_runs + 1; //for bwt index
@@ -152,24 +162,24 @@ run_lf_support::run_lf_support( const t_uchar_t *bwt, t_size_t _n, t_idx_t idx )
 	}
 
 	//compute LF
+	if (m_wm) {
+		m_lfr = m_wm->acquire( m_runs + 1 );
+		m_rs = m_wm->acquire( m_runs + 1 );
+	}
 	m_lfr.reserve( m_runs + 1 );
 	m_rs.reserve( m_runs + 1 );
-	i = 0;
-	t_idx_t i_log = 0; //logical position of i
+	t_idx_t r = 0;
+	t_idx_t shift = 0; //difference between logical and indexed positions
+	t_idx_t borders[] = {bwt_idx,idx_n};
 	for (t_idx_t b : borders) { //to split runs at primary index
-		t_uchar_t lastchar = (i < n) ? bwt[i]+1 : 0;
-		while (i < b) {
-			if (lastchar != bwt[i]) { //start of a run
-				m_rs.push_back( i_log ); //store start of run
-
-				lastchar = bwt[i];
-				m_lfr.push_back( C[lastchar] );
-			}
-			++C[lastchar];
-			++i; ++i_log;
+		while (r < idx_runs && runs.start( r ) < b) {
+			m_rs.push_back( runs.start( r ) + shift ); //store start of run
+			m_lfr.push_back( C[runs.character( r )] );
+			C[runs.character( r )] += runs.height( r );
+			++r;
 		}
 		//add a terminator to both lfr and rs (for both primary index and n)
-		m_rs.push_back( i_log++ );
+		m_rs.push_back( b + shift++ );
 		m_lfr.push_back( 0 );
 	}
 }
@@ -0,0 +1,312 @@
+/*
+ * solid_archive.hpp for BWT Tunneling
+ * Copyright (c) 2020 Uwe Baier All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SOLID_ARCHIVE_HPP
+#define SOLID_ARCHIVE_HPP
+
+#include <algorithm>
+#include <errno.h>
+#include <fstream>
+#include <ios>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <stdint.h>
+#include <streambuf>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "block_compressor.hpp"
+
+//! index of the members of a solid archive, i.e. of files which are
+//! concatenated and compressed as a single input.
+class member_index {
+	public:
+		//! a member of the archive, located at [offset,offset+size) of the concatenation
+		struct member {
+			std::string name;
+			uint64_t size;
+			uint64_t offset;
+		};
+	private:
+		std::vector<member> m_members;
+		uint64_t m_block_size = 0;
+	public:
+		//! returns the members in the order of concatenation
+		const std::vector<member> &members() const {
+			return m_members;
+		};
+
+		//! returns the block size used to compress the archive
+		uint64_t block_size() const {
+			return m_block_size;
+		};
+
+		//! sets the block size used to compress the archive
+		void set_block_size( uint64_t bs ) {
+			m_block_size = bs;
+		};
+
+		//! returns the length of the concatenation of all members
+		uint64_t size() const {
+			return m_members.empty() ? 0 : m_members.back().offset + m_members.back().size;
+		};
+
+		//! appends a member to the archive
+		void add( const std::string &name, uint64_t size ) {
+			m_members.push_back( member{ name, size, this->size() } );
+		};
+
+		//! returns the member with the given name, or nullptr if it does not exist
+		const member *find( const std::string &name ) const {
+			for (const member &m : m_members) {
+				if (m.name == name)	return &m;
+			}
+			return nullptr;
+		};
+
+		//! writes the index to a stream, front-coding member names
+		void serialize( std::ostream &out ) const {
+			block_compressor::write_primitive<uint64_t>( m_block_size, out );
+			block_compressor::write_primitive<uint64_t>( m_members.size(), out );
+			const std::string *last = nullptr;
+			for (const member &m : m_members) {
+				uint32_t lcp = 0; //length of the prefix shared with the previous name
+				if (last != nullptr) {
+					auto mm = std::mismatch( last->begin(), last->begin() + std::min( last->size(), m.name.size() ), m.name.begin() );
+					lcp = mm.second - m.name.begin();
+				}
+				block_compressor::write_primitive<uint32_t>( lcp, out );
+				block_compressor::write_primitive<uint32_t>( m.name.size() - lcp, out );
+				out.write( m.name.data() + lcp, m.name.size() - lcp );
+				block_compressor::write_primitive<uint64_t>( m.size, out );
+				last = &m.name;
+			}
+		};
+
+		//! loads an index written by serialize. Throws an invalid_argument if the index is
+		//! damaged, i.e. if its counts and lengths exceed the rest of the stream.
+		void load( std::istream &in ) {
+			const uint64_t member_bytes = 16; //bytes stored per member besides its name
+			m_members.clear();
+			m_block_size = block_compressor::read_primitive<uint64_t>( in );
+			uint64_t cnt = block_compressor::read_primitive<uint64_t>( in );
+			uint64_t left = bytes_left( in );
+			if (!in || cnt > left / member_bytes) {
+				throw std::invalid_argument("invalid member index");
+			}
+			std::string name;
+			for (uint64_t i = 0; i < cnt; i++) {
+				uint32_t lcp = block_compressor::read_primitive<uint32_t>( in );
+				uint32_t len = block_compressor::read_primitive<uint32_t>( in );
+				left -= member_bytes;
+				if (lcp > name.size() || len > left) {
+					throw std::invalid_argument("invalid member index");
+				}
+				left -= len;
+				name.resize( lcp + len );
+				in.read( &name[lcp], len );
+				add( name, block_compressor::read_primitive<uint64_t>( in ) );
+				if (!in) {
+					throw std::invalid_argument("invalid member index");
+				}
+			}
+		};
+	private:
+		//! returns the number of bytes behind the current position of a stream,
+		//! or the largest possible number if the stream is not seekable
+		static uint64_t bytes_left( std::istream &in ) {
+			uint64_t left = std::numeric_limits<uint64_t>::max();
+			std::streampos cur = in.tellg();
+			if (cur != std::streampos( -1 ) && in.seekg( 0, std::ios::end )) {
+				left = (uint64_t)(std::streamoff)( in.tellg() - cur );
+			}
+			in.clear();
+			in.seekg( cur );
+			return left;
+		};
+};
+
+//! a stream buffer reading the members of an archive as one seekable input.
+class member_input_buf : public std::streambuf {
+	private:
+		const member_index &m_idx;
+		std::vector<char> m_buf;
+		uint64_t m_buf_pos = 0; //position of the buffer in the concatenation
+		size_t m_cur = 0; //member of the currently opened file
+		std::ifstream m_file;
+	public:
+		//! constructor, expects the index of the members to be read
+		member_input_buf( const member_index &idx, size_t buf_size = 1 << 16 )
+		                : m_idx( idx ), m_buf( buf_size ) {
+			m_cur = idx.members().size();
+			setg( m_buf.data(), m_buf.data(), m_buf.data() );
+		};
+	protected:
+		virtual int_type underflow() {
+			const auto &members = m_idx.members();
+			m_buf_pos += egptr() - eback();
+			setg( m_buf.data(), m_buf.data(), m_buf.data() );
+			if (m_buf_pos >= m_idx.size())	return traits_type::eof();
+
+			//find member containing the current position, and open it if required
+			size_t k = std::upper_bound( members.begin(), members.end(), m_buf_pos,
+			                             []( uint64_t p, const member_index::member &m ) { return p < m.offset; }
+			                           ) - members.begin() - 1;
+			const member_index::member &m = members[k];
+			if (k != m_cur) {
+				m_file.close();
+				m_file.clear();
+				m_file.open( m.name, std::ios::in | std::ios::binary );
+				if (!m_file) {
+					throw std::runtime_error("unable to open member \"" + m.name + "\"");
+				}
+				m_cur = k;
+			}
+			m_file.seekg( m_buf_pos - m.offset );
+
+			//fill buffer with the rest of the member
+			uint64_t cnt = std::min<uint64_t>( m_buf.size(), m.offset + m.size - m_buf_pos );
+			m_file.read( m_buf.data(), cnt );
+			if ((uint64_t)m_file.gcount() != cnt) {
+				throw std::runtime_error("member \"" + m.name + "\" changed while reading");
+			}
+			setg( m_buf.data(), m_buf.data(), m_buf.data() + cnt );
+			return traits_type::to_int_type( *gptr() );
+		};
+
+		virtual pos_type seekoff( off_type off, std::ios_base::seekdir dir,
+		                          std::ios_base::openmode which = std::ios_base::in ) {
+			uint64_t cur = m_buf_pos + (gptr() - eback());
+			if (dir == std::ios_base::beg)		return seekpos( off, which );
+			else if (dir == std::ios_base::cur)	return seekpos( cur + off, which );
+			else					return seekpos( m_idx.size() + off, which );
+		};
+
+		virtual pos_type seekpos( pos_type pos, std::ios_base::openmode which = std::ios_base::in ) {
+			if (!(which & std::ios_base::in) || pos < 0 || (uint64_t)pos > m_idx.size()) {
+				return pos_type( off_type( -1 ) );
+			}
+			uint64_t p = (uint64_t)(off_type)pos;
+			if (p >= m_buf_pos && p <= m_buf_pos + (egptr() - eback())) { //position is buffered
+				setg( eback(), eback() + (p - m_buf_pos), egptr() );
+			} else {
+				m_buf_pos = p;
+				setg( m_buf.data(), m_buf.data(), m_buf.data() );
+			}
+			return pos;
+		};
+};
+
+//! a stream buffer splitting its output into the members of an archive,
+//! which are stored as files relative to a directory.
+class member_output_buf : public std::streambuf {
+	private:
+		const member_index &m_idx;
+		std::string m_dir;
+		size_t m_cur = 0; //next member to be opened
+		uint64_t m_left = 0; //characters left to write to the current member
+		std::ofstream m_file;
+
+		//creates all missing directories of a path
+		static void create_dirs( const std::string &path ) {
+			for (size_t p = path.find( '/', 1 ); p != std::string::npos; p = path.find( '/', p + 1 )) {
+				if (mkdir( path.substr( 0, p ).c_str(), 0777 ) != 0 && errno != EEXIST) {
+					throw std::runtime_error("unable to create directory \"" + path.substr( 0, p ) + "\"");
+				}
+			}
+		};
+
+		//closes the current member, throws a runtime_error if it could not be written
+		void close_member() {
+			if (!m_file.is_open())	return;
+			m_file.close();
+			if (!m_file) {
+				throw std::runtime_error("unable to write member \"" + m_idx.members()[m_cur-1].name + "\"");
+			}
+		};
+
+		//closes the current member, and opens the next one with characters to write
+		void next_member() {
+			const auto &members = m_idx.members();
+			while (m_left == 0 && m_cur < members.size()) {
+				close_member();
+				const member_index::member &m = members[m_cur++];
+				std::string name = m.name.substr( std::min( m.name.find_first_not_of( '/' ), m.name.size() ) ); //store absolute paths relative to the directory
+				if (name.empty() || ("/" + name + "/").find( "/../" ) != std::string::npos) {
+					throw std::invalid_argument("member \"" + m.name + "\" would be stored outside of the directory");
+				}
+				std::string path = m_dir + "/" + name;
+				create_dirs( path );
+				m_file.clear();
+				m_file.open( path, std::ios::out | std::ios::trunc | std::ios::binary );
+				if (!m_file) {
+					throw std::runtime_error("unable to create member \"" + path + "\"");
+				}
+				m_left = m.size;
+			}
+		};
+	public:
+		//! constructor, expects the index of members to be written and the directory to store them in
+		member_output_buf( const member_index &idx, const std::string &dir )
+		                 : m_idx( idx ), m_dir( dir ) {};
+
+		//! creates all remaining (empty) members and closes the last one. Throws an
+		//! invalid_argument if not all members were written completely, and a
+		//! runtime_error if the last member could not be written.
+		void finish() {
+			next_member();
+			if (m_left != 0) {
+				throw std::invalid_argument("archive is shorter than its members");
+			}
+			close_member();
+		};
+	protected:
+		virtual std::streamsize xsputn( const char_type *s, std::streamsize n ) {
+			std::streamsize written = 0;
+			while (written < n) {
+				next_member();
+				if (m_left == 0) {
+					throw std::invalid_argument("archive is longer than its members");
+				}
+				std::streamsize cnt = std::min<uint64_t>( m_left, n - written );
+				if (!m_file.write( s + written, cnt )) {
+					throw std::runtime_error("unable to write member \"" + m_idx.members()[m_cur-1].name + "\"");
+				}
+				written += cnt;
+				m_left -= cnt;
+			}
+			return written;
+		};
+
+		virtual int_type overflow( int_type c ) {
+			if (traits_type::eq_int_type( c, traits_type::eof() ))	return traits_type::not_eof( c );
+			char_type ch = traits_type::to_char_type( c );
+			xsputn( &ch, 1 );
+			return c;
+		};
+};
+
+#endif
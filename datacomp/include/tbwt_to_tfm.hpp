@@ -0,0 +1,245 @@
+/*
+ * tbwt_to_tfm.hpp for BWT Tunneling
+ * Copyright (c) 2020 Uwe Baier All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TBWT_TO_TFM_HPP
+#define TBWT_TO_TFM_HPP
+
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "aux_encoding.hpp"
+#include "bwt_config.hpp"
+#include "twobitvector.hpp"
+#include "working_memory.hpp"
+
+//! expands tunnels of a tunneled fm index which contain other tunnels.
+/*! tunnels of a tunneled bwt may be nested (see tp_strategy_lmrtpi::invert_tbwt,
+   which uses a stack of offsets), while a tfm index only keeps the offset of the
+   most recently entered tunnel. Hence, each tunnel is followed from its start
+   until it either ends or another tunnel starts within it, so L, dout and din
+   stay untouched after O(|L|) steps if no tunnels are nested.
+   Otherwise, all tunnels containing other tunnels are expanded: all rows collapsed
+   into an edge of such a tunnel share the same character, so the edge is repeated
+   once per row, which is counted by a traversal of all n+1 rows. The remaining
+   tunnels contain no other tunnels and can be navigated by a tfm index.
+   Returns the number of expanded tunnels, throws an invalid_argument if the
+   tunnels of L, dout and din are inconsistent.
+ */
+template<class bit_vector_t>
+t_size_t expand_nested_tunnels( t_string_t &L, bit_vector_t &dout, bit_vector_t &din,
+                                t_size_t n, working_memory &wm ) {
+	const t_idx_t m = L.size();
+	if (dout.size() != m + 1 || din.size() != m + 1) {
+		throw std::invalid_argument("number of in- and outedges of tfm index differ");
+	}
+
+	//compute first in- and outedge of each node (plus the terminating one)
+	std::vector<t_idx_t> first_in = wm.acquire( m + 1 );
+	std::vector<t_idx_t> first_out = wm.acquire( m + 1 );
+	for (t_idx_t i = 0; i <= m; i++) {
+		if (din[i])	first_in.push_back( i );
+		if (dout[i])	first_out.push_back( i );
+	}
+	if (first_in.size() != first_out.size()) {
+		throw std::invalid_argument("number of nodes of tfm index differ");
+	}
+	const t_idx_t nodes = first_in.size() - 1;
+	auto in_deg  = [&]( t_idx_t v ) { return first_in[v+1] - first_in[v]; };
+	auto out_deg = [&]( t_idx_t v ) { return first_out[v+1] - first_out[v]; };
+
+	//compute node of each inedge and the inedge reached from each outedge
+	std::vector<t_idx_t> in_node = wm.acquire( m );
+	for (t_idx_t v = 0; v < nodes; v++) {
+		in_node.resize( first_in[v+1], v );
+	}
+	std::vector<t_idx_t> lf = wm.acquire( m );
+	{
+		std::vector<t_idx_t> C( std::numeric_limits<t_uchar_t>::max() + 1 );
+		for (t_idx_t i = 0; i < m; i++) {
+			++C[L[i]];
+		}
+		t_idx_t sum = 0;
+		for (auto &c : C) {
+			std::swap( c, sum );
+			sum += c;
+		}
+		for (t_idx_t i = 0; i < m; i++) {
+			lf.push_back( C[L[i]]++ );
+		}
+	}
+
+	//follow each tunnel until its end or the start of a nested tunnel
+	std::vector<bool> expand( nodes ); //whether tunnel starting at node has to be expanded
+	std::vector<bool> keep( nodes );   //whether node remains the start or end of a tunnel
+	t_size_t expanded = 0;
+	for (t_idx_t u = 0; u < nodes; u++) {
+		if (in_deg( u ) == 1)	continue;
+		t_idx_t v = u;
+		for (t_idx_t k = 0; out_deg( v ) == 1; k++) {
+			v = in_node[lf[first_out[v]]];
+			if (in_deg( v ) > 1 || k == m) { //nested tunnel (or a cycle, which is rejected below)
+				expand[u] = true;
+				++expanded;
+				break;
+			}
+		}
+		if (!expand[u]) {
+			keep[u] = true;
+			keep[v] = true;
+		}
+	}
+
+	if (expanded > 0) {
+		//count rows per outedge by a traversal of the index using a stack of tunnels,
+		//edges within remaining tunnels are kept once
+		t_idx_t s = 0; //outedge of the sentinel
+		while (s < m && L[s] != 0)	++s;
+		std::vector<t_idx_t> cnt = wm.acquire( m );
+		cnt.resize( m );
+		std::vector<std::pair<t_idx_t,t_idx_t>> tunnels; //entry offsets and start nodes
+		t_idx_t i = s;
+		for (uint64_t k = 0; k <= n && s < m; k++) {
+			t_idx_t x = lf[i];
+			t_idx_t v = in_node[x];
+			if (in_deg( v ) > 1) { //start of a tunnel
+				tunnels.push_back( std::make_pair( x - first_in[v], v ) );
+			}
+			i = first_out[v];
+			if (out_deg( v ) > 1) { //end of a tunnel
+				if (tunnels.empty() || tunnels.back().first >= out_deg( v )) {
+					throw std::invalid_argument("missing start of a tunnel");
+				}
+				i += tunnels.back().first;
+				tunnels.pop_back();
+			}
+			if (tunnels.empty() || expand[tunnels.back().second])	++cnt[i];
+			else                                                 	cnt[i] = 1;
+		}
+		if (s == m || i != s || !tunnels.empty()) {
+			throw std::invalid_argument("tunnels of tfm index are invalid");
+		}
+
+		//repeat outedges and their inedges according to their counts
+		for (t_idx_t i = 0; i < m; i++) {
+			in_node[lf[i]] = cnt[i]; //count of inedge reached from outedge i
+		}
+		t_idx_t e_m = 0;
+		for (auto c : cnt) {
+			e_m += c;
+		}
+		t_string_t e_L;
+		e_L.reserve( e_m );
+		bit_vector_t e_dout( e_m + 1, 0 );
+		bit_vector_t e_din( e_m + 1, 0 );
+		t_idx_t p = 0, q = 0;
+		for (t_idx_t v = 0; v < nodes; v++) {
+			const t_idx_t p_v = p, q_v = q;
+			for (t_idx_t i = first_out[v]; i < first_out[v+1]; i++) {
+				for (t_idx_t j = 0; j < cnt[i]; j++, p++) {
+					e_L.push_back( L[i] );
+					e_dout[p] = !keep[v] || p == p_v;
+				}
+			}
+			for (t_idx_t x = first_in[v]; x < first_in[v+1]; x++) {
+				for (t_idx_t j = 0; j < in_node[x]; j++, q++) {
+					e_din[q] = !keep[v] || q == q_v;
+				}
+			}
+			if (!keep[v] && p - p_v != q - q_v) { //expanded node has to split into pairs of edges
+				throw std::invalid_argument("tunnels of tfm index are invalid");
+			}
+		}
+		e_dout[p] = 1;
+		e_din[q] = 1;
+		L = std::move( e_L );
+		dout = std::move( e_dout );
+		din = std::move( e_din );
+		wm.release( std::move( cnt ) );
+	}
+	wm.release( std::move( lf ) );
+	wm.release( std::move( in_node ) );
+	wm.release( std::move( first_out ) );
+	wm.release( std::move( first_in ) );
+	return expanded;
+}
+
+//! converts a tunneled BWT into the components of a tunneled fm index.
+/*! aux must be given in expanded form, i.e. with one entry per position of
+   tbwt plus a terminating entry (see decode_aux of the tunneling strategies).
+   The tunneled BWT lacks the row whose last character is the sentinel (at
+   tbwt_idx), and shares its first row with the first column of that row. Hence
+   the L-part (IGN_L) of aux[0] belongs to the first row, while its F-part
+   (SKP_F) belongs to the sentinel row.
+   An entry ignoring its L-character (IGN_L) becomes a 0 in din, an entry
+   skipping its F-character (SKP_F) a 0 in dout. Afterwards, L, dout and din
+   are reduced in the same way as construct_tfm_index does, and nested tunnels
+   are expanded using expand_nested_tunnels.
+   Returns the number of expanded tunnels, throws an invalid_argument if tbwt
+   contains the sentinel character 0 or its tunnels are invalid.
+ */
+template<class bit_vector_t>
+t_size_t tbwt_to_tfm( const t_string_t &tbwt, const twobitvector &aux, t_idx_t tbwt_idx, t_size_t n,
+                      t_string_t &L, bit_vector_t &dout, bit_vector_t &din, working_memory &wm ) {
+	const t_idx_t m = tbwt.size();
+	if (aux.size() != m + 1) {
+		throw std::invalid_argument("aux must have one entry per tunneled bwt entry plus one");
+	}
+	if (m != 0 && (tbwt_idx == 0 || tbwt_idx >= m)) {
+		throw std::invalid_argument("tbwt index is invalid");
+	}
+	L.clear();
+	L.reserve( m + 1 );
+	dout.resize( m + 2 );
+	din.resize( m + 2 );
+	t_idx_t p = 0, q = 0;
+
+	//adds a row of the (non-reduced) tunneled fm index
+	auto add_row = [&]( t_uchar_t c, bool keep_l, bool keep_f ) {
+		if (keep_l) {
+			L.push_back( c );
+			dout[p++] = keep_f;
+		}
+		if (keep_f) {
+			din[q++] = keep_l;
+		}
+	};
+	for (t_idx_t r = 0; r <= m; r++) {
+		if (r == tbwt_idx) { //row of the sentinel
+			add_row( 0, true, (aux[0] & aux_encoding::SKP_F) == 0 );
+			continue;
+		}
+		t_idx_t k = (r < tbwt_idx) ? r : r - 1;
+		if (tbwt[k] == 0) {
+			throw std::invalid_argument("tunneled bwt must not contain the sentinel character 0");
+		}
+		add_row( tbwt[k], (aux[k] & aux_encoding::IGN_L) == 0,
+		         k == 0 || (aux[k] & aux_encoding::SKP_F) == 0 );
+	}
+	dout[p++] = 1;	dout.resize( p );
+	din[q++] = 1;	din.resize( q );
+	return expand_nested_tunnels( L, dout, din, n, wm );
+}
+
+#endif
@@ -31,7 +31,7 @@ class tp_strategy_bestp : public tp_strategy_lmrtpi {
 public:
 	static t_size_t percentage; //percentage to be used
 
-	tp_strategy_bestp( const t_string_t &L, t_idx_t bwt_idx ) : tp_strategy_lmrtpi( L, bwt_idx ) {
+	tp_strategy_bestp( const t_string_t &L, t_idx_t bwt_idx, working_memory &wm ) : tp_strategy_lmrtpi( L, bwt_idx, wm ) {
 	};
 
 	virtual std::pair<t_size_t,t_bitsize_t> plan() {
@@ -58,6 +58,7 @@ public:
 			t_idx_t k = SPI[t];
 			RPE[k] = run_lf.lfr(k);
 		}
+		wm.release( std::move( RPTC ) );
 		return std::pair<t_size_t,t_bitsize_t>( num_tunnels, cost(num_tunnels) );
 	};
 };
@@ -33,7 +33,7 @@
 
 class tp_strategy_greedy : public tp_strategy_lmrtpi {
 public:
-		tp_strategy_greedy( const t_string_t &L, t_idx_t bwt_idx ) : tp_strategy_lmrtpi( L, bwt_idx ) {
+		tp_strategy_greedy( const t_string_t &L, t_idx_t bwt_idx, working_memory &wm ) : tp_strategy_lmrtpi( L, bwt_idx, wm ) {
 	};
 
 	virtual std::pair<t_size_t,t_bitsize_t> plan() {
@@ -66,6 +66,7 @@ public:
 			t_idx_t k = SPI[t];
 			RPE[k] = run_lf.lfr(k);
 		}
+		wm.release( std::move( RPTC ) );
 		return std::pair<t_size_t,t_bitsize_t>( t_opt, cost(t_opt) );
 	};			
 };
@@ -48,7 +48,7 @@ private:
 	};
 		
 public:
-	tp_strategy_greedy_update( const t_string_t &L, t_idx_t bwt_idx ) : tp_strategy_lmrtpi( L, bwt_idx ) {
+	tp_strategy_greedy_update( const t_string_t &L, t_idx_t bwt_idx, working_memory &wm ) : tp_strategy_lmrtpi( L, bwt_idx, wm ) {
 	};
 
 	virtual std::pair<t_size_t,t_bitsize_t> plan() {
@@ -168,6 +168,7 @@ public:
 				RPE[k] = run_lf.lfr( k );
 			}
 		}
+		wm.release( std::move( RPTC ) );
 		return std::pair<t_size_t,t_bitsize_t>( t_opt, cost(t_opt) );
 	};
 };
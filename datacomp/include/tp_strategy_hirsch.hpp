@@ -41,7 +41,7 @@ private:
 		return (t_size_t)(((rhg1 + 1) / ((1u << p) + 2)) - 0.5);
 	};
 public:
-	tp_strategy_hirsch( const t_string_t &L, t_idx_t bwt_idx ) : tp_strategy_lmrtpi( L, bwt_idx ) {
+	tp_strategy_hirsch( const t_string_t &L, t_idx_t bwt_idx, working_memory &wm ) : tp_strategy_lmrtpi( L, bwt_idx, wm ) {
 	};
 
 	virtual std::pair<t_size_t,t_bitsize_t> plan() {
@@ -75,7 +75,9 @@ public:
 				RPE[k] = run_lf.lfr(k);
 			}
 		}
-		return std::pair<t_size_t,t_bitsize_t>( C[t_opt], cost(t_opt) );
+		wm.release( std::move( RPTC ) );
+		//C is empty if no prefix interval can be worth tunneling
+		return std::pair<t_size_t,t_bitsize_t>( C.empty() ? 0 : C[t_opt], cost(t_opt) );
 	};
 };
 
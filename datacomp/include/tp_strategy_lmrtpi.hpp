@@ -36,19 +36,41 @@
 
 #include "aux_encoding.hpp"
 #include "bwt_config.hpp"
+#include "bwt_runs.hpp"
 #include "run_lf_support.hpp"
 #include "twobitvector.hpp"
+#include "working_memory.hpp"
 
 //! tunneling strategy considering length-maximal run-terminated prefix intervals
 class tp_strategy_lmrtpi {
 private:
 	void compute_lmrtpis();
 
-	static void transform_aux( const t_string_t &tbwt, twobitvector &aux, t_idx_t tbwt_idx );
-	static void retransform_aux( const t_string_t &tbwt, twobitvector &aux, t_idx_t tbwt_idx );
+	static void transform_aux( const bwt_runs &truns, twobitvector &aux, t_string_t &aux_ctx );
+	static void retransform_aux( const bwt_runs &truns, twobitvector &aux );
 
-	static t_size_t rle_len( const t_string_t &L );
+	//! constructor, uses the runs of the BWT computed by the public constructor
+	tp_strategy_lmrtpi( const bwt_runs &runs, working_memory &_wm ) : wm( _wm ), run_lf( runs, &_wm ) {
+		//compute variables
+		r = run_lf.runs;
+		rhg1 = 0;
+		rc = 0;
+		n_rle = runs.rle_len();
+		rc = n_rle - r;
+		for (t_idx_t i = 0; i < r; i++) {
+			if (run_lf.height(i) > 1u) {
+				++rhg1;
+			}
+		}
+		log2_2nrle_rc = 1.0 + log1p( r / (double)rc ) / log( 2 );
+
+		//create RPE array
+		compute_lmrtpis();
+	};
 protected:
+	//working memory to take buffers from
+	working_memory &wm;
+
 	//run-lf support
 	run_lf_support run_lf;
 	
@@ -67,22 +89,12 @@ protected:
 
 public:
 	//! constructor, get information
-	tp_strategy_lmrtpi( const t_string_t &L, t_idx_t bwt_idx ) : run_lf( (const t_uchar_t *)L.data(), L.size(), bwt_idx ) {
-		//compute variables
-		r = run_lf.runs;
-		rhg1 = 0;
-		rc = 0;
-		n_rle = rle_len( L );
-		rc = n_rle - r;
-		for (t_idx_t i = 0; i < r; i++) {
-			if (run_lf.height(i) > 1u) {
-				++rhg1;
-			}
-		}
-		log2_2nrle_rc = 1.0 + log1p( r / (double)rc ) / log( 2 );
+	tp_strategy_lmrtpi( const t_string_t &L, t_idx_t bwt_idx, working_memory &wm )
+	                  : tp_strategy_lmrtpi( bwt_runs( (const t_uchar_t *)L.data(), L.size(), bwt_idx, &wm ), wm ) {};
 
-		//create RPE array
-		compute_lmrtpis();
+	//! destructor, returns buffers to the working memory
+	virtual ~tp_strategy_lmrtpi() {
+		wm.release( std::move( RPE ) );
 	};
 
 	//! benefit function for tc removed characters
@@ -101,39 +113,40 @@ public:
 	virtual std::pair<t_size_t,t_bitsize_t> plan() = 0;
 
 	//! tunneling according to the plan. Returns the number of removed characters from the RLE representation
-	//! and the expected benefit in bits
-	std::pair<t_size_t,t_bitsize_t> tunnel_bwt( t_string_t &bwt, twobitvector &aux, t_idx_t &tbwt_idx );
-
-	//! invert a tunneled BWT
-	static void invert_tbwt( t_string_t &&tbwt, twobitvector &&aux, t_size_t n,
-                                 t_idx_t tbwt_idx, std::ostream &out );
-};
-
-//// COMPUTATION OF THE LENGTH OF A RUN-LENGTH ENCODING ///////////////////////
-t_size_t tp_strategy_lmrtpi::rle_len( const t_string_t &L ) {
-	if (L.size() == 0)	return 0;
-
-	t_uchar_t rchar = L[0] + 1; //character of current run
-	t_size_t rlen = 1; //length of current run
-	t_size_t rle_len = 0; //overall length
-	for (t_idx_t i = 0; i < L.size(); i++) {
-		if (rchar != L[i]) { //end of a run
-			rle_len += 1 + sdsl::bits::hi( rlen );
-			rchar = L[i];
-			rlen = 1;
-		} else {
-			++rlen;
+	//! and the expected benefit in bits. aux_ctx receives the context characters of the (run-based) aux
+	//! entries, i.e. the characters of all runs of the tunneled BWT with height > 1.
+	std::pair<t_size_t,t_bitsize_t> tunnel_bwt( t_string_t &bwt, twobitvector &aux, t_idx_t &tbwt_idx, t_string_t &aux_ctx );
+
+	//! invert a tunneled BWT with an expanded aux (see decode_aux), tbwt and aux get modified during inversion
+	static void invert_tbwt( t_string_t &tbwt, twobitvector &aux, t_size_t n,
+                                 t_idx_t tbwt_idx, working_memory &wm, std::ostream &out );
+
+	//! decodes the run-based aux of a tunneled BWT by calling dec( aux_ctx ), where aux_ctx holds
+	//! the context characters of the aux entries, and expands it afterwards such that it contains
+	//! one entry per tbwt entry plus a terminating entry.
+	//! the runs of the tunneled BWT are detected once for both steps.
+	template<class t_aux_decoder>
+	static void decode_aux( const t_string_t &tbwt, t_idx_t tbwt_idx, working_memory &wm, twobitvector &aux,
+	                        t_aux_decoder dec ) {
+		bwt_runs truns( (const t_uchar_t *)tbwt.data(), tbwt.size(), tbwt_idx, &wm );
+		t_string_t aux_ctx;
+		for (t_idx_t k = 0; k < truns.runs(); k++) {
+			if (truns.height( k ) > 1u) {
+				aux_ctx.push_back( truns.character( k ) );
+			}
 		}
-	}
-	rle_len += sdsl::bits::hi( rlen ); //add characters of last run (1 is added for the zero-th run)
-	return rle_len;
-}
+		dec( aux_ctx );
+		retransform_aux( truns, aux );
+		if (tbwt.size() == 0)	{ aux.resize( 1 ); aux[0] = aux_encoding::REG; }
+	};
+};
 
 //// COMPUTATION OF LENGTH-MAXIMAL RUN-TERMINATED PREFIX INTERVALS ////////////
 void tp_strategy_lmrtpi::compute_lmrtpis() {
 	//create helpful arrays
-	RPE.resize( r );
-	std::vector<t_idx_t> PE( r ); //prefix interval end
+	RPE = wm.acquire( r );	RPE.resize( r );
+	std::vector<t_idx_t> PE = wm.acquire( r ); //prefix interval end
+	PE.resize( r );
 
 	//initialize arrays and a stack
 	for (t_idx_t k = 0; k < r; k++) {
@@ -170,10 +183,12 @@ void tp_strategy_lmrtpi::compute_lmrtpis() {
 			} while (!s.empty());
 		}
 	}
+	wm.release( std::move( PE ) );
 };
 
 //// COMPUTATION OF RATING ARRAY //////////////////////////////////////////////
 void tp_strategy_lmrtpi::compute_rating(std::vector<t_size_t> &RPTC) {
+	if (RPTC.capacity() < r)	RPTC = wm.acquire( r );
 	RPTC.resize( r );
 	for (t_idx_t k = 0; k < r; k++) {
 		RPTC[k] = 0;
@@ -192,70 +207,45 @@ void tp_strategy_lmrtpi::compute_rating(std::vector<t_size_t> &RPTC) {
 };
 
 //// TRANSFORM AUX ////////////////////////////////////////////////////////////
-void tp_strategy_lmrtpi::transform_aux( const t_string_t &tbwt, twobitvector &aux, t_idx_t tbwt_idx ) {
-	if (tbwt.size() == 0)	return;
+void tp_strategy_lmrtpi::transform_aux( const bwt_runs &truns, twobitvector &aux, t_string_t &aux_ctx ) {
+	aux_ctx.clear();
+	if (truns.size() == 0)	return;
 
-	//transfer aux to a run-based representation
+	//transfer aux to a run-based representation, and collect the characters of its runs
 	t_idx_t j = 0;
-	std::array<t_idx_t,3> bounds = {(t_idx_t)0u,
-		                   tbwt_idx,
-		                   (t_idx_t)tbwt.size()}; //don't forget primary index run
-	for (t_idx_t ib = 0; ib != 2; ib++) {
-		t_idx_t i = bounds[ib];
-		t_idx_t e = bounds[ib+1];
-
-		bool newrun = true;
-		while (++i < e) {
-			if (tbwt[i] != tbwt[i-1]) { //new run detected
-				newrun = true;
-			}
-			else if (newrun) { //first run-character of new run
-				aux[j++] = aux[i]; //copy aux-value of runs with height > 1
-				newrun = false;
-			}
+	for (t_idx_t k = 0; k < truns.runs(); k++) {
+		if (truns.height( k ) > 1u) {
+			aux[j++] = aux[truns.start( k ) + 1]; //copy aux-value of runs with height > 1
+			aux_ctx.push_back( truns.character( k ) );
 		}
 	}
 	aux.resize( j );
 }
 
 //// RETRANSFORM AUX //////////////////////////////////////////////////////////
-void tp_strategy_lmrtpi::retransform_aux( const t_string_t &tbwt, twobitvector &aux, t_idx_t tbwt_idx ) {
-	if (tbwt.size() == 0)	return;
+void tp_strategy_lmrtpi::retransform_aux( const bwt_runs &truns, twobitvector &aux ) {
+	if (truns.size() == 0)	return;
 
 	//decode run-based aux
-	std::array<t_idx_t,3> bounds = {
-		(t_idx_t)tbwt.size(),
-		tbwt_idx,
-		(t_idx_t)0u }; //don't forget primary index run
-
 	t_idx_t j = aux.size();
-	aux.resize( tbwt.size() + 1 );
-	aux[tbwt.size()] = aux_encoding::REG;
-
-	for (t_idx_t ib = 0; ib != 2; ib++) {
-		t_idx_t i = bounds[ib];
-		t_idx_t e = bounds[ib+1];
-
-		bool newrun = true;
-		while (--i > e) {
-			if (tbwt[i] != tbwt[i-1]) { //start of a run
-				aux[i] = aux_encoding::REG;
-				newrun = true;
-			}
-			else {
-				if (newrun) {
-					if (j-- == 0u) throw std::invalid_argument("invalid aux encoding");
-					newrun = false;
-				}
+	aux.resize( truns.size() + 1 );
+	aux[truns.size()] = aux_encoding::REG;
+
+	for (t_idx_t k = truns.runs(); k-- > 0; ) {
+		t_idx_t i = truns.end( k );
+		if (truns.height( k ) > 1u) {
+			if (j-- == 0u) throw std::invalid_argument("invalid aux encoding");
+			while (--i > truns.start( k )) {
 				aux[i] = aux[j];
 			}
 		}
-		aux[i] = aux_encoding::REG; //set flag for start of last run
+		aux[truns.start( k )] = aux_encoding::REG; //set flag for start of a run
 	}
 }
 
 //// TUNNEL A BWT /////////////////////////////////////////////////////////////
-std::pair<t_size_t,t_bitsize_t> tp_strategy_lmrtpi::tunnel_bwt( t_string_t &bwt, twobitvector &aux, t_idx_t &tbwt_idx ) {
+std::pair<t_size_t,t_bitsize_t> tp_strategy_lmrtpi::tunnel_bwt( t_string_t &bwt, twobitvector &aux, t_idx_t &tbwt_idx,
+                                                                t_string_t &aux_ctx ) {
 
 	//resize auxiliary bit vector to cover enough space
 	aux.resize( run_lf.idx_n+1 );
@@ -332,17 +322,19 @@ std::pair<t_size_t,t_bitsize_t> tp_strategy_lmrtpi::tunnel_bwt( t_string_t &bwt,
 	bwt.resize( p );
 	aux[p++] = aux_encoding::REG;	aux.resize( p );
 
-	transform_aux( bwt, aux, tbwt_idx );
+	//detect runs of the tunneled bwt once for both aux transformation and rle length
+	bwt_runs truns( (const t_uchar_t *)bwt.data(), bwt.size(), tbwt_idx, &wm );
+	transform_aux( truns, aux, aux_ctx );
 
 	//measure removed characters from RLE encoding
-	t_size_t tc = n_rle - rle_len( bwt );
+	t_size_t tc = n_rle - truns.rle_len();
 	return std::pair<t_size_t,t_bitsize_t>( tc, benefit(tc) );
 }
 
 //// INVERTING A TUNNELED BWT /////////////////////////////////////////////////
 
-void tp_strategy_lmrtpi::invert_tbwt( t_string_t &&tbwt, twobitvector &&aux, t_size_t n,
-                                           t_idx_t tbwt_idx, std::ostream &out ) {
+void tp_strategy_lmrtpi::invert_tbwt( t_string_t &tbwt, twobitvector &aux, t_size_t n,
+                                           t_idx_t tbwt_idx, working_memory &wm, std::ostream &out ) {
 	typedef typename std::ostream::char_type schar_t;
 	static_assert( std::is_same<
 	                    typename std::make_unsigned<schar_t>::type,
@@ -353,8 +345,9 @@ void tp_strategy_lmrtpi::invert_tbwt( t_string_t &&tbwt, twobitvector &&aux, t_s
 	if (tbwt.size() != 0 && (tbwt_idx >= tbwt.size() || tbwt_idx == 0)) {
 		throw std::invalid_argument("tbwt index is invalid");
 	}
-
-	retransform_aux( tbwt, aux, tbwt_idx );
+	if (aux.size() != tbwt.size() + 1) {
+		throw std::invalid_argument("auxiliary structure is invalid");
+	}
 
 	//count character frequencies
 	std::vector<t_size_t> C( std::numeric_limits<t_uchar_t>::max() + 1 );
@@ -386,7 +379,8 @@ void tp_strategy_lmrtpi::invert_tbwt( t_string_t &&tbwt, twobitvector &&aux, t_s
 	//// INVERTITION USING PHI ////////////////////////////////////////////
 	
 	//compute PHI
-	std::vector<t_idx_t> PHI( tbwt.size() );
+	std::vector<t_idx_t> PHI = wm.acquire( tbwt.size() );
+	PHI.resize( tbwt.size() );
 	for (t_idx_t i = 0; i < tbwt.size(); i++) {
 		if (aux[i] != aux_encoding::IGN_L) {
 			j = C[tbwt[i]];
@@ -441,6 +435,7 @@ void tp_strategy_lmrtpi::invert_tbwt( t_string_t &&tbwt, twobitvector &&aux, t_s
 	if (!stck.empty()) {
 		throw std::invalid_argument("missing start of a tunnel");
 	}
+	wm.release( std::move( PHI ) );
 }
 
 #endif
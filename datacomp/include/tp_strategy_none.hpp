@@ -24,9 +24,11 @@
 #ifndef TP_STRATEGY_NONE_HPP
 #define TP_STRATEGY_NONE_HPP
 
+#include "aux_encoding.hpp"
 #include "bwt_config.hpp"
 #include "divsufsort.h"
 #include "twobitvector.hpp"
+#include "working_memory.hpp"
 
 #include <utility>
 
@@ -35,24 +37,39 @@
 
 class tp_strategy_none {
 public:
-	tp_strategy_none( SDSL_UNUSED const t_string_t &L, SDSL_UNUSED t_idx_t bwt_idx ) {};
+	tp_strategy_none( SDSL_UNUSED const t_string_t &L, SDSL_UNUSED t_idx_t bwt_idx, SDSL_UNUSED working_memory &wm ) {};
 
 	std::pair<t_size_t,t_bitsize_t> plan() {
 		return std::pair<t_size_t,t_bitsize_t>( 0u, 0u );
 	};
 
-	std::pair<t_size_t,t_bitsize_t> tunnel_bwt( SDSL_UNUSED t_string_t &bwt, SDSL_UNUSED twobitvector &aux, SDSL_UNUSED t_idx_t &bwt_idx ) {
+	std::pair<t_size_t,t_bitsize_t> tunnel_bwt( SDSL_UNUSED t_string_t &bwt, twobitvector &aux, SDSL_UNUSED t_idx_t &bwt_idx,
+	                                            t_string_t &aux_ctx ) {
+		aux.resize( 0 ); //no auxiliary information required
+		aux_ctx.clear();
 		return std::pair<t_size_t,t_bitsize_t>( 0u, 0u );
 	};
 
-	static void invert_tbwt( t_string_t &&tbwt, twobitvector &&aux, t_size_t n,
-                                 t_idx_t tbwt_idx, std::ostream &out );
+	static void invert_tbwt( t_string_t &tbwt, twobitvector &aux, t_size_t n,
+                                 t_idx_t tbwt_idx, working_memory &wm, std::ostream &out );
+
+	static void expand_aux( const t_string_t &tbwt, SDSL_UNUSED t_idx_t tbwt_idx, SDSL_UNUSED working_memory &wm, twobitvector &aux ) {
+		aux.resize( tbwt.size() + 1 ); //all entries are regular
+		for (t_idx_t i = 0; i < aux.size(); i++)	aux[i] = aux_encoding::REG;
+	};
+
+	template<class t_aux_decoder>
+	static void decode_aux( const t_string_t &tbwt, t_idx_t tbwt_idx, working_memory &wm, twobitvector &aux,
+	                        t_aux_decoder dec ) {
+		dec( t_string_t() ); //no auxiliary information present
+		expand_aux( tbwt, tbwt_idx, wm, aux );
+	};
 };
 
 //// INVERTING A TUNNELED BWT /////////////////////////////////////////////////
 
-void tp_strategy_none::invert_tbwt( t_string_t &&tbwt, SDSL_UNUSED twobitvector &&aux, SDSL_UNUSED t_size_t n,
-                                           t_idx_t tbwt_idx, std::ostream &out ) {
+void tp_strategy_none::invert_tbwt( t_string_t &tbwt, SDSL_UNUSED twobitvector &aux, SDSL_UNUSED t_size_t n,
+                                           t_idx_t tbwt_idx, working_memory &wm, std::ostream &out ) {
 	typedef typename std::ostream::char_type schar_t;
 	static_assert( std::is_same<
 	                    typename std::make_unsigned<schar_t>::type,
@@ -63,10 +80,14 @@ void tp_strategy_none::invert_tbwt( t_string_t &&tbwt, SDSL_UNUSED twobitvector
 	if (tbwt.size() != 0 && (tbwt_idx >= tbwt.size() || tbwt_idx == 0)) {
 		throw std::invalid_argument("tbwt index is invalid");
 	}
-	if (inverse_bw_transform(tbwt.data(), tbwt.data(), NULL,
+	//use a buffer of the working memory as work space for divsufsort
+	static_assert( sizeof(saidx_t) == sizeof(t_idx_t), "saidx_t and t_idx_t must have the same size" );
+	auto A = wm.acquire( tbwt.size() + 1 );	A.resize( tbwt.size() + 1 );
+	if (inverse_bw_transform(tbwt.data(), tbwt.data(), (saidx_t *)A.data(),
 	                         (saidx_t)tbwt.size(), (saidx_t)tbwt_idx) < 0) {
 		throw std::invalid_argument( "Inverse BW Transformation failed" );		
 	}
+	wm.release( std::move( A ) );
 	out.write( (const schar_t *)tbwt.data(), tbwt.size() );
 }
 
@@ -91,6 +91,11 @@ class twobitvector {
 			return m_data.size();
 		};
 
+		//! capacity of the underlying data field in bytes
+		size_type datacapacity() const {
+			return m_data.capacity();
+		};
+
 		//! random read access to the elements
 		value_type operator[]( size_type i ) const {
 			assert(i < m_size);
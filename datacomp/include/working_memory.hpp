@@ -0,0 +1,155 @@
+/*
+ * working_memory.hpp for BWT Tunneling
+ * Copyright (c) 2020 Uwe Baier All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WORKING_MEMORY_HPP
+#define WORKING_MEMORY_HPP
+
+#include <algorithm>
+#include <stdint.h>
+#include <streambuf>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include <sdsl/util.hpp>
+
+#include "bwt_config.hpp"
+#include "twobitvector.hpp"
+
+//! working memory of a block compressor, which is kept and reused from block to block.
+/*! the working memory consists of a text buffer, an auxiliary buffer and a pool
+   of index buffers. Index buffers are acquired by the components of a compressor
+   (e.g. run-lf support or tunnel planning) and released back into the pool
+   afterwards, so that their capacity can be used by the next component or block.
+ */
+class working_memory {
+	public:
+		typedef std::vector<t_idx_t> idx_buffer;
+	private:
+		std::vector<idx_buffer> m_pool; //released index buffers
+		uint64_t m_reused_bytes = 0; //amount of memory served from previous allocations
+		bool m_huge_pages = false; //whether to advise the kernel to back buffers with huge pages
+
+		//advises the kernel to use transparent huge pages for the memory [p,p+bytes)
+		void advise_huge_pages( SDSL_UNUSED void *p, SDSL_UNUSED uint64_t bytes ) const {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+			const uintptr_t hp_size = 2ul * 1024ul * 1024ul;
+			uintptr_t b = ((uintptr_t)p + hp_size - 1) & ~(hp_size - 1);
+			uintptr_t e = ((uintptr_t)p + bytes) & ~(hp_size - 1);
+			if (m_huge_pages && b < e) {
+				madvise( (void *)b, e - b, MADV_HUGEPAGE ); //only a hint, so errors are ignored
+			}
+#endif
+		};
+
+	public:
+		//! text buffer, e.g. the text or the bwt of the current block
+		t_string_t text;
+		//! output buffer, e.g. the inverted residual literals of the current block
+		t_string_t output;
+		//! auxiliary buffer of the current block
+		twobitvector aux;
+
+		//! enables or disables transparent huge page backing for large buffers.
+		void set_huge_pages( bool hp ) {
+			m_huge_pages = hp;
+		};
+
+		//! returns whether transparent huge page backing is enabled.
+		bool huge_pages() const {
+			return m_huge_pages;
+		};
+
+		//! returns the amount of bytes which did not have to be allocated
+		//! because memory of previous blocks or components was reused.
+		uint64_t reused_bytes() const {
+			return m_reused_bytes;
+		};
+
+		//! resizes a buffer to n elements, reusing its capacity if possible.
+		template<class V>
+		void prepare( V &v, typename V::size_type n ) {
+			typedef typename V::value_type value_type;
+			m_reused_bytes += std::min( v.capacity(), n ) * sizeof(value_type);
+			if (v.capacity() < n) {
+				v.reserve( n );
+				advise_huge_pages( v.data(), v.capacity() * sizeof(value_type) );
+			}
+			v.resize( n );
+		};
+
+		//! resizes the auxiliary buffer to n elements, reusing its capacity if possible.
+		void prepare_aux( twobitvector::size_type n ) {
+			m_reused_bytes += std::min( aux.datacapacity(), (n >> 2) + 1 );
+			aux.resize( n );
+		};
+
+		//! acquires an empty index buffer from the pool, holding enough capacity for n elements.
+		idx_buffer acquire( typename idx_buffer::size_type n = 0 ) {
+			idx_buffer v;
+			if (!m_pool.empty()) {
+				//take the buffer with the biggest capacity
+				auto best = m_pool.begin();
+				for (auto it = m_pool.begin(); it != m_pool.end(); ++it) {
+					if (it->capacity() > best->capacity())	best = it;
+				}
+				std::swap( v, *best );
+				m_pool.erase( best );
+			}
+			v.clear();
+			m_reused_bytes += std::min( v.capacity(), n ) * sizeof(t_idx_t);
+			if (v.capacity() < n) {
+				v.reserve( n );
+				advise_huge_pages( v.data(), v.capacity() * sizeof(t_idx_t) );
+			}
+			return v;
+		};
+
+		//! releases an index buffer back into the pool.
+		void release( idx_buffer &&v ) {
+			if (v.capacity() > 0) {
+				m_pool.push_back( std::move( v ) );
+				v = idx_buffer();
+			}
+		};
+};
+
+//! stream buffer writing into a (prepared) buffer of the working memory.
+//! writing beyond the size of the buffer fails.
+class memory_outbuf : public std::streambuf {
+	public:
+		memory_outbuf( t_string_t &buf ) {
+			char *b = (char *)buf.data();
+			setp( b, b + buf.size() );
+		};
+
+		//! returns the number of characters written so far
+		uint64_t written() const {
+			return pptr() - pbase();
+		};
+};
+
+#endif
@@ -0,0 +1,130 @@
+/*
+ * bcm_bench.cpp for BWT Tunneling
+ * Copyright (c) 2020 Uwe Baier All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bwt_config.hpp"
+#include "divsufsort.h"
+
+#include "bcm_fast.hpp"
+#include "bcm_ss.hpp"
+
+using namespace std;
+using namespace std::chrono;
+
+typedef high_resolution_clock timer;
+
+void printUsage( char **argv ) {
+	cerr << "USAGE: " << argv[0] << " INFILE" << endl;
+	cerr << "  Compares the reference layout of the bcm context mixer with the" << endl;
+	cerr << "  cache-optimized layout on the BWT of INFILE. Prints the encoded size," << endl;
+	cerr << "  encoding and decoding times (in milliseconds) of both layouts." << endl;
+	cerr << "INFILE:" << endl;
+	cerr << "  File whose BWT is used for the comparison." << endl;
+};
+
+template<class F>
+uint64_t measure( F f ) {
+	auto start = timer::now();
+	f();
+	auto stop = timer::now();
+	return (uint64_t)duration_cast<milliseconds>( stop - start ).count();
+};
+
+int main( int argc, char **argv ) {
+	if (argc != 2) {
+		printUsage( argv );
+		return 1;
+	}
+	ifstream fin{ argv[1], ifstream::binary };
+	if (!fin) {
+		printUsage( argv );
+		cerr << "unable to open file \"" << argv[1] << "\"" << endl;
+		return 1;
+	}
+	t_string_t L{ istreambuf_iterator<char>( fin ), istreambuf_iterator<char>() };
+
+	//compute bwt
+	saidx_t idx;
+	vector<saidx_t> SA( L.size() + 1 );
+	if (bw_transform( L.data(), L.data(), SA.data(), (saidx_t)L.size(), &idx ) < 0) {
+		cerr << "BW Transformation failed" << endl;
+		return 1;
+	}
+	SA = vector<saidx_t>();
+
+	//reference layout
+	ostringstream ref_out;
+	uint64_t ref_enc = measure( [&]() {
+		bcm::CM cm;
+		for (size_t i = 0; i < L.size(); i++)	cm.Encode( L[i], ref_out );
+		cm.Flush( ref_out );
+	} );
+	const string ref = ref_out.str();
+	t_string_t ref_dec( L.size() );
+	uint64_t ref_dect = measure( [&]() {
+		istringstream in( ref );
+		bcm::CM cm;
+		cm.Init( in );
+		for (size_t i = 0; i < L.size(); i++)	ref_dec[i] = cm.Decode( in );
+	} );
+
+	//cache-optimized layout
+	vector<bcm::byte> fast;
+	uint64_t fast_enc = measure( [&]() {
+		bcm::MemorySink sink( fast );
+		bcm::CMFast cm;
+		for (size_t i = 0; i < L.size(); i++)	cm.Encode( L[i], sink );
+		cm.Flush( sink );
+	} );
+	t_string_t fast_dec( L.size() );
+	uint64_t fast_dect = measure( [&]() {
+		bcm::MemorySource source( fast.data(), fast.data() + fast.size() );
+		bcm::CMFast cm;
+		cm.Init( source );
+		for (size_t i = 0; i < L.size(); i++)	fast_dec[i] = cm.Decode( source );
+	} );
+
+	//check results
+	if (ref.size() != fast.size() || !equal( fast.begin(), fast.end(), (const bcm::byte *)ref.data() )) {
+		cerr << "encodings of both layouts differ" << endl;
+		return 1;
+	}
+	if (ref_dec != L || fast_dec != L) {
+		cerr << "decoding failed" << endl;
+		return 1;
+	}
+
+	cout << "size " << fast.size() << endl;
+	cout << "ref_encoding_time " << ref_enc << endl;
+	cout << "ref_decoding_time " << ref_dect << endl;
+	cout << "fast_encoding_time " << fast_enc << endl;
+	cout << "fast_decoding_time " << fast_dect << endl;
+	return 0;
+}
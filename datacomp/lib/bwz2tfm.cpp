@@ -0,0 +1,231 @@
+/*
+ * bwz2tfm.cpp for BWT Tunneling
+ * Copyright (c) 2020 Uwe Baier All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string.h>
+#include <vector>
+
+#include "bwt_compressor.hpp"
+#include "tbwt_to_tfm.hpp"
+#include "twobitvector.hpp"
+#include "working_memory.hpp"
+
+//tunnel planning strategies
+#include "tp_strategy_none.hpp"
+#include "tp_strategy_hirsch.hpp"
+#include "tp_strategy_greedy.hpp"
+#include "tp_strategy_greedy_update.hpp"
+#include "tp_strategy_bestp.hpp"
+
+//from ../seqana/include/
+#include "tfm_index.hpp"
+#include <sdsl/construct.hpp>
+#include <sdsl/io.hpp>
+
+//post stages
+#include "bcm_poststage.hpp"
+#include "bcm_rle_poststage.hpp"
+#include "bcm_segmented_poststage.hpp"
+#include "bw94_poststage.hpp"
+#include "rans_poststage.hpp"
+
+using namespace std;
+
+//suffix of the post stage identifier if the dedicated aux coder is used
+const string AUX_CODER_ID = "+aux";
+
+//forward declarations
+template<typename t_tunnel_strat>
+int bwz_to_tfm( istream &in, const string &outfile, bool informative );
+template<typename t_tunnel_strat, typename t_post_stage>
+int bwz_to_tfm( istream &in, const string &outfile, bool informative, bool dedicated_aux );
+
+void printUsage( char **argv ) {
+	cerr << "USAGE: " << argv[0] << " [OPTIONS] INFILE TFMOUTFILE" << endl;
+	cerr << "OPTIONS:" << endl;
+	cerr << "  -i\tEnable informative mode, printing information on each block" << endl;
+	cerr << "INFILE:" << endl;
+	cerr << "  File compressed with bwzip.x (without -dedup), the original input must not" << endl;
+	cerr << "  contain nullbytes" << endl;
+	cerr << "TFMOUTFILE:" << endl;
+	cerr << "  File where to store the serialized tunneled fm index. If the input consists of" << endl;
+	cerr << "  multiple blocks, the index of block k is stored in TFMOUTFILE.k" << endl;
+};
+
+int main( int argc, char **argv ) {
+	//analyse args
+	bool informative = false; //informative mode
+	string infile;
+	string outfile;
+
+	//check parameters
+	if (argc < 3) {
+		printUsage( argv );
+		cerr << "At least 2 parameters expected" << endl;
+		return 1;
+	}
+	for (int i = 1; i < argc - 2; i++) { //analyze options
+		if (strcmp(argv[i], "-i") == 0) {
+			informative = true;
+		}
+		else {
+			printUsage(argv);
+			cerr << "Unknown option " << argv[i] << endl;
+			return 1;
+		}
+	}
+	infile = argv[argc-2];
+	outfile = argv[argc-1];
+
+	//open stream for infile
+	ifstream fin{ infile };
+	if (!fin) {
+		printUsage(argv);
+		cerr << "unable to open file \"" << infile << "\"" << endl;
+		return 1;
+	}
+
+	//read first line of input and decide what to do
+	string tstrat;
+	getline( fin, tstrat );
+	try {
+		if (tstrat == "non") {
+			return bwz_to_tfm<tp_strategy_none>( fin, outfile, informative );
+		}
+		else if (tstrat == "hir") {
+			return bwz_to_tfm<tp_strategy_hirsch>( fin, outfile, informative );
+		}
+		else if (tstrat == "grd") {
+			return bwz_to_tfm<tp_strategy_greedy>( fin, outfile, informative );
+		}
+		else if (tstrat == "gdu") {
+			return bwz_to_tfm<tp_strategy_greedy_update>( fin, outfile, informative );
+		}
+		else if (tstrat == "bep") {
+			return bwz_to_tfm<tp_strategy_bestp>( fin, outfile, informative );
+		}
+	} catch (const invalid_argument &e) {
+		cerr << "unable to convert \"" << infile << "\": " << e.what() << endl;
+		return 1;
+	}
+	printUsage( argv );
+	cerr << "Unknown tunneling strategy " << tstrat << " in the encoding of " << infile << ", unable to convert" << endl;
+	return 1;
+}
+
+template<typename t_tunnel_strat>
+int bwz_to_tfm( istream &in, const string &outfile, bool informative ) {
+	//read post stage and its suffixes
+	string post_stage;
+	getline( in, post_stage );
+	bool dedicated_aux = false;
+	size_t flags = post_stage.find( '+' );
+	for (size_t p = flags; p != string::npos; ) {
+		size_t q = post_stage.find( '+', p + 1 );
+		string flag = post_stage.substr( p, (q == string::npos) ? string::npos : q - p );
+		if (flag == AUX_CODER_ID) {
+			dedicated_aux = true;
+		}
+		else {
+			cerr << "Unsupported post stage flag " << flag << " used to compress file, unable to convert" << endl;
+			return 1;
+		}
+		p = q;
+	}
+	post_stage = post_stage.substr( 0, flags );
+	if (post_stage == "w94") {
+		return bwz_to_tfm<t_tunnel_strat,bw94_poststage>( in, outfile, informative, dedicated_aux );
+	}
+	else if (post_stage == "w9f") {
+		return bwz_to_tfm<t_tunnel_strat,bw94f_poststage>( in, outfile, informative, dedicated_aux );
+	}
+	else if (post_stage == "bcm") {
+		return bwz_to_tfm<t_tunnel_strat,bcm_poststage>( in, outfile, informative, dedicated_aux );
+	}
+	else if (post_stage == "bcs") {
+		return bwz_to_tfm<t_tunnel_strat,bcm_segmented_poststage>( in, outfile, informative, dedicated_aux );
+	}
+	else if (post_stage == "bcr") {
+		return bwz_to_tfm<t_tunnel_strat,bcm_rle_poststage>( in, outfile, informative, dedicated_aux );
+	}
+	else if (post_stage == "rns") {
+		return bwz_to_tfm<t_tunnel_strat,rans_poststage>( in, outfile, informative, dedicated_aux );
+	}
+	else {
+		cerr << "Unknown post stage " << post_stage << " used to compress file, unable to convert" << endl;
+		return 1;
+	}
+}
+
+template<typename t_tunnel_strat, typename t_post_stage>
+int bwz_to_tfm( istream &in, const string &outfile, bool informative, bool dedicated_aux ) {
+	bwt_compressor<t_tunnel_strat,t_post_stage> compressor;
+	compressor.set_dedicated_aux( dedicated_aux );
+	working_memory wm;
+
+	size_t converted = 0;
+	auto convert_block = [&]( size_t block, size_t blocks, t_size_t n,
+	                          t_string_t &tbwt, twobitvector &aux, t_idx_t tbwt_idx ) {
+		++converted;
+		string tfm_file = (blocks == 1) ? outfile : outfile + "." + to_string( block );
+
+		//map tunneled bwt and aux to the components of a tfm index
+		sdsl::bit_vector dout;
+		sdsl::bit_vector din;
+		t_string_t L;
+		t_size_t expanded = tbwt_to_tfm( tbwt, aux, tbwt_idx, n, L, dout, din, wm );
+
+		//move L into the buffer used for the construction of the index, which is kept in memory if it
+		//fits. It is created only after the mapping succeeded, such that no buffer file is left behind
+		//if the block is invalid
+		string L_buf_filename = tfm_buffer_file_name( sdsl::tmp_file( tfm_file ), L.size(), tfm_buffer_mode::automatic );
+		sdsl::int_vector_buffer<8> L_buf( L_buf_filename, std::ios::out );
+		for (t_idx_t i = 0; i < L.size(); i++) {
+			L_buf[i] = L[i];
+		}
+		t_string_t().swap( L );
+		tfm_index<> tfm;
+		construct_tfm_index( tfm, (uint64_t)n + 1, std::move( L_buf ), std::move( dout ), std::move( din ) );
+		L_buf.close();
+		sdsl::remove( L_buf_filename );
+
+		if (informative) {
+			cout << "block\t" << block << endl;
+			cout << "input_length\t" << tfm.size() << endl;
+			cout << "tfm_length\t" << tfm.L.size() << endl;
+			cout << "expanded_tunnels\t" << expanded << endl;
+		}
+		store_to_file( tfm, tfm_file );
+	};
+	compressor.decode_tbwts( in, convert_block );
+	if (converted == 0) { //empty input consists of no blocks
+		t_string_t tbwt;
+		twobitvector aux;
+		aux.resize( 1 );	aux[0] = aux_encoding::REG;
+		convert_block( 0, 1, 0, tbwt, aux, 0 );
+	}
+	return 0;
+}
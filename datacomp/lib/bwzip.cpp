@@ -26,13 +26,20 @@
  * Copyright (c) 2017 Uwe Baier All Rights Reserved.
  */
 
+#include <chrono>
+#include <errno.h>
+#include <limits.h>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
+#include <stdlib.h>
 #include <string>
 #include <string.h>
+#include <sys/stat.h>
 
+#include "async_io.hpp"
 #include "bwt_compressor.hpp"
+#include "solid_archive.hpp"
 
 //tunnel planning strategies
 #include "tp_strategy_none.hpp"
@@ -43,30 +50,75 @@
 
 //post stages
 #include "bcm_poststage.hpp"
+#include "bcm_rle_poststage.hpp"
+#include "bcm_segmented_poststage.hpp"
 #include "bw94_poststage.hpp"
+#include "rans_poststage.hpp"
 
 using namespace std;
 
 enum bwt_tunnel_strategy{ NONE, HIRSCH, GREEDY, GREEDY_UPDATE, BESTP };
-enum bwt_post_stage{ BW94, BCM };
+enum bwt_post_stage{ BW94, BW94F, BCM, BCMS, BCMR, RANS };
+
+//! options passed to the compressor
+struct bw_options {
+	bool informative = false; //informative mode
+	bool huge_pages = false; //transparent huge pages
+	bool dedicated_aux = true; //encode aux with the dedicated aux coder
+	uint64_t dedup_window = 0; //window of long-range match removal in bytes (0 if disabled)
+	streamsize block_size = 0; //block size in bytes (0 for the maximal block size)
+	bool archive = false; //solid archive of multiple files
+	string member; //member of an archive to be extracted (empty to extract all)
+};
+
+//suffix of the post stage identifier if the dedicated aux coder is used
+const string AUX_CODER_ID = "+aux";
+//suffix of the post stage identifier if long-range matches are removed, followed by the window in MiB
+const string DEDUP_ID = "+dd";
+//suffix of the post stage identifier if multiple files are compressed as a solid archive
+const string ARCHIVE_ID = "+ar";
+
+//returns the suffixes of the post stage identifier for the given options
+string post_stage_flags( const bw_options &opt ) {
+	string flags = opt.dedicated_aux ? AUX_CODER_ID : "";
+	if (opt.dedup_window != 0)	flags += DEDUP_ID + to_string( opt.dedup_window >> 20 );
+	if (opt.archive)        	flags += ARCHIVE_ID;
+	return flags;
+}
+
+//time spent waiting for background reads and writes, printed in informative mode
+struct io_stall_times {
+	chrono::nanoseconds read{ 0 };
+	chrono::nanoseconds write{ 0 };
+} io_stalls;
 
 //forward declarations
 template<typename t_tunnel_strat>
-int bw_compress( istream &in, ostream &out, bwt_post_stage post_stage, bool informative );
+int bw_compress( istream &in, ostream &out, bwt_post_stage post_stage, const bw_options &opt );
 template<typename t_tunnel_strat, typename t_post_stage>
-int bw_compress( istream &in, ostream &out, bool informative );
+int bw_compress( istream &in, ostream &out, const bw_options &opt );
 
 template<typename t_tunnel_strat>
-int bw_decompress( istream &in, ostream &out, bool informative );
+int bw_decompress( istream &in, const string &outfile, const bw_options &opt );
 template<typename t_tunnel_strat, typename t_post_stage>
-int bw_decompress( istream &in, ostream &out, bool informative );
+int bw_decompress( istream &in, const string &outfile, const bw_options &opt );
 
 void printUsage( char **argv ) {
 	cerr << "USAGE: " << argv[0] << " [OPTIONS] INFILE OUTFILE" << endl;
 	cerr << "OPTIONS:" << endl;
 	cerr << "  -d\tdecompress data (compression is default)." << endl;
-	cerr << "    \tIf enabled, ignores all except of the -i options." << endl;
+	cerr << "    \tIf enabled, ignores all except of the -i, -thp and -m options." << endl;
 	cerr << "  -i\tEnable informative mode, printing additional information" << endl;
+	cerr << "  -thp\tback working memory with transparent huge pages (if supported)" << endl;
+	cerr << "  -paux\tencode auxiliary data with the post stage instead of the dedicated aux coder" << endl;
+	cerr << "  -dedup [WINDOW]\tremove long-range matches before the BWT, which may refer up to" << endl;
+	cerr << "                 \tWINDOW MiB back, also into previous blocks" << endl;
+	cerr << "  -bs [SIZE]\tcompress the input in blocks of SIZE MiB (default: as big as possible)" << endl;
+	cerr << "  -a\tcreate a solid archive of multiple files. INFILE then lists the files to be" << endl;
+	cerr << "    \tcompressed (one per line), which are concatenated and compressed in blocks." << endl;
+	cerr << "    \tDecompressing an archive extracts all files into the directory OUTFILE." << endl;
+	cerr << "  -m [MEMBER]\tonly extract file MEMBER of an archive to OUTFILE (requires -d)," << endl;
+	cerr << "             \tdecompressing only the blocks containing it" << endl;
 	cerr << "  -tstrat [STRATEGY]\ttunneling strategy to be used. Must be one of the following:" << endl;
 	cerr << "                    \tnone : enable no tunneling" << endl;
 	cerr << "                    \thirsch : hirsch tunnel planning strategy (default)" << endl;
@@ -78,8 +130,16 @@ void printUsage( char **argv ) {
 	cerr << "                  \tbw94 : compression scheme from 1994 using move-to-front transform," << endl;
 	cerr << "                  \t       run-length encoding and source encoding, as described" << endl;
 	cerr << "                  \t       by Mike Burrows and David J. Wheeler" << endl;
+	cerr << "                  \tbw94f : bw94 scheme using an adaptive frequency model" << endl;
+	cerr << "                  \t        with logarithmic update time" << endl;
 	cerr << "                  \tbcm :  compression using a bwt-optimized context mixer (default)" << endl;
 	cerr << "                  \t       by Ilya Muravyov" << endl;
+	cerr << "                  \tbcms[SEGMENTS] : bcm on up to SEGMENTS independently modelled" << endl;
+	cerr << "                  \t                 segments, which are coded concurrently (default 4)" << endl;
+	cerr << "                  \tbcmr : bcm on run heads, with run lengths coded by an adaptive" << endl;
+	cerr << "                  \t       integer model, for highly repetitive inputs" << endl;
+	cerr << "                  \trans : move-to-front transform and run-length encoding," << endl;
+	cerr << "                  \t       followed by interleaved rANS coding for fast decoding" << endl;
 	cerr << "INFILE:" << endl;
 	cerr << "  File to be compressed or decompressed if -d is set" << endl;
 	cerr << "OUTFILE:" << endl;
@@ -89,7 +149,7 @@ void printUsage( char **argv ) {
 int main( int argc, char **argv ) {
 	//analyse args
 	bool compress = true; //compress or decompress
-	bool informative = false; //informative mode
+	bw_options opt; //compressor options
 	string infile;
 	string outfile;
 
@@ -107,7 +167,7 @@ int main( int argc, char **argv ) {
 	bwt_post_stage post_stage = BCM;
 
 	//last option in arguments
-	enum {NO, COMP, INF, TSTRAT, PSTAGE} last_option;
+	enum {NO, COMP, INF, THP, PAUX, ARCH, DEDUP, BSIZE, MEMBER, TSTRAT, PSTAGE} last_option;
 	last_option = NO;
 
 	for (int i = 1; i < argc - 2; i++) { //analyze options
@@ -115,13 +175,37 @@ int main( int argc, char **argv ) {
 		case NO: //last options that require no additional parameter
 		case COMP:
 		case INF:
+		case THP:
+		case PAUX:
+		case ARCH:
 			if (strcmp(argv[i], "-d") == 0) { //decompress
 				last_option = COMP;
 				compress = false;
 			}
 			else if (strcmp(argv[i], "-i") == 0) {
 				last_option = INF;
-				informative = true;
+				opt.informative = true;
+			}
+			else if (strcmp(argv[i], "-thp") == 0) {
+				last_option = THP;
+				opt.huge_pages = true;
+			}
+			else if (strcmp(argv[i], "-paux") == 0) {
+				last_option = PAUX;
+				opt.dedicated_aux = false;
+			}
+			else if (strcmp(argv[i], "-dedup") == 0) {
+				last_option = DEDUP;
+			}
+			else if (strcmp(argv[i], "-bs") == 0) {
+				last_option = BSIZE;
+			}
+			else if (strcmp(argv[i], "-a") == 0) {
+				last_option = ARCH;
+				opt.archive = true;
+			}
+			else if (strcmp(argv[i], "-m") == 0) {
+				last_option = MEMBER;
 			}
 			else if (strcmp(argv[i], "-tstrat") == 0) {
 				last_option = TSTRAT;
@@ -135,6 +219,32 @@ int main( int argc, char **argv ) {
 				return 1;
 			}
 			break;
+		case DEDUP: //determine window of long-range match removal
+			{
+				int w = atoi( argv[i] );
+				if (w < 1) {
+					cerr << "window of long-range match removal must be at least 1 MiB" << endl;
+					return 1;
+				}
+				opt.dedup_window = (uint64_t)w << 20;
+			}
+			last_option = NO;
+			break;
+		case BSIZE: //determine block size
+			{
+				int bs = atoi( argv[i] );
+				if (bs < 1 || ((streamsize)bs << 20) > (streamsize)t_max_size) {
+					cerr << "block size must be between 1 MiB and " << (t_max_size >> 20) << " MiB" << endl;
+					return 1;
+				}
+				opt.block_size = (streamsize)bs << 20;
+			}
+			last_option = NO;
+			break;
+		case MEMBER: //determine member to be extracted
+			opt.member = argv[i];
+			last_option = NO;
+			break;
 		case TSTRAT: //determine tunneling strategy
 			if (strcmp(argv[i], "none") == 0) {
 				 tunnel_strategy = NONE;
@@ -168,9 +278,27 @@ int main( int argc, char **argv ) {
 			if (strcmp(argv[i], "bcm") == 0) {
 				post_stage = BCM;
 			}
+			else if (strncmp(argv[i], "bcms", 4) == 0) {
+				int k = (argv[i][4] != '\0') ? atoi( argv[i] + 4 ) : 4;
+				if (k < 1 || k > 255) {
+					cerr << "number of bcm segments must be between 1 and 255" << endl;
+					return 1;
+				}
+				bcm_segmented_poststage::segments() = k;
+				post_stage = BCMS;
+			}
+			else if (strcmp(argv[i], "bcmr") == 0) {
+				post_stage = BCMR;
+			}
 			else if (strcmp(argv[i], "bw94") == 0) {
 				post_stage = BW94;
 			}
+			else if (strcmp(argv[i], "bw94f") == 0) {
+				post_stage = BW94F;
+			}
+			else if (strcmp(argv[i], "rans") == 0) {
+				post_stage = RANS;
+			}
 			else {
 				printUsage(argv);
 				cerr << "Unknown post stage option " << argv[i] << endl;
@@ -183,87 +311,172 @@ int main( int argc, char **argv ) {
 	infile = argv[argc-2];
 	outfile = argv[argc-1];
 
-	//open streams for infile and outfile
-	ifstream fin{ infile };
-	ofstream fout{ outfile, ofstream::out | ofstream::trunc };
-	if (!fin) {
+	if (!compress && opt.archive) {
 		printUsage(argv);
-		cerr << "unable to open file \"" << infile << "\"" << endl;
+		cerr << "option -a is only allowed for compression, archives are detected on decompression" << endl;
 		return 1;
-	} else if (!fout) {
+	} else if (compress && !opt.member.empty()) {
 		printUsage(argv);
-		cerr << "unable to open file \"" << outfile << "\"" << endl;
+		cerr << "option -m requires -d" << endl;
 		return 1;
 	}
 
+	//open streams for infile and outfile (the latter is opened on decompression,
+	// as archives are extracted into a directory). Input is read ahead in the background.
+	ifstream fin_file{ infile };
+	if (!fin_file) {
+		printUsage(argv);
+		cerr << "unable to open file \"" << infile << "\"" << endl;
+		return 1;
+	}
+	async_input_buf fin_buf( fin_file.rdbuf() );
+	istream fin( &fin_buf );
+
+	int res = 1;
 	if (compress) {
-		switch (tunnel_strategy) {
-		case NONE:
-			fout << "non" << endl;
-			return bw_compress<tp_strategy_none>( fin, fout, post_stage, informative );
-		case HIRSCH:
-			fout << "hir" << endl;
-			return bw_compress<tp_strategy_hirsch>( fin, fout, post_stage, informative );
-		case GREEDY:
-			fout << "grd" << endl;
-			return bw_compress<tp_strategy_greedy>( fin, fout, post_stage, informative );
-		case GREEDY_UPDATE:
-			fout << "gdu" << endl;
-			return bw_compress<tp_strategy_greedy_update>( fin, fout, post_stage, informative );
-		case BESTP:
-			fout << "bep" << endl;
-			return bw_compress<tp_strategy_bestp>( fin, fout, post_stage, informative );
+		ofstream fout_file{ outfile, ofstream::out | ofstream::trunc };
+		if (!fout_file) {
+			printUsage(argv);
+			cerr << "unable to open file \"" << outfile << "\"" << endl;
+			return 1;
 		}
+		io_stalls.write += write_behind( fout_file.rdbuf(), [&]( ostream &fout ) {
+			switch (tunnel_strategy) {
+			case NONE:
+				fout << "non" << endl;
+				res = bw_compress<tp_strategy_none>( fin, fout, post_stage, opt );
+				break;
+			case HIRSCH:
+				fout << "hir" << endl;
+				res = bw_compress<tp_strategy_hirsch>( fin, fout, post_stage, opt );
+				break;
+			case GREEDY:
+				fout << "grd" << endl;
+				res = bw_compress<tp_strategy_greedy>( fin, fout, post_stage, opt );
+				break;
+			case GREEDY_UPDATE:
+				fout << "gdu" << endl;
+				res = bw_compress<tp_strategy_greedy_update>( fin, fout, post_stage, opt );
+				break;
+			case BESTP:
+				fout << "bep" << endl;
+				res = bw_compress<tp_strategy_bestp>( fin, fout, post_stage, opt );
+				break;
+			}
+		} );
 	} else {
 		//read first line of input and decide what to do
 		string tstrat;
 		getline( fin, tstrat );
 		if (tstrat == "non") {
-			return bw_decompress<tp_strategy_none>( fin, fout, informative );
+			res = bw_decompress<tp_strategy_none>( fin, outfile, opt );
 		}
 		else if (tstrat == "hir") {
-			return bw_decompress<tp_strategy_hirsch>( fin, fout, informative );
+			res = bw_decompress<tp_strategy_hirsch>( fin, outfile, opt );
 		}
 		else if (tstrat == "grd") {
-			return bw_decompress<tp_strategy_greedy>( fin, fout, informative );
+			res = bw_decompress<tp_strategy_greedy>( fin, outfile, opt );
 		}
 		else if (tstrat == "gdu") {
-			return bw_decompress<tp_strategy_greedy_update>( fin, fout, informative );
+			res = bw_decompress<tp_strategy_greedy_update>( fin, outfile, opt );
 		}
 		else if (tstrat == "bep") {
-			return bw_decompress<tp_strategy_bestp>( fin, fout, informative );
+			res = bw_decompress<tp_strategy_bestp>( fin, outfile, opt );
+		}
+		else {
+			printUsage( argv );
+			cerr << "Unknown tunneling strategy " << tstrat << "in the encoding of " << infile << ", unable to decompress" << endl;
+			return 1;
 		}
-		printUsage( argv );
-		cerr << "Unknown tunneling strategy " << tstrat << "in the encoding of " << infile << ", unable to decompress" << endl;
-		return 1;
 	}
-	return 0;	
+	io_stalls.read += fin_buf.stall_time();
+	if (opt.informative) {
+		cout << "read_stall_time\t" << chrono::duration_cast<chrono::milliseconds>( io_stalls.read ).count() << endl;
+		cout << "write_stall_time\t" << chrono::duration_cast<chrono::milliseconds>( io_stalls.write ).count() << endl;
+	}
+	return res;
 }
 
 template<typename t_tunnel_strat>
-int bw_compress( istream &in, ostream &out, bwt_post_stage post_stage, bool informative ) {
+int bw_compress( istream &in, ostream &out, bwt_post_stage post_stage, const bw_options &opt ) {
 	//output post stage identifier
 	switch (post_stage) {
 	case BW94:
-		out << "w94" << endl;
-		return bw_compress<t_tunnel_strat,bw94_poststage>( in, out, informative );
+		out << "w94" << post_stage_flags( opt ) << endl;
+		return bw_compress<t_tunnel_strat,bw94_poststage>( in, out, opt );
+	case BW94F:
+		out << "w9f" << post_stage_flags( opt ) << endl;
+		return bw_compress<t_tunnel_strat,bw94f_poststage>( in, out, opt );
 	case BCM:
-		out << "bcm" << endl;
-		return bw_compress<t_tunnel_strat,bcm_poststage>( in, out, informative );
+		out << "bcm" << post_stage_flags( opt ) << endl;
+		return bw_compress<t_tunnel_strat,bcm_poststage>( in, out, opt );
+	case BCMS:
+		out << "bcs" << post_stage_flags( opt ) << endl;
+		return bw_compress<t_tunnel_strat,bcm_segmented_poststage>( in, out, opt );
+	case BCMR:
+		out << "bcr" << post_stage_flags( opt ) << endl;
+		return bw_compress<t_tunnel_strat,bcm_rle_poststage>( in, out, opt );
+	case RANS:
+		out << "rns" << post_stage_flags( opt ) << endl;
+		return bw_compress<t_tunnel_strat,rans_poststage>( in, out, opt );
 	}
 	return 1;
 }
 
 template<typename t_tunnel_strat>
-int bw_decompress( istream &in, ostream &out, bool informative ) {
-	//read post stage
+int bw_decompress( istream &in, const string &outfile, const bw_options &opt ) {
+	//read post stage and its suffixes
 	string post_stage;
 	getline( in, post_stage );
+	bw_options dopt = opt;
+	dopt.dedicated_aux = false;
+	dopt.dedup_window = 0;
+	dopt.archive = false;
+	size_t flags = post_stage.find( '+' );
+	for (size_t p = flags; p != string::npos; ) {
+		size_t q = post_stage.find( '+', p + 1 );
+		string flag = post_stage.substr( p, (q == string::npos) ? string::npos : q - p );
+		if (flag == AUX_CODER_ID) {
+			dopt.dedicated_aux = true;
+		}
+		else if (flag.compare( 0, DEDUP_ID.size(), DEDUP_ID ) == 0) {
+			//window in MiB, within the range accepted on compression
+			const char *w = flag.c_str() + DEDUP_ID.size();
+			char *end = nullptr;
+			uint64_t mib = (*w >= '0' && *w <= '9') ? strtoull( w, &end, 10 ) : 0;
+			if (mib < 1 || mib > (uint64_t)INT_MAX || *end != '\0') {
+				cerr << "Invalid window of long-range match removal in post stage flag " << flag << ", unable to decompress" << endl;
+				return 1;
+			}
+			dopt.dedup_window = mib << 20;
+		}
+		else if (flag == ARCHIVE_ID) {
+			dopt.archive = true;
+		}
+		else {
+			cerr << "Unknown post stage flag " << flag << " used to compress file, unable to decompress" << endl;
+			return 1;
+		}
+		p = q;
+	}
+	post_stage = post_stage.substr( 0, flags );
 	if (post_stage == "w94") {
-		return bw_decompress<t_tunnel_strat,bw94_poststage>( in, out, informative );
+		return bw_decompress<t_tunnel_strat,bw94_poststage>( in, outfile, dopt );
+	}
+	else if (post_stage == "w9f") {
+		return bw_decompress<t_tunnel_strat,bw94f_poststage>( in, outfile, dopt );
 	}
 	else if (post_stage == "bcm") {
-		return bw_decompress<t_tunnel_strat,bcm_poststage>( in, out, informative );
+		return bw_decompress<t_tunnel_strat,bcm_poststage>( in, outfile, dopt );
+	}
+	else if (post_stage == "bcs") {
+		return bw_decompress<t_tunnel_strat,bcm_segmented_poststage>( in, outfile, dopt );
+	}
+	else if (post_stage == "bcr") {
+		return bw_decompress<t_tunnel_strat,bcm_rle_poststage>( in, outfile, dopt );
+	}
+	else if (post_stage == "rns") {
+		return bw_decompress<t_tunnel_strat,rans_poststage>( in, outfile, dopt );
 	}
 	else {
 		cerr << "Unknown post stage " << post_stage << " used to compress file, unable to decompress" << endl;
@@ -272,17 +485,113 @@ int bw_decompress( istream &in, ostream &out, bool informative ) {
 }
 
 template<typename t_tunnel_strat, typename t_post_stage>
-int bw_compress( istream &in, ostream &out, bool informative ) {
+int bw_compress( istream &in, ostream &out, const bw_options &opt ) {
 	bwt_compressor<t_tunnel_strat,t_post_stage> compressor;
-	compressor.set_quiet( !informative );
-	compressor.compress( in, out );
+	compressor.set_quiet( !opt.informative );
+	compressor.set_huge_pages( opt.huge_pages );
+	compressor.set_dedicated_aux( opt.dedicated_aux );
+	compressor.set_dedup_window( opt.dedup_window );
+	if (opt.block_size != 0)	compressor.set_block_size( opt.block_size );
+	if (!opt.archive) {
+		compressor.compress( in, out );
+		return 0;
+	}
+
+	//collect the files listed in the input, and store their index in front of the archive
+	member_index idx;
+	idx.set_block_size( compressor.get_block_size() );
+	string name;
+	while (getline( in, name )) {
+		if (name.empty())	continue;
+		ifstream member{ name, ifstream::in | ifstream::binary | ifstream::ate };
+		if (!member) {
+			cerr << "unable to open file \"" << name << "\"" << endl;
+			return 1;
+		}
+		idx.add( name, (uint64_t)member.tellg() );
+	}
+	idx.serialize( out );
+
+	member_input_buf members_buf( idx );
+	async_input_buf members_ahead( &members_buf );
+	istream members( &members_ahead );
+	compressor.compress( members, out );
+	io_stalls.read += members_ahead.stall_time();
 	return 0;
 }
 
 template<typename t_tunnel_strat, typename t_post_stage>
-int bw_decompress( istream &in, ostream &out, bool informative ) {
+int bw_decompress( istream &in, const string &outfile, const bw_options &opt ) {
 	bwt_compressor<t_tunnel_strat,t_post_stage> compressor;
-	compressor.set_quiet( !informative );
-	compressor.decompress( in, out );
+	compressor.set_quiet( !opt.informative );
+	compressor.set_huge_pages( opt.huge_pages );
+	compressor.set_dedicated_aux( opt.dedicated_aux );
+	compressor.set_dedup_window( opt.dedup_window );
+	if (!opt.archive) {
+		if (!opt.member.empty()) {
+			cerr << "input is no archive, unable to extract member \"" << opt.member << "\"" << endl;
+			return 1;
+		}
+		ofstream fout{ outfile, ofstream::out | ofstream::trunc };
+		if (!fout) {
+			cerr << "unable to open file \"" << outfile << "\"" << endl;
+			return 1;
+		}
+		io_stalls.write += write_behind( fout.rdbuf(), [&]( ostream &out ) { compressor.decompress( in, out ); } );
+		return 0;
+	}
+
+	//read index of archive members
+	member_index idx;
+	try {
+		idx.load( in );
+	} catch (const invalid_argument &) {
+		cerr << "archive index is damaged, unable to decompress" << endl;
+		return 1;
+	}
+	if (idx.block_size() == 0 || idx.block_size() > (uint64_t)compressor.get_max_block_size()) {
+		cerr << "invalid block size in archive index, unable to decompress" << endl;
+		return 1;
+	}
+	compressor.set_block_size( idx.block_size() );
+
+	if (!opt.member.empty()) { //extract a single member, only decompressing the blocks it is stored in
+		const member_index::member *m = idx.find( opt.member );
+		if (m == nullptr) {
+			cerr << "archive does not contain member \"" << opt.member << "\"" << endl;
+			return 1;
+		}
+		ofstream fout{ outfile, ofstream::out | ofstream::trunc };
+		if (!fout) {
+			cerr << "unable to open file \"" << outfile << "\"" << endl;
+			return 1;
+		}
+		try {
+			io_stalls.write += write_behind( fout.rdbuf(), [&]( ostream &out ) { compressor.decompress_range( in, out, m->offset, m->size ); } );
+		} catch (const runtime_error &e) {
+			cerr << e.what() << ", unable to decompress" << endl;
+			return 1;
+		}
+		fout.close();
+		if (!fout) {
+			cerr << "unable to write file \"" << outfile << "\"" << endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	//extract all members into directory outfile
+	if (mkdir( outfile.c_str(), 0777 ) != 0 && errno != EEXIST) {
+		cerr << "unable to create directory \"" << outfile << "\"" << endl;
+		return 1;
+	}
+	member_output_buf members_buf( idx, outfile );
+	try {
+		io_stalls.write += write_behind( &members_buf, [&]( ostream &members ) { compressor.decompress( in, members ); } );
+		members_buf.finish();
+	} catch (const runtime_error &e) {
+		cerr << e.what() << ", unable to decompress" << endl;
+		return 1;
+	}
 	return 0;
 }
@@ -21,46 +21,94 @@
  * SOFTWARE.
  */
 
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string>
 #include <string.h>
 #include <vector>
 
+#include "async_io.hpp"
+#include "aux_coder.hpp"
 #include "block_compressor.hpp"
 #include "twobitvector.hpp"
 
 //from ../seqana/include/
+#include "rle_wt.hpp"
 #include "tfm_index.hpp"
 #include <sdsl/io.hpp>
 
 //post stages
 #include "bcm_poststage.hpp"
+#include "bcm_rle_poststage.hpp"
+#include "bcm_segmented_poststage.hpp"
 #include "bw94_poststage.hpp"
+#include "rans_poststage.hpp"
 
 using namespace std;
 
-enum bwt_post_stage{ BW94, BCM };
+enum bwt_post_stage{ BW94, BW94F, BCM, BCMS, BCMR, RANS };
+
+//suffix of the post stage identifier if the dedicated aux coder is used
+const string AUX_CODER_ID = "+aux";
+//suffix of the post stage identifier if the index stores L run-length encoded
+const string RLE_L_ID = "+rle";
+//suffix of the post stage identifier if the distance of sampled text positions is stored
+const string SAMPLES_ID = "+smp";
+//suffix of the post stage identifier if the distance of checkpoints is stored
+const string CHECKPOINTS_ID = "+chk";
+
+//time spent waiting for background reads and writes, printed in informative mode
+struct io_stall_times {
+	chrono::nanoseconds read{ 0 };
+	chrono::nanoseconds write{ 0 };
+} io_stalls;
 
 //forward declarations
+template<typename t_post_stage, typename t_tfm_index>
+int tfm_compress_index( istream &in, ostream &out, bool dedicated_aux, uint64_t flags );
+
+template<typename t_post_stage, typename t_tfm_index>
+int tfm_decompress_index( istream &in, std::string &outfile, bool dedicated_aux, uint64_t flags );
+
+//! (de)compresses an index with plain or run-length encoded L, flags are the format flags
+//! of the index (see tfm_format_magic) marking the members stored in the compressed stream
 template<typename t_post_stage>
-int tfm_compress( istream &in, ostream &out );
+int tfm_compress( istream &in, ostream &out, bool dedicated_aux, uint64_t flags ) {
+	if (flags & tfm_format_rle_L)	return tfm_compress_index<t_post_stage,tfm_index<rle_wt<>>>( in, out, dedicated_aux, flags );
+	else				return tfm_compress_index<t_post_stage,tfm_index<>>( in, out, dedicated_aux, flags );
+}
 
 template<typename t_post_stage>
-int tfm_decompress( istream &in, std::string &outfile );
+int tfm_decompress( istream &in, std::string &outfile, bool dedicated_aux, uint64_t flags ) {
+	if (flags & tfm_format_rle_L)	return tfm_decompress_index<t_post_stage,tfm_index<rle_wt<>>>( in, outfile, dedicated_aux, flags );
+	else				return tfm_decompress_index<t_post_stage,tfm_index<>>( in, outfile, dedicated_aux, flags );
+}
 
 void printUsage( char **argv ) {
 	cerr << "USAGE: " << argv[0] << " [OPTIONS] INFILE OUTFILE" << endl;
 	cerr << "OPTIONS:" << endl;
 	cerr << "  -d\tdecompress tfm index (compression is default)." << endl;
-	cerr << "    \tIf enabled, ignores all other options." << endl;
+	cerr << "    \tIf enabled, ignores all except of the -i option." << endl;
+	cerr << "  -i\tEnable informative mode, printing the time waited for reading and writing" << endl;
+	cerr << "  -paux\tencode auxiliary data with the post stage instead of the dedicated aux coder" << endl;
 	cerr << "  -pstage [PSTAGE]\tpost stages used for the compression of the tunneled fm index. Must be one of" << endl;
 	cerr << "                  \tbw94 : compression scheme from 1994 using move-to-front transform," << endl;
 	cerr << "                  \t       run-length encoding and source encoding, as described" << endl;
 	cerr << "                  \t       by Mike Burrows and David J. Wheeler" << endl;
+	cerr << "                  \tbw94f : bw94 scheme using an adaptive frequency model" << endl;
+	cerr << "                  \t        with logarithmic update time" << endl;
 	cerr << "                  \tbcm :  compression using a bwt-optimized context mixer (default)" << endl;
 	cerr << "                  \t       by Ilya Muravyov" << endl;
+	cerr << "                  \tbcms[SEGMENTS] : bcm on up to SEGMENTS independently modelled" << endl;
+	cerr << "                  \t                 segments, which are coded concurrently (default 4)" << endl;
+	cerr << "                  \tbcmr : bcm on run heads, with run lengths coded by an adaptive" << endl;
+	cerr << "                  \t       integer model, for highly repetitive inputs" << endl;
+	cerr << "                  \trans : move-to-front transform and run-length encoding," << endl;
+	cerr << "                  \t       followed by interleaved rANS coding for fast decoding" << endl;
 	cerr << "INFILE:" << endl;
 	cerr << "  tfm index to be compressed or decompressed if -d is set" << endl;
 	cerr << "OUTFILE:" << endl;
@@ -70,6 +118,9 @@ void printUsage( char **argv ) {
 int main( int argc, char **argv ) {
 	//analyse args
 	bool compress = true; //compress or decompress
+	bool dedicated_aux = true; //encode aux with the dedicated aux coder
+	bool informative = false; //informative mode
+	uint64_t flags = 0; //format flags of the index members stored in the compressed stream
 	string infile;
 	string outfile;
 
@@ -84,17 +135,27 @@ int main( int argc, char **argv ) {
 	bwt_post_stage post_stage = BCM;
 
 	//last option in arguments
-	enum {NO, COMP, PSTAGE} last_option;
+	enum {NO, COMP, INF, PAUX, PSTAGE} last_option;
 	last_option = NO;
 
 	for (int i = 1; i < argc - 2; i++) { //analyze options
 		switch (last_option) {
 		case NO: //last options that require no additional parameter
 		case COMP:
+		case INF:
+		case PAUX:
 			if (strcmp(argv[i], "-d") == 0) { //decompress
 				last_option = COMP;
 				compress = false;
 			}
+			else if (strcmp(argv[i], "-i") == 0) {
+				last_option = INF;
+				informative = true;
+			}
+			else if (strcmp(argv[i], "-paux") == 0) {
+				last_option = PAUX;
+				dedicated_aux = false;
+			}
 			else if (strcmp(argv[i], "-pstage") == 0) {
 				last_option = PSTAGE;
 			}
@@ -108,9 +169,27 @@ int main( int argc, char **argv ) {
 			if (strcmp(argv[i], "bcm") == 0) {
 				post_stage = BCM;
 			}
+			else if (strncmp(argv[i], "bcms", 4) == 0) {
+				int k = (argv[i][4] != '\0') ? atoi( argv[i] + 4 ) : 4;
+				if (k < 1 || k > 255) {
+					cerr << "number of bcm segments must be between 1 and 255" << endl;
+					return 1;
+				}
+				bcm_segmented_poststage::segments() = k;
+				post_stage = BCMS;
+			}
+			else if (strcmp(argv[i], "bcmr") == 0) {
+				post_stage = BCMR;
+			}
 			else if (strcmp(argv[i], "bw94") == 0) {
 				post_stage = BW94;
 			}
+			else if (strcmp(argv[i], "bw94f") == 0) {
+				post_stage = BW94F;
+			}
+			else if (strcmp(argv[i], "rans") == 0) {
+				post_stage = RANS;
+			}
 			else {
 				printUsage(argv);
 				cerr << "Unknown post stage option " << argv[i] << endl;
@@ -123,10 +202,10 @@ int main( int argc, char **argv ) {
 	infile = argv[argc-2];
 	outfile = argv[argc-1];
 
-	//open streams for infile and outfile
-	ifstream fin{ infile };
+	//open streams for infile and outfile, input is read ahead in the background
+	ifstream fin_file{ infile };
 	ofstream fout{ outfile, ofstream::out | ofstream::trunc };
-	if (!fin) {
+	if (!fin_file) {
 		printUsage(argv);
 		cerr << "unable to open file \"" << infile << "\"" << endl;
 		return 1;
@@ -135,51 +214,140 @@ int main( int argc, char **argv ) {
 		cerr << "unable to open file \"" << outfile << "\"" << endl;
 		return 1;
 	}
+	async_input_buf fin_buf( fin_file.rdbuf() );
+	istream fin( &fin_buf );
 
+	int res = 1;
 	if (compress) {
-		switch (post_stage) {
-		case BW94:
-			fout << "w94" << endl;
-			return tfm_compress<bw94_poststage>( fin, fout );
-		case BCM:
-			fout << "bcm" << endl;
-			return tfm_compress<bcm_poststage>( fin, fout );
+		//choose the representation of L stored in the index
+		if (!load_tfm_format_flags( infile, flags )) {
+			cerr << "unable to read file \"" << infile << "\"" << endl;
+			return 1;
 		}
+		if (flags & tfm_format_fused_nav) {
+			cerr << "tfm index \"" << infile << "\" uses fused navigation bitvectors, which are not supported" << endl;
+			return 1;
+		}
+		flags &= tfm_format_rle_L | tfm_format_samples | tfm_format_checkpoints;
+		string suffixes = string( dedicated_aux ? AUX_CODER_ID : "" )
+		                + ((flags & tfm_format_rle_L) ? RLE_L_ID : "")
+		                + ((flags & tfm_format_samples) ? SAMPLES_ID : "")
+		                + ((flags & tfm_format_checkpoints) ? CHECKPOINTS_ID : "");
+		io_stalls.write += write_behind( fout.rdbuf(), [&]( ostream &out ) {
+			switch (post_stage) {
+			case BW94:
+				out << "w94" << suffixes << endl;
+				res = tfm_compress<bw94_poststage>( fin, out, dedicated_aux, flags );
+				break;
+			case BW94F:
+				out << "w9f" << suffixes << endl;
+				res = tfm_compress<bw94f_poststage>( fin, out, dedicated_aux, flags );
+				break;
+			case BCM:
+				out << "bcm" << suffixes << endl;
+				res = tfm_compress<bcm_poststage>( fin, out, dedicated_aux, flags );
+				break;
+			case BCMS:
+				out << "bcs" << suffixes << endl;
+				res = tfm_compress<bcm_segmented_poststage>( fin, out, dedicated_aux, flags );
+				break;
+			case BCMR:
+				out << "bcr" << suffixes << endl;
+				res = tfm_compress<bcm_rle_poststage>( fin, out, dedicated_aux, flags );
+				break;
+			case RANS:
+				out << "rns" << suffixes << endl;
+				res = tfm_compress<rans_poststage>( fin, out, dedicated_aux, flags );
+				break;
+			}
+		} );
 	} else {
 		fout.close();
-		//read first line of input and decide what to do
+		//read first line of input and its suffixes, and decide what to do
 		string post_stage;
 		getline( fin, post_stage );
-		if (post_stage == "w94") {
-			return tfm_decompress<bw94_poststage>( fin, outfile );
-		}
-		else if (post_stage == "bcm") {
-			return tfm_decompress<bcm_poststage>( fin, outfile );
+		dedicated_aux = false;
+		size_t suffixes = post_stage.find( '+' );
+		for (size_t p = suffixes; p != string::npos; ) {
+			size_t q = post_stage.find( '+', p + 1 );
+			string suffix = post_stage.substr( p, (q == string::npos) ? string::npos : q - p );
+			if (suffix == AUX_CODER_ID) {
+				dedicated_aux = true;
+			}
+			else if (suffix == RLE_L_ID) {
+				flags |= tfm_format_rle_L;
+			}
+			else if (suffix == SAMPLES_ID) {
+				flags |= tfm_format_samples;
+			}
+			else if (suffix == CHECKPOINTS_ID) {
+				flags |= tfm_format_checkpoints;
+			}
+			else {
+				cerr << "Unsupported post stage flag " << suffix << " used to compress index, unable to decompress" << endl;
+				return 1;
+			}
+			p = q;
 		}
-		else {
-			cerr << "Unknown post stage " << post_stage << " used to compress index, unable to decompress" << endl;
+		post_stage = post_stage.substr( 0, suffixes );
+		try {
+			if (post_stage == "w94") {
+				res = tfm_decompress<bw94_poststage>( fin, outfile, dedicated_aux, flags );
+			}
+			else if (post_stage == "w9f") {
+				res = tfm_decompress<bw94f_poststage>( fin, outfile, dedicated_aux, flags );
+			}
+			else if (post_stage == "bcm") {
+				res = tfm_decompress<bcm_poststage>( fin, outfile, dedicated_aux, flags );
+			}
+			else if (post_stage == "bcs") {
+				res = tfm_decompress<bcm_segmented_poststage>( fin, outfile, dedicated_aux, flags );
+			}
+			else if (post_stage == "bcr") {
+				res = tfm_decompress<bcm_rle_poststage>( fin, outfile, dedicated_aux, flags );
+			}
+			else if (post_stage == "rns") {
+				res = tfm_decompress<rans_poststage>( fin, outfile, dedicated_aux, flags );
+			}
+			else {
+				cerr << "Unknown post stage " << post_stage << " used to compress index, unable to decompress" << endl;
+				return 1;
+			}
+		} catch (const exception &e) {
+			cerr << "unable to decompress \"" << infile << "\", the compressed index is corrupt (" << e.what() << ")" << endl;
+			remove( outfile.c_str() );
 			return 1;
 		}
 	}
-	return 0;	
+	io_stalls.read += fin_buf.stall_time();
+	if (informative) {
+		cout << "read_stall_time\t" << chrono::duration_cast<chrono::milliseconds>( io_stalls.read ).count() << endl;
+		cout << "write_stall_time\t" << chrono::duration_cast<chrono::milliseconds>( io_stalls.write ).count() << endl;
+	}
+	return res;
 }
 
-template<typename t_post_stage>
-int tfm_compress( istream &in, ostream &out ) {
-	typedef tfm_index<>::size_type size_type;
-	tfm_index<> tfm;
+template<typename t_post_stage, typename t_tfm_index>
+int tfm_compress_index( istream &in, ostream &out, bool dedicated_aux, uint64_t flags ) {
+	typedef typename t_tfm_index::size_type size_type;
+	t_tfm_index tfm;
 	load( tfm, in );
-	//save original text length
+	//save original text length, distance of sampled text positions and checkpoints (if marked by
+	//SAMPLES_ID and CHECKPOINTS_ID)
 	block_compressor::write_primitive<size_type>( (size_type)tfm.size(), out );
+	if (flags & tfm_format_samples) {
+		block_compressor::write_primitive<size_type>( (size_type)tfm.sample_rate(), out );
+	}
+	if (flags & tfm_format_checkpoints) {
+		block_compressor::write_primitive<size_type>( (size_type)tfm.checkpoint_rate(), out );
+	}
 	//save L
 	block_compressor::write_primitive<size_type>( (size_type)tfm.L.size(), out );
-	{
-		std::vector<unsigned char> L( tfm.L.size() );
-		for (size_type i = 0; i < L.size(); i++) {
-			L[i] = (unsigned char)tfm.L[i];
-		}
-		t_post_stage::encode( L, out );
+	t_string_t L( tfm.L.size() );
+	for (size_type i = 0; i < L.size(); i++) {
+		L[i] = (unsigned char)tfm.L[i];
 	}
+	t_post_stage::encode( L, out );
 	//save auxiliary information
 	if (tfm.dout.size() != tfm.din.size()) {
 		cerr << "invalid tfm index" << endl;
@@ -192,33 +360,31 @@ int tfm_compress( istream &in, ostream &out ) {
 		for (size_type i = 0; i < aux.size(); i++) {
 			aux[i] = (tfm.dout[i] << 1) + tfm.din[i];
 		}
-		t_post_stage::encode( aux, out );
+		//the dedicated aux coder uses L[i] as context of aux[i]
+		if (dedicated_aux)	aux_coder::encode( aux, L, out );
+		else			t_post_stage::encode( aux, out );
 	}
 	return 0;
 }
 
-template<typename t_post_stage>
-int tfm_decompress( istream &in, std::string &outfile ) {
-	typedef tfm_index<>::size_type size_type;
-	//prepare components
+template<typename t_post_stage, typename t_tfm_index>
+int tfm_decompress_index( istream &in, std::string &outfile, bool dedicated_aux, uint64_t flags ) {
+	typedef typename t_tfm_index::size_type size_type;
+	//prepare components, streams without SAMPLES_ID (CHECKPOINTS_ID) store no sampled text positions (checkpoints)
 	uint64_t text_len = block_compressor::read_primitive<uint64_t>( in );
-	std::string L_buf_filename = sdsl::tmp_file(outfile);
-	sdsl::int_vector_buffer<8> L_buf( L_buf_filename, std::ios::out );
+	uint64_t sample_rate = (flags & tfm_format_samples) ? block_compressor::read_primitive<uint64_t>( in ) : 0;
+	uint64_t checkpoint_rate = (flags & tfm_format_checkpoints) ? block_compressor::read_primitive<uint64_t>( in ) : 0;
 	sdsl::bit_vector dout;
 	sdsl::bit_vector din;
 	//load L
-	{
-		std::vector<unsigned char> L( block_compressor::read_primitive<size_type>( in ) );
-		t_post_stage::decode( in, L );
-		for (size_type i = 0; i < L.size(); i++) {
-			L_buf[i] = L[i];
-		}
-	}
+	t_string_t L( block_compressor::read_primitive<size_type>( in ) );
+	t_post_stage::decode( in, L );
 	//load aux
 	{
 		twobitvector aux;
 		aux.resize( block_compressor::read_primitive<size_type>( in ) );
-		t_post_stage::decode( in, aux );
+		if (dedicated_aux)	aux_coder::decode( in, aux, L );
+		else			t_post_stage::decode( in, aux );
 		dout.resize( aux.size() );
 		din.resize( aux.size() );
 		for (size_type i = 0; i < aux.size(); i++) {
@@ -226,13 +392,31 @@ int tfm_decompress( istream &in, std::string &outfile ) {
 			din[i] = (aux[i] & 1u);
 		}
 	}
+	//move L into the buffer used for the construction of the index, which is kept in memory if it fits
+	std::string L_buf_filename = tfm_buffer_file_name( sdsl::tmp_file(outfile), L.size(), tfm_buffer_mode::automatic );
+	sdsl::int_vector_buffer<8> L_buf( L_buf_filename, std::ios::out );
+	for (size_type i = 0; i < L.size(); i++) {
+		L_buf[i] = L[i];
+	}
+	t_string_t().swap( L );
 	//construct index
-	tfm_index<> tfm;
+	t_tfm_index tfm;
 	construct_tfm_index( tfm, text_len, std::move( L_buf ), std::move( dout ), std::move( din ) );
 	L_buf.close();
+	if (sample_rate > 0) { //sampled text positions and checkpoints are not stored, but recomputed
+		construct_tfm_samples( tfm, sample_rate );
+	}
+	if (checkpoint_rate > 0) {
+		construct_tfm_checkpoints( tfm, checkpoint_rate );
+	}
 
-	//clean up and store result
+	//clean up and store result, writing behind the serialization
 	sdsl::remove( L_buf_filename );
-	store_to_file(tfm, outfile);
+	ofstream fout{ outfile, ofstream::out | ofstream::trunc | ofstream::binary };
+	if (!fout) {
+		cerr << "unable to open file \"" << outfile << "\"" << endl;
+		return 1;
+	}
+	io_stalls.write += write_behind( fout.rdbuf(), [&tfm]( ostream &out ) { tfm.serialize( out, nullptr, "" ); } );
 	return 0;
 }
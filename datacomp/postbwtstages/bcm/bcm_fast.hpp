@@ -0,0 +1,282 @@
+// This is a header file to cover the second stage BWT transformation of BCM,
+// invented by Ilya Muravyov, with a cache-optimized model layout.
+// Probabilities and coding are identical to the CM of bcm_ss.hpp, such that
+// both produce exactly the same output.
+
+#ifndef BCM_FAST_HPP
+#define BCM_FAST_HPP
+
+#include <streambuf>
+#include <vector>
+
+#include "bcm_ss.hpp"
+
+namespace bcm {
+
+//// BYTE SINKS AND SOURCES ///////////////////////////////////////////////////
+
+//byte sink appending to a memory buffer
+struct MemorySink
+{
+  std::vector<byte> &buf;
+
+  MemorySink(std::vector<byte> &b): buf(b) {}
+  void Put(int c)
+  {
+    buf.push_back(byte(c));
+  }
+};
+
+//byte source reading from a memory buffer
+struct MemorySource
+{
+  const byte *p;
+  const byte *end;
+
+  MemorySource(const byte *b, const byte *e): p(b), end(e) {}
+  int Get()
+  {
+    return (p<end)?*p++:-1;
+  }
+};
+
+//byte source reading from a stream buffer (using its inlined get area)
+struct StreamSource
+{
+  std::streambuf *sb;
+
+  StreamSource(std::streambuf *s): sb(s) {}
+  int Get()
+  {
+    return sb->sbumpc();
+  }
+};
+
+//// BWT ENCODER WITH INTERLEAVED COUNTERS ////////////////////////////////////
+
+//BWT encoder, where the order-0 counter and both SSE tables of a context node
+//share one 128-byte block, and the coder works on inlined sinks and sources.
+//The order-1 counters are not part of a node: the two counters of a bit are
+//counter1[c1][ctx] and counter1[c2][ctx], i.e. two different rows selected by
+//the preceding bytes. Moving them into the node of ctx would require all 256
+//rows per node (512 bytes), spreading the bits of a byte over 8 nodes instead of
+//one row. The row-major table keeps the 255 counters of a byte within one
+//512-byte row per preceding byte, so it is kept as is.
+struct CMFast
+{
+  struct alignas(128) Node
+  {
+    word p0; //counter0[ctx]
+    word sse[2][17]; //counter2[f][ctx]
+  };
+
+  uint low;
+  uint high;
+  uint code;
+  Node node[256];
+  word counter1[256][256]; //row-major by preceding byte, see above
+  int c1;
+  int c2;
+  int run;
+
+  CMFast()
+  {
+    low=0;
+    high=uint(-1);
+    code=0;
+    c1=0;
+    c2=0;
+    run=0;
+
+    for (int j=0; j<256; ++j)
+    {
+      node[j].p0=1<<15;
+      for (int i=0; i<2; ++i)
+      {
+        for (int k=0; k<17; ++k)
+          node[j].sse[i][k]=(k<<12)-(k==16);
+      }
+      for (int k=0; k<256; ++k)
+        counter1[k][j]=1<<15;
+    }
+  }
+
+  template<int RATE>
+  static void Update0(word &p)
+  {
+    p-=p>>RATE;
+  }
+
+  template<int RATE>
+  static void Update1(word &p)
+  {
+    p+=(p^65535)>>RATE;
+  }
+
+  template<class Sink>
+  void Shift(Sink &out)
+  {
+    while ((low^high)<(1<<24))
+    {
+      out.Put(low>>24);
+      low<<=8;
+      high=(high<<8)+255;
+    }
+  }
+
+  template<class Sink>
+  void EncodeBit0(uint p, Sink &out)
+  {
+    low+=((ulonglong(high-low)*(p<<(32-18)))>>32)+1;
+    Shift(out);
+  }
+
+  template<class Sink>
+  void EncodeBit1(uint p, Sink &out)
+  {
+    high=low+((ulonglong(high-low)*(p<<(32-18)))>>32);
+    Shift(out);
+  }
+
+  template<class Sink>
+  void Flush(Sink &out)
+  {
+    for (int i=0; i<4; ++i)
+    {
+      out.Put(low>>24);
+      low<<=8;
+    }
+  }
+
+  template<class Source>
+  void Init(Source &in)
+  {
+    for (int i=0; i<4; ++i)
+      code=(code<<8)+in.Get();
+  }
+
+  template<class Source>
+  int DecodeBit(uint p, Source &in)
+  {
+    const uint mid=low+((ulonglong(high-low)*(p<<(32-18)))>>32);
+    const int bit=(code<=mid);
+    if (bit)
+      high=mid;
+    else
+      low=mid+1;
+
+    while ((low^high)<(1<<24))
+    {
+      low<<=8;
+      high=(high<<8)+255;
+      code=(code<<8)+in.Get();
+    }
+
+    return bit;
+  }
+
+  //computes the probability of the next bit in context ctx, returns the
+  //position j of the used SSE interpolation entries
+  int Predict(int ctx, int f, int &j) const
+  {
+    const Node &n=node[ctx];
+    const int p0=n.p0;
+    const int p1=counter1[c1][ctx];
+    const int p2=counter1[c2][ctx];
+    const int p=((p0+p1)*7+p2+p2)>>4;
+
+    j=p>>12;
+    const int x1=n.sse[f][j];
+    const int x2=n.sse[f][j+1];
+    const int ssep=x1+(((x2-x1)*(p&4095))>>12);
+    return ssep*3+p;
+  }
+
+  void Update(int ctx, int f, int j, int bit)
+  {
+    Node &n=node[ctx];
+    if (bit)
+    {
+      Update1<2>(n.p0);
+      Update1<4>(counter1[c1][ctx]);
+      Update1<6>(n.sse[f][j]);
+      Update1<6>(n.sse[f][j+1]);
+    }
+    else
+    {
+      Update0<2>(n.p0);
+      Update0<4>(counter1[c1][ctx]);
+      Update0<6>(n.sse[f][j]);
+      Update0<6>(n.sse[f][j+1]);
+    }
+  }
+
+  template<class Sink>
+  void Encode(int c, Sink &out)
+  {
+    if (c1==c2)
+      ++run;
+    else
+      run=0;
+    const int f=(run>2);
+
+    int ctx=1;
+    while (ctx<256)
+    {
+      int j;
+      const uint p=Predict(ctx, f, j);
+      const int bit=c&128;
+      c+=c;
+
+      if (bit)
+      {
+        EncodeBit1(p, out);
+        Update(ctx, f, j, 1);
+        ctx+=ctx+1;
+      }
+      else
+      {
+        EncodeBit0(p, out);
+        Update(ctx, f, j, 0);
+        ctx+=ctx;
+      }
+    }
+
+    c2=c1;
+    c1=ctx&255;
+  }
+
+  template<class Source>
+  int Decode(Source &in)
+  {
+    if (c1==c2)
+      ++run;
+    else
+      run=0;
+    const int f=(run>2);
+
+    int ctx=1;
+    while (ctx<256)
+    {
+      int j;
+      const uint p=Predict(ctx, f, j);
+      if (DecodeBit(p, in))
+      {
+        Update(ctx, f, j, 1);
+        ctx+=ctx+1;
+      }
+      else
+      {
+        Update(ctx, f, j, 0);
+        ctx+=ctx;
+      }
+    }
+
+    c2=c1;
+    return c1=ctx&255;
+  }
+};
+
+};
+
+#endif
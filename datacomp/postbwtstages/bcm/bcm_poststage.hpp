@@ -29,12 +29,13 @@
 #ifndef BCM_POSTSTAGE_HPP
 #define BCM_POSTSTAGE_HPP
 
-#include "bcm_ss.hpp"
+#include "bcm_fast.hpp"
 
 #include <istream>
 #include <limits>
 #include <ostream>
 #include <stdexcept>
+#include <vector>
 
 class bcm_poststage {
 	
@@ -42,20 +43,24 @@ public:
 	//! encodes the transform t
 	template<class T>
 	static void encode( T &t, std::ostream &out ) {
-		bcm::CM cm;
+		bcm::CMFast cm;
+		std::vector<bcm::byte> buf;
+		bcm::MemorySink sink( buf );
 		for (unsigned long i = 0; i < t.size(); i++) {
-			cm.Encode( t[i], out );
+			cm.Encode( t[i], sink );
 		}
-		cm.Flush(out);
+		cm.Flush( sink );
+		out.write( (const char *)buf.data(), buf.size() );
 	}
 
 	//! decodes the transform and stores it in t
 	template<class T>
 	static void decode( std::istream &in, T &t ) {
-		bcm::CM cm;
-		cm.Init(in);
+		bcm::CMFast cm;
+		bcm::StreamSource source( in.rdbuf() );
+		cm.Init( source );
 		for (unsigned long i = 0; i < t.size(); i++) {
-			t[i] = cm.Decode(in);
+			t[i] = cm.Decode( source );
 		}
 	}
 };
@@ -0,0 +1,168 @@
+/*
+ * bcm_rle_poststage.hpp for BWT Tunneling
+ * Copyright (c) 2020 Uwe Baier All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BCM_RLE_POSTSTAGE_HPP
+#define BCM_RLE_POSTSTAGE_HPP
+
+#include "bcm_fast.hpp"
+
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+//! bcm post stage, which splits the transform into runs before context mixing.
+/*! the head of each run is coded using the bcm context mixer, its length is
+   coded with an adaptive binary model sharing the arithmetic coder of the
+   mixer. Long runs thus cost only a few binary decisions instead of eight per
+   character, which pays off on highly repetitive transforms.
+ */
+class bcm_rle_poststage {
+private:
+	static const int LEN_RATE = 4; //adaption rate of the run length model
+	static const uint64_t LEN_BITS = 64; //maximal number of bits of a run length
+	static const uint64_t LEN_CTX = 16; //number of distinguished previous run length magnitudes
+
+	//! adaptive model for run lengths.
+	/*! a length l is coded as the position b of its highest set bit in unary,
+	   followed by the remaining b bits from high to low. The unary code uses the
+	   magnitude of the previous run length as context, the remaining bits
+	   the magnitude and their position.
+	 */
+	class length_model {
+	private:
+		bcm::word m_unary[LEN_CTX][LEN_BITS];
+		bcm::word m_mantissa[LEN_BITS][LEN_BITS];
+		uint64_t m_prev = 0; //magnitude of the previous run length
+
+		static uint64_t magnitude( uint64_t l ) {
+			return 63 - __builtin_clzll( l );
+		};
+
+		template<class Sink>
+		static void encode_bit( bcm::CMFast &cm, bcm::word &p, uint64_t bit, Sink &out ) {
+			if (bit) {
+				cm.EncodeBit1( (bcm::uint)p << 2, out );
+				bcm::CMFast::Update1<LEN_RATE>( p );
+			} else {
+				cm.EncodeBit0( (bcm::uint)p << 2, out );
+				bcm::CMFast::Update0<LEN_RATE>( p );
+			}
+		};
+
+		template<class Source>
+		static uint64_t decode_bit( bcm::CMFast &cm, bcm::word &p, Source &in ) {
+			if (cm.DecodeBit( (bcm::uint)p << 2, in )) {
+				bcm::CMFast::Update1<LEN_RATE>( p );
+				return 1;
+			} else {
+				bcm::CMFast::Update0<LEN_RATE>( p );
+				return 0;
+			}
+		};
+	public:
+		length_model() {
+			for (uint64_t i = 0; i < LEN_BITS; i++) {
+				for (uint64_t j = 0; j < LEN_CTX; j++)	m_unary[j][i] = 1 << 15;
+				for (uint64_t j = 0; j < LEN_BITS; j++)	m_mantissa[j][i] = 1 << 15;
+			}
+		};
+
+		//! encodes run length l (at least 1)
+		template<class Sink>
+		void encode( bcm::CMFast &cm, uint64_t l, Sink &out ) {
+			uint64_t b = magnitude( l );
+			bcm::word *unary = m_unary[m_prev < LEN_CTX ? m_prev : LEN_CTX - 1];
+			for (uint64_t k = 0; k < b; k++)	encode_bit( cm, unary[k], 1, out );
+			if (b + 1 < LEN_BITS)			encode_bit( cm, unary[b], 0, out );
+			for (uint64_t k = b; k-- > 0; ) {
+				encode_bit( cm, m_mantissa[b][b-1-k], (l >> k) & 1u, out );
+			}
+			m_prev = b;
+		};
+
+		//! decodes a run length
+		template<class Source>
+		uint64_t decode( bcm::CMFast &cm, Source &in ) {
+			bcm::word *unary = m_unary[m_prev < LEN_CTX ? m_prev : LEN_CTX - 1];
+			uint64_t b = 0;
+			while (b + 1 < LEN_BITS && decode_bit( cm, unary[b], in ))	++b;
+			uint64_t l = 1;
+			for (uint64_t k = b; k-- > 0; ) {
+				l = (l << 1) | decode_bit( cm, m_mantissa[b][b-1-k], in );
+			}
+			m_prev = b;
+			return l;
+		};
+	};
+
+	//writes len copies of c to t[b..b+len)
+	template<class T>
+	static void fill( T &t, uint64_t b, uint64_t len, bcm::byte c ) {
+		for (uint64_t i = b; i < b + len; i++)	t[i] = c;
+	};
+
+	static void fill( std::vector<unsigned char> &t, uint64_t b, uint64_t len, bcm::byte c ) {
+		memset( t.data() + b, c, len );
+	};
+public:
+	//! encodes the transform t
+	template<class T>
+	static void encode( T &t, std::ostream &out ) {
+		if (t.size() == 0u)	return;
+		bcm::CMFast cm;
+		length_model lm;
+		std::vector<bcm::byte> buf;
+		bcm::MemorySink sink( buf );
+		for (uint64_t i = 0, j; i < t.size(); i = j) {
+			bcm::byte c = t[i];
+			for (j = i + 1; j < t.size() && t[j] == c; j++);
+			cm.Encode( c, sink );
+			lm.encode( cm, j - i, sink );
+		}
+		cm.Flush( sink );
+		out.write( (const char *)buf.data(), buf.size() );
+	}
+
+	//! decodes the transform and stores it in t
+	template<class T>
+	static void decode( std::istream &in, T &t ) {
+		if (t.size() == 0u)	return;
+		bcm::CMFast cm;
+		length_model lm;
+		bcm::StreamSource source( in.rdbuf() );
+		cm.Init( source );
+		for (uint64_t i = 0; i < t.size(); ) {
+			bcm::byte c = cm.Decode( source );
+			uint64_t len = lm.decode( cm, source );
+			if (len > t.size() - i)
+				throw std::invalid_argument("bcm run exceeds transform length");
+			fill( t, i, len, c );
+			i += len;
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,188 @@
+/*
+ * bcm_segmented_poststage.hpp for BWT Tunneling
+ * Copyright (c) 2020 Uwe Baier All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BCM_SEGMENTED_POSTSTAGE_HPP
+#define BCM_SEGMENTED_POSTSTAGE_HPP
+
+#include "bcm_fast.hpp"
+
+#include <algorithm>
+#include <future>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <stdint.h>
+#include <vector>
+
+//! bcm post stage, which splits the transform into independently modelled segments.
+/*! segments are encoded and decoded concurrently, each segment uses its own
+   context mixer. The stream starts with the number of segments and the encoded
+   length of each segment, followed by the encodings of all segments. More
+   segments allow more parallelism, but each segment has to learn its
+   statistics from scratch.
+   Parallelism is confined to the segments of a single transform: a tunneled
+   bwt and its aux are decoded one after the other by design, as the aux
+   coder models aux using the decoded tunneled bwt as context.
+ */
+class bcm_segmented_poststage {
+private:
+	static const uint64_t MIN_SEGMENT_SIZE = 1ul << 16; //minimal length of a segment
+	static const uint64_t SEGMENT_ALIGN = 64; //alignment of segment boundaries, s.t.
+	                                          //packed strings are not shared among segments
+
+	static void write_u64( uint64_t v, std::ostream &out ) {
+		for (unsigned b = 0; b < 8; b++) {
+			out.put( (char)(v >> (8 * b)) );
+		}
+	};
+
+	static uint64_t read_u64( std::istream &in ) {
+		uint64_t v = 0;
+		for (unsigned b = 0; b < 8; b++) {
+			v |= (uint64_t)(unsigned char)in.get() << (8 * b);
+		}
+		return v;
+	};
+
+	//returns the number of bytes left in in, or the maximal value if in is not seekable
+	static uint64_t remaining_input( std::istream &in ) {
+		std::streampos pos = in.tellg();
+		if (pos < 0)	return UINT64_MAX;
+		in.seekg( 0, std::ios_base::end );
+		std::streampos end = in.tellg();
+		in.seekg( pos );
+		return (end < pos) ? 0 : (uint64_t)(end - pos);
+	};
+
+	//returns an upper bound on the encoded length of a segment with m symbols,
+	//as the coder emits at most 4 bytes per coded bit plus 4 bytes on flush
+	static uint64_t max_segment_encoding( uint64_t m ) {
+		return 32 * m + 4;
+	};
+
+	//returns the start of segment j of k segments over a transform of length n
+	static uint64_t segment_start( uint64_t n, uint64_t k, uint64_t j ) {
+		if (j >= k)	return n;
+		return (n * j / k) & ~(SEGMENT_ALIGN - 1);
+	};
+
+	//encodes t[b..e)
+	template<class T>
+	static std::vector<bcm::byte> encode_segment( const T &t, uint64_t b, uint64_t e ) {
+		std::vector<bcm::byte> buf;
+		bcm::MemorySink sink( buf );
+		bcm::CMFast cm;
+		for (uint64_t i = b; i < e; i++) {
+			cm.Encode( t[i], sink );
+		}
+		cm.Flush( sink );
+		return buf;
+	};
+
+	//decodes t[b..e) from the encoding enc
+	template<class T>
+	static void decode_segment( const std::vector<bcm::byte> &enc, T &t, uint64_t b, uint64_t e ) {
+		bcm::MemorySource source( enc.data(), enc.data() + enc.size() );
+		bcm::CMFast cm;
+		cm.Init( source );
+		for (uint64_t i = b; i < e; i++) {
+			t[i] = cm.Decode( source );
+		}
+	};
+public:
+	//! maximal number of segments used for encoding (at least 1, at most 255)
+	static unsigned &segments() {
+		static unsigned k = 4;
+		return k;
+	};
+
+	//! encodes the transform t
+	template<class T>
+	static void encode( T &t, std::ostream &out ) {
+		uint64_t n = t.size();
+		if (n == 0u)	return;
+		uint64_t k = std::max<uint64_t>( 1, std::min<uint64_t>( segments(), n / MIN_SEGMENT_SIZE ) );
+		k = std::min<uint64_t>( k, 255 );
+
+		//encode segments concurrently, the first one in this thread
+		std::vector<std::future<std::vector<bcm::byte>>> jobs;
+		for (uint64_t j = 1; j < k; j++) {
+			jobs.push_back( std::async( std::launch::async, &encode_segment<T>, std::cref( t ),
+			                            segment_start( n, k, j ), segment_start( n, k, j+1 ) ) );
+		}
+		std::vector<std::vector<bcm::byte>> enc;
+		enc.push_back( encode_segment( t, 0, segment_start( n, k, 1 ) ) );
+		for (auto &job : jobs)	enc.push_back( job.get() );
+
+		//write segment table and encodings
+		out.put( (char)k );
+		for (uint64_t j = 0; j < k; j++)	write_u64( enc[j].size(), out );
+		for (uint64_t j = 0; j < k; j++)	out.write( (const char *)enc[j].data(), enc[j].size() );
+	}
+
+	//! decodes the transform and stores it in t
+	template<class T>
+	static void decode( std::istream &in, T &t ) {
+		uint64_t n = t.size();
+		if (n == 0u)	return;
+		int k = in.get();
+		if (k <= 0)
+			throw std::invalid_argument("invalid number of bcm segments");
+
+		//read segment table and check lengths before allocating any memory
+		std::vector<uint64_t> len( k );
+		uint64_t left = remaining_input( in );
+		for (int j = 0; j < k; j++) {
+			len[j] = read_u64( in );
+			if (!in)
+				throw std::invalid_argument("unexpected end of bcm segment table");
+			if (len[j] > max_segment_encoding( segment_start( n, k, j+1 ) - segment_start( n, k, j ) ))
+				throw std::invalid_argument("bcm segment is longer than its decoded size allows");
+		}
+		left = (left < 8u * k) ? 0 : left - 8u * k;
+		for (int j = 0; j < k; j++) {
+			if (len[j] > left)
+				throw std::invalid_argument("bcm segment exceeds the remaining input");
+			left -= len[j];
+		}
+
+		//read all segments
+		std::vector<std::vector<bcm::byte>> enc( k );
+		for (int j = 0; j < k; j++) {
+			enc[j].resize( len[j] );
+			if (!in.read( (char *)enc[j].data(), len[j] ))
+				throw std::invalid_argument("unexpected end of bcm segment");
+		}
+
+		//decode segments concurrently, the first one in this thread
+		std::vector<std::future<void>> jobs;
+		for (int j = 1; j < k; j++) {
+			jobs.push_back( std::async( std::launch::async, &decode_segment<T>, std::cref( enc[j] ), std::ref( t ),
+			                            segment_start( n, k, j ), segment_start( n, k, j+1 ) ) );
+		}
+		decode_segment( enc[0], t, 0, segment_start( n, k, 1 ) );
+		for (auto &job : jobs)	job.get();
+	}
+};
+
+#endif
@@ -33,18 +33,25 @@
 #include "mtf_coder.hpp"
 #include "rle0_coder.hpp"
 
+#include <algorithm>
 #include <istream>
 #include <limits>
 #include <ostream>
 #include <stdexcept>
+#include <vector>
 
 //! class which encodes a BWT with MTF + RLE0 + Entropy as second stage
-class bw94_poststage {
+/*! the template parameter chooses the frequency model of the entropy coder.
+ */
+template<class model_t>
+class basic_bw94_poststage {
 private:
 	typedef uint8_t  t_uchar_t;
 	typedef uint64_t t_size_t;
 	typedef uint64_t t_idx_t;
 	typedef int64_t  t_bitsize_t;
+
+	static const t_size_t MTF_BLOCK_SIZE = 1ul << 16; //number of characters mtf-coded at once
 public:
 	//! encodes the transform t using MTF + RLE0 + Entropy
 	template<class T>
@@ -60,20 +67,27 @@ public:
 		//prepare encoders
 		mtf_coder<T> mtfcoder( alph );
 		rle0_encoder<T> rle0coder;
-		entropy_encoder<std::ostream> entcoder( out );
+		entropy_encoder<std::ostream,model_t> entcoder( out );
 		entcoder.reset( alph.size() + 1 );
 
-		for (t_idx_t i = 0; i < t.size(); ) { //do encoding
-			do {
-				if (i >= t.size())	break;
+		//do encoding, mtf is computed blockwise
+		std::vector<t_uchar_t> mtfbuf( std::min<t_size_t>( t.size(), MTF_BLOCK_SIZE ) );
+		for (t_idx_t b = 0; b < t.size(); b += mtfbuf.size()) {
+			t_idx_t e = std::min<t_idx_t>( t.size(), b + mtfbuf.size() );
+			mtfcoder.encode_range( t, b, e, mtfbuf.data() );
+			for (t_idx_t j = 0; j < e - b; j++) {
 				//feed rle0-encoder with mtf coded input until some contents can be written
-			} while (rle0coder.encode_char( mtfcoder.encode_char( t[i++] ) ));
-
-			//move the output of the rle0coder to the entropy coder
-			while (rle0coder.has_next_enc_char()) {
-				entcoder.encode_char( rle0coder.next_enc_char() );
+				if (!rle0coder.encode_char( mtfbuf[j] )) {
+					//move the output of the rle0coder to the entropy coder
+					while (rle0coder.has_next_enc_char()) {
+						entcoder.encode_char( rle0coder.next_enc_char() );
+					}
+				}
 			}
 		}
+		while (rle0coder.has_next_enc_char()) { //write remaining zero run
+			entcoder.encode_char( rle0coder.next_enc_char() );
+		}
 		entcoder.flush();
 	}
 
@@ -98,23 +112,31 @@ public:
 		//set up required decodes
 		mtf_coder<T> mtfcoder( alph );
 		rle0_decoder<T> rle0coder;
-		entropy_decoder<std::istream> entcoder( in );
+		entropy_decoder<std::istream,model_t> entcoder( in );
 		entcoder.reset( alph.size() + 1 );
 
-		//do decoding
+		//do decoding, runs of zero ranks are written without touching the mtf list
 		for (t_idx_t i = 0; i < t.size(); entcoder.next() ) {
 			//feed rle0-decoder with input
 			rle0coder.decode_char( entcoder.decode_char() );
 
-			//fetch characters from rle0-decoder and invert mtf
-			while (i < t.size() && rle0coder.has_next_char()) {
-				t[i++] = mtfcoder.decode_char( rle0coder.next_char() );
+			//fetch runs of mtf ranks from rle0-decoder
+			t_uchar_t r;
+			for (t_size_t len; (len = rle0coder.next_run( r )) != 0; i += len) {
+				if (len > t.size() - i)
+					throw std::invalid_argument("encoded rle0-sequence is longer than text length");
+				mtfcoder.decode_run( t, i, len, r );
 			}
 		}
-		if (rle0coder.has_next_char()) {
-			throw std::invalid_argument("encoded rle0-sequence is longer than text length");
-		}
+		//a complete encoding is never read beyond its end
+		if (entcoder.ended())
+			throw std::invalid_argument("bw94 encoding is truncated");
 	}
 };
 
+//! original bw94 scheme with linear frequency model
+typedef basic_bw94_poststage<linear_frequency_model> bw94_poststage;
+//! bw94 scheme with an adaptive fenwick tree frequency model
+typedef basic_bw94_poststage<fenwick_frequency_model> bw94f_poststage;
+
 #endif
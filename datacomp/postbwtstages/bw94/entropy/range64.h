@@ -68,6 +68,85 @@ namespace SG
 			SG::DWord GetCurrentCount(SG::DWord TotalRange);
 			void RemoveRange(SG::DWord SymbolLow,SG::DWord SymbolHigh,SG::DWord TotalRange);
 		};
+
+		/*	Versions of RangeEncoder64 and RangeDecoder64 which take the concrete byte
+			sink or source as template parameter (e.g. SG::io::MemoryOutput), thus avoiding
+			virtual calls for every byte. They produce and consume the same codes.
+		*/
+		template<class Sink>
+		class RangeEncoder64T:public RangeCoder64
+		{
+		private:
+			//same as in RangeCoder64, but visible to the compiler
+			static const SG::QWord Top=(SG::QWord)1<<56,Bottom=(SG::QWord)1<<48;
+
+			SG::Boolean Flushed;
+			Sink &Output;
+
+		public:
+			RangeEncoder64T(Sink &OStream) : Flushed(false), Output(OStream) {}
+			~RangeEncoder64T() { Flush(); }
+
+			void EncodeRange(SG::DWord SymbolLow,SG::DWord SymbolHigh,SG::DWord TotalRange)
+			{
+				Low += SymbolLow*(Range/=TotalRange);
+				Range *= SymbolHigh-SymbolLow;
+
+				while ((Low ^ (Low+Range))<Top || (Range<Bottom && ((Range= -Low & (Bottom-1)),1)))
+				{
+					Output.WriteByte(Low>>56), Range<<=8, Low<<=8;
+				}
+			}
+
+			void Flush()
+			{
+				if(!Flushed)
+				{
+					for(SG::FastInt i=0;i<8;i++)
+					{
+						Output.WriteByte(Low>>56);
+						Low<<=8;
+					}
+					Flushed=true;
+				}
+			}
+		};
+
+		template<class Source>
+		class RangeDecoder64T:public RangeCoder64
+		{
+		private:
+			//same as in RangeCoder64, but visible to the compiler
+			static const SG::QWord Top=(SG::QWord)1<<56,Bottom=(SG::QWord)1<<48;
+
+			SG::QWord Code;
+			Source &Input;
+
+		public:
+			RangeDecoder64T(Source &IStream) : Code(0), Input(IStream)
+			{
+				for(SG::FastInt i=0;i<8;i++)
+				{
+					Code = (Code << 8) | Input.ReadByte();
+				}
+			}
+
+			SG::DWord GetCurrentCount(SG::DWord TotalRange)
+			{
+				return (Code-Low)/(Range/=TotalRange);
+			}
+
+			void RemoveRange(SG::DWord SymbolLow,SG::DWord SymbolHigh,SG::DWord /*TotalRange*/)
+			{
+				Low += SymbolLow*Range;
+				Range *= SymbolHigh-SymbolLow;
+
+				while ((Low ^ (Low+Range))<Top || (Range<Bottom && ((Range= -Low & (Bottom-1)),1)))
+				{
+					Code= Code<<8 | Input.ReadByte(), Range<<=8, Low<<=8;
+				}
+			}
+		};
 	}
 }
 
@@ -34,28 +34,21 @@
 #include <type_traits>
 #include <vector>
 
+#include "frequency_model.hpp"
+
 //SG entropy includes
 #include "entropy/range64.h"
-#include "io/bit_stream.h"
-#include "io/stream.h"
+#include "io/inline_stream.h"
 #include "stdx/define.h"
-#include "stdx/exception.h"
 
-//! base class for entropy coding.
+//! base class for entropy coding, parametrized by the used frequency model.
+template<class model_t>
 class entropy_coder {
 	public:
-		typedef SG::Counter size_type;
-		typedef SG::Counter value_type;
+		typedef typename model_t::size_type size_type;
+		typedef typename model_t::value_type value_type;
 	protected:
-		std::vector<size_type> freq{ 1 }; //frequency table
-
-		// rescales frequencies if they get to big
-		void rescale_frequencies() {
-			for(size_type i = 1; i < freq.size(); i++) {
-				freq[i] /= 2;
-				if(freq[i] <= freq[i-1]) freq[i] = freq[i-1]+1;
-			}
-		};
+		model_t model; //frequency model
 
 	public:
 		//! destructor
@@ -63,83 +56,68 @@ class entropy_coder {
 
 		//! returns sigma (alphabet size) of this coder.
 		size_type sigma() const {
-			return freq.size()-1;
+			return model.sigma();
 		};
 
 		//! resets this entropy coder and initializes it to the new sigma (alphabet size).
 		void reset( size_type sgm ) {
-			freq.resize( sgm+1 );
-			for (size_type i = 0; i < freq.size(); i++)
-				freq[i] = i;
+			model.reset( sgm );
 		};
 };
 
 //! class for entropy encoding.
-/*! class guarantees that ostream_t only has to support operations put and flush.
+/*! the encoding is buffered in memory, and written to the stream on flush.
+  Class guarantees that ostream_t only has to support operations write and flush.
  */
-template<class ostream_t>
-class entropy_encoder : public entropy_coder {
+template<class ostream_t, class model_t = linear_frequency_model>
+class entropy_encoder : public entropy_coder<model_t> {
 		static_assert( std::is_same<
 		                    typename std::make_unsigned<SG::Byte>::type,
 		                    typename std::make_unsigned<typename ostream_t::char_type>::type
 		               >::value,
 		               "stream types must be compatible" );
+	public:
+		typedef typename entropy_coder<model_t>::size_type size_type;
+		typedef typename entropy_coder<model_t>::value_type value_type;
 	private:
-		//class for mapping output streams to SG entropy
-		class output_stream_mapper : public SG::io::OutputStream {
-			private:
-				friend class entropy_encoder<ostream_t>;
-				ostream_t &s; //underlying stream
-				output_stream_mapper( ostream_t &_s ) : s(_s) {};
-			public:
-				virtual void WriteByte(SG::Byte Value) {
-					s.put( Value );
-				};
-				virtual void Flush() {
-					s.flush();
-				};
-		};
+		using entropy_coder<model_t>::model;
+
+		ostream_t &s; //underlying stream
+		std::vector<SG::Byte> buf; //encoding not written to s so far
+		bool flushed = false;
 
 		//range coder
-		output_stream_mapper s_mapper;
-		SG::Entropy::RangeEncoder64 encoder;
+		SG::io::MemoryOutput buf_out;
+		SG::Entropy::RangeEncoder64T<SG::io::MemoryOutput> encoder;
 	public:
 		//! constructor
-		entropy_encoder( ostream_t &s ) : s_mapper(s), encoder( s_mapper ) {};
+		entropy_encoder( ostream_t &_s ) : s(_s), buf_out(buf), encoder( buf_out ) {};
 
 		//! destructor
 		~entropy_encoder() { flush(); };
 		
 		//! encodes next character.
-		/*! The character must be in range [0..sigma-1]. passes through
-		  exceptions from the underlying stream
-		  , or throws an invalid_argument if range coder has problems
+		/*! The character must be in range [0..sigma-1].
 		 */
 		void encode_char(value_type c) {
-			try {
-				encoder.EncodeRange( freq[c], freq[c+1], freq.back() );
-
-				//and adapt frequencies
-				while (++c < freq.size()) ++freq[c];
-				if (freq.back() >= encoder.MaxRange) {
-					rescale_frequencies();
-				}
-			} catch ( SG::stdx::Exception e ) {
-				throw std::invalid_argument( e.Description + " at " + e.Location );
-			}
+			size_type low, high, tot;
+			model.range( c, low, high, tot );
+			encoder.EncodeRange( low, high, tot );
+
+			//and adapt frequencies
+			model.update( c );
+			model.normalize();
 		};
 
 		//! flushes this encoder, important to call after encoding process.
-		/*! passes through exceptions from the underlying stream
-		  , or throws an invalid_argument if range coder has problems
+		/*! passes through exceptions from the underlying stream.
 		 */
 		void flush() {
-			try {
-				encoder.Flush();
-				s_mapper.Flush();
-			} catch ( SG::stdx::Exception e ) {
-				throw std::invalid_argument( e.Description + " at " + e.Location );
-			}
+			if (flushed)	return;
+			encoder.Flush();
+			s.write( (const typename ostream_t::char_type *)buf.data(), buf.size() );
+			s.flush();
+			flushed = true;
 		};
 
 		//! returns the maximal size of an encoding for any string of
@@ -150,43 +128,35 @@ class entropy_encoder : public entropy_coder {
 };
 
 //! class for entropy-decoding.
-/*! class guarantees that ostream_t only has to support operations get and tellg.
+/*! reads directly from the stream buffer of the given stream, thus
+  class guarantees that istream_t only has to support operation rdbuf.
  */
-template<class istream_t>
-class entropy_decoder : public entropy_coder {
+template<class istream_t, class model_t = linear_frequency_model>
+class entropy_decoder : public entropy_coder<model_t> {
 		static_assert( std::is_same<
 		                    typename std::make_unsigned<SG::Byte>::type,
 		                    typename std::make_unsigned<typename istream_t::char_type>::type
 		               >::value,
 		               "stream types must be compatible" );
+	public:
+		typedef typename entropy_coder<model_t>::size_type size_type;
+		typedef typename entropy_coder<model_t>::value_type value_type;
 	private:
-		
-		//class for mapping input streams to SG entropy
-		class input_stream_mapper : public SG::io::InputStream {
-			private:
-				friend class entropy_decoder<istream_t>;
-				istream_t &s; //underlying stream
-				input_stream_mapper( istream_t &_s ) : s(_s) {};
-			public:
-				virtual int ReadByte() {
-					return (SG::Byte)s.get();
-				};
-				virtual SG::Boolean Ended() {
-					return false; //is ignored either way
-				};
-		};
+		using entropy_coder<model_t>::model;
 
 		//range coder
-		input_stream_mapper s_mapper;
-		SG::Entropy::RangeDecoder64 decoder;
+		SG::io::StreamBufInput s_in;
+		SG::Entropy::RangeDecoder64T<SG::io::StreamBufInput> decoder;
 
 		//last character decoded
 		value_type ch;
+		//range of last character decoded, as expected by the range decoder
+		size_type low, high, tot;
 	
 	public:
 		//! constructor, expects a stream and a end position when to stop reading in stream
-		entropy_decoder( istream_t &s ) : s_mapper(s),
-			decoder( s_mapper ) {};
+		entropy_decoder( istream_t &s ) : s_in( *s.rdbuf() ),
+			decoder( s_in ) {};
 
 		//!reads next character from stream and returns it.
 		/*! function should be called only once, character can be
@@ -197,16 +167,9 @@ class entropy_decoder : public entropy_coder {
 		  decode_char() next() decode_char() next() ... decode_char() next() decode_char()
 		*/
 		value_type decode_char() {
-			ch = sigma();
-			try {
-				//decode character and adapt frequencies
-				size_type cnt = decoder.GetCurrentCount( freq.back() );
-				while (freq[ch] > cnt) {
-					++freq[ch--];
-				}
-			} catch ( SG::stdx::Exception e ) {
-				throw std::invalid_argument( e.Description + " at " + e.Location );
-			}
+			//decode character and adapt frequencies
+			size_type cnt = decoder.GetCurrentCount( model.total() );
+			ch = model.decode( cnt, low, high, tot );
 			return ch;
 		}
 
@@ -219,15 +182,14 @@ class entropy_decoder : public entropy_coder {
 		//! IMPORTANT NOTE: after last call of decode_char(),
 		//! no further next() - call should be performed.
 		void next() {
-			try {
-				//remove range and rescale if necessary
-				decoder.RemoveRange( freq[ch], freq[ch+1]-1, freq.back()-1 );
-				if (freq.back() >= decoder.MaxRange) {
-					rescale_frequencies();
-				}
-			} catch ( SG::stdx::Exception e ) {
-				throw std::invalid_argument( e.Description + " at " + e.Location );
-			}
+			//remove range and rescale if necessary
+			decoder.RemoveRange( low, high, tot );
+			model.normalize();
+		}
+
+		//! returns true if the decoder tried to read past the end of the stream.
+		bool ended() const {
+			return s_in.Ended();
 		}
 };
 
@@ -0,0 +1,197 @@
+/*
+ * frequency_model.hpp for BWT Tunneling
+ * Copyright (c) 2020 Uwe Baier All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FREQUENCY_MODEL_HPP
+#define FREQUENCY_MODEL_HPP
+
+#include <vector>
+
+//SG entropy includes
+#include "entropy/range64.h"
+#include "stdx/define.h"
+
+//! adaptive frequency model storing cumulative frequencies in a plain table.
+/*! updates and decoding take O(sigma) time. This is the model of the original
+   bw94 scheme, and is kept for compatibility.
+ */
+class linear_frequency_model {
+	public:
+		typedef SG::Counter size_type;
+		typedef SG::Counter value_type;
+	private:
+		std::vector<size_type> freq{ 1 }; //cumulative frequency table
+	public:
+		//! returns sigma (alphabet size) of this model.
+		size_type sigma() const {
+			return freq.size()-1;
+		};
+
+		//! resets this model and initializes it to the new sigma (alphabet size).
+		void reset( size_type sgm ) {
+			freq.resize( sgm+1 );
+			for (size_type i = 0; i < freq.size(); i++)
+				freq[i] = i;
+		};
+
+		//! returns the sum of all frequencies.
+		size_type total() const {
+			return freq.back();
+		};
+
+		//! returns the coding range of character c.
+		void range( value_type c, size_type &low, size_type &high, size_type &tot ) const {
+			low = freq[c]; high = freq[c+1]; tot = freq.back();
+		};
+
+		//! increments the frequency of character c.
+		void update( value_type c ) {
+			while (++c < freq.size()) ++freq[c];
+		};
+
+		//! returns the character whose range contains count cnt and increments
+		//! its frequency. The range of the character is returned with respect
+		//! to the frequencies before the update.
+		value_type decode( size_type cnt, size_type &low, size_type &high, size_type &tot ) {
+			value_type ch = sigma();
+			while (freq[ch] > cnt) {
+				++freq[ch--];
+			}
+			low = freq[ch]; high = freq[ch+1]-1; tot = freq.back()-1;
+			return ch;
+		};
+
+		//! rescales frequencies if they get to big for the range coder.
+		void normalize() {
+			if (freq.back() < SG::Entropy::RangeCoder64::MaxRange)	return;
+			for(size_type i = 1; i < freq.size(); i++) {
+				freq[i] /= 2;
+				if(freq[i] <= freq[i-1]) freq[i] = freq[i-1]+1;
+			}
+		};
+};
+
+//! adaptive frequency model storing frequencies in a fenwick tree.
+/*! updates and decoding take O(log sigma) time. In contrast to the linear model,
+   frequencies are incremented in larger steps and halved once their sum
+   exceeds a limit, such that the model adapts to local statistics.
+ */
+class fenwick_frequency_model {
+	public:
+		typedef SG::Counter size_type;
+		typedef SG::Counter value_type;
+	private:
+		static const size_type INCREMENT = 32; //frequency increment per character
+		static const size_type LIMIT = 1ul << 16; //maximal sum of all frequencies
+
+		std::vector<size_type> f; //frequency of each character
+		std::vector<size_type> tree; //fenwick tree over f, 1-based
+		size_type m_total = 0; //sum of all frequencies
+		size_type m_step = 0; //highest power of two not greater than sigma
+
+		//computes the fenwick tree from the frequencies
+		void rebuild() {
+			m_total = 0;
+			for (size_type i = 1; i < tree.size(); i++) {
+				tree[i] = f[i-1];
+				m_total += f[i-1];
+			}
+			for (size_type i = 1; i < tree.size(); i++) {
+				size_type j = i + (i & -i);
+				if (j < tree.size())	tree[j] += tree[i];
+			}
+		};
+
+		//returns the sum of frequencies of all characters smaller than c
+		size_type prefix( value_type c ) const {
+			size_type s = 0;
+			for (size_type i = c; i > 0; i &= i-1) {
+				s += tree[i];
+			}
+			return s;
+		};
+	public:
+		//! returns sigma (alphabet size) of this model.
+		size_type sigma() const {
+			return f.size();
+		};
+
+		//! resets this model and initializes it to the new sigma (alphabet size).
+		void reset( size_type sgm ) {
+			f.assign( sgm, 1 );
+			tree.assign( sgm+1, 0 );
+			for (m_step = 1; (m_step << 1) <= sgm; m_step <<= 1);
+			rebuild();
+		};
+
+		//! returns the sum of all frequencies.
+		size_type total() const {
+			return m_total;
+		};
+
+		//! returns the coding range of character c.
+		void range( value_type c, size_type &low, size_type &high, size_type &tot ) const {
+			low = prefix( c ); high = low + f[c]; tot = m_total;
+		};
+
+		//! increments the frequency of character c.
+		void update( value_type c ) {
+			f[c] += INCREMENT;
+			m_total += INCREMENT;
+			for (size_type i = c+1; i < tree.size(); i += (i & -i)) {
+				tree[i] += INCREMENT;
+			}
+		};
+
+		//! returns the character whose range contains count cnt and increments
+		//! its frequency. The range of the character is returned with respect
+		//! to the frequencies before the update.
+		value_type decode( size_type cnt, size_type &low, size_type &high, size_type &tot ) {
+			//binary search on the fenwick tree
+			size_type pos = 0, rem = cnt;
+			for (size_type step = m_step; step > 0; step >>= 1) {
+				if (pos + step < tree.size() && tree[pos+step] <= rem) {
+					pos += step;
+					rem -= tree[pos];
+				}
+			}
+			low = cnt - rem;
+			if (pos >= f.size()) { //invalid count, caused by corrupt input
+				pos = f.size()-1;
+				low = prefix( pos );
+			}
+			high = low + f[pos]; tot = m_total;
+			update( pos );
+			return pos;
+		};
+
+		//! halves all frequencies if their sum exceeds the limit.
+		void normalize() {
+			if (m_total < LIMIT)	return;
+			for (size_type i = 0; i < f.size(); i++) {
+				f[i] = (f[i] + 1) / 2;
+			}
+			rebuild();
+		};
+};
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * inline_stream.h for BWT Tunneling
+ * Copyright (c) 2020 Uwe Baier All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __sg_io_inline_stream
+#define __sg_io_inline_stream
+
+#include <streambuf>
+#include <vector>
+
+#include "stdx/define.h"
+
+namespace SG
+{
+	namespace io
+	{
+		/*	Byte sink and source without virtual methods, to be used as template
+			parameters of the coders (e.g. RangeEncoder64T), such that every
+			byte access can be inlined.
+		*/
+
+		//appends bytes to a memory buffer
+		class MemoryOutput
+		{
+		private:
+			std::vector<SG::Byte> &Buffer;
+
+		public:
+			MemoryOutput(std::vector<SG::Byte> &Buf) : Buffer(Buf) {}
+
+			void WriteByte(SG::Byte Value)
+			{
+				Buffer.push_back(Value);
+			}
+		};
+
+		//reads bytes from the get area of a stream buffer, returns 0xFF at its end
+		//and remembers that the end was reached
+		class StreamBufInput
+		{
+		private:
+			std::streambuf &Buffer;
+			bool EndReached;
+
+		public:
+			StreamBufInput(std::streambuf &Buf) : Buffer(Buf), EndReached(false) {}
+
+			int ReadByte()
+			{
+				std::streambuf::int_type Value=Buffer.sbumpc();
+				if(Value==std::streambuf::traits_type::eof())
+				{
+					EndReached=true;
+					return 0xFF;
+				}
+				return (SG::Byte)Value;
+			}
+
+			bool Ended() const
+			{
+				return EndReached;
+			}
+		};
+	}
+}
+
+#endif
@@ -29,13 +29,23 @@
 #ifndef MTF_CODER_HPP
 #define MTF_CODER_HPP
 
+#include <algorithm>
 #include <limits>
 #include <stdexcept>
+#include <string.h>
 #include <vector>
 
+#if defined(__SSE2__)
+#define MTF_CODER_SSE2
+#include <emmintrin.h>
+#endif
+
 //! class for mtf-transformations, requires a string type
 /*! template parameter string_t should support random access [], as well as
   resize() - function, empty construction and size()-function.
+  The mtf list is kept in a contiguous padded table, such that ranks can be
+  searched with SIMD comparisons (for byte alphabets) and the list can be
+  rotated using a single memmove.
  */
 template<class string_t> 
 class mtf_coder {
@@ -43,39 +53,114 @@ class mtf_coder {
 		typedef typename string_t::value_type char_type;
 		typedef typename string_t::size_type size_type;
 	private:
-		string_t alph;
+		static const size_type PAD = 16; //padding for vectorized search
+		std::vector<char_type> m_tab; //mtf list, padded by PAD entries
+		size_type m_sigma; //size of the alphabet
+
+		//returns the rank of c in the mtf list, or sigma if c is not contained.
+		size_type find( char_type c ) const {
+			const char_type *tab = m_tab.data();
+			if (tab[0] == c)	return 0; //most common case on bwts
+#ifdef MTF_CODER_SSE2
+			if (sizeof(char_type) == 1) {
+				const __m128i x = _mm_set1_epi8( (char)c );
+				for (size_type r = 0; r < m_sigma; r += 16) {
+					__m128i y = _mm_loadu_si128( (const __m128i *)(tab + r) );
+					unsigned m = (unsigned)_mm_movemask_epi8( _mm_cmpeq_epi8( x, y ) );
+					if (m != 0) {
+						size_type p = r + __builtin_ctz( m );
+						return (p < m_sigma) ? p : m_sigma;
+					}
+				}
+				return m_sigma;
+			}
+#endif
+			size_type r = 1;
+			while (r < m_sigma && tab[r] != c)	++r;
+			return r;
+		};
+
+		//moves the entry of rank r to the front of the mtf list
+		void move_to_front( size_type r ) {
+			char_type *tab = m_tab.data();
+			char_type c = tab[r];
+			memmove( tab + 1, tab, r * sizeof(char_type) );
+			tab[0] = c;
+		};
+
+		//writes len copies of c to S[b..b+len)
+		template<class T>
+		static void fill( T &S, size_type b, size_type len, char_type c ) {
+			for (size_type i = b; i < b + len; i++)	S[i] = c;
+		};
+
+		static void fill( std::vector<unsigned char> &S, size_type b, size_type len, unsigned char c ) {
+			memset( S.data() + b, c, len );
+		};
 	public:
 		//! constructs an mtf coder, expects an alphabet of the underlying source.
-		mtf_coder (string_t _alph) : alph(_alph) {};
+		mtf_coder (const string_t &_alph) : m_tab( _alph.size() + PAD ), m_sigma( _alph.size() ) {
+			for (size_type i = 0; i < m_sigma; i++) {
+				m_tab[i] = _alph[i];
+			}
+		};
 
 		//! encodes a single character, and returns the coding for the character
+		/*! throws invalid_argument if the character is not part of the alphabet.
+		 */
 		char_type encode_char( char_type c ) {
-			char_type r = 0; //rank of S[i] in alph
-			while (alph[0] != c) { //move S[i] to front
-				++r;
-
-				char_type tmp = alph[0];
-				alph[0] = alph[r];
-				alph[r] = tmp;
-			}
-			return r;
+			size_type r = find( c );
+			if (r == 0)	return 0;
+			if (r >= m_sigma)
+				throw std::invalid_argument("MTF Transform failed");
+			move_to_front( r );
+			return (char_type)r;
 		};
 
 		//! decodes a single encoded character and returns its decoded value.
 		/*! throws invalid_argument if ranks in S are bigger than alphabet size.
 		 */
 		char_type decode_char( char_type c ) {
-			if (c >= alph.size())
+			if (c == 0)	return m_tab[0];
+			if (c >= m_sigma)
 				throw std::invalid_argument("MTF Retransform failed");
+			move_to_front( c );
+			return m_tab[0];
+		};
 
-			while (c > 0) { //move alph[c] to front
-				char_type tmp = alph[c-1];
-				alph[c-1] = alph[c];
-				alph[c] = tmp;
+		//! decodes rank r followed by len-1 zero ranks and writes the result to S[b..b+len).
+		/*! zero ranks do not change the mtf list, so the run is written as a
+		   block. throws invalid_argument if r is bigger than alphabet size.
+		 */
+		void decode_run( string_t &S, size_type b, size_type len, char_type r ) {
+			fill( S, b, len, decode_char( r ) );
+		};
+
+		//! encodes the characters S[b..e) and writes their codings to out.
+		template<class src_t>
+		void encode_range( const src_t &S, size_type b, size_type e, char_type *out ) {
+			char_type front = m_tab[0];
+			for (size_type i = b; i < e; i++) {
+				char_type c = S[i];
+				if (c == front) { //skip runs without touching the list
+					*out++ = 0;
+				} else {
+					*out++ = encode_char( c );
+					front = c;
+				}
+			}
+		};
 
-				--c;
+		//! decodes the codings S[b..e) in place.
+		/*! throws invalid_argument if ranks in S are bigger than alphabet size.
+		 */
+		void decode_range( string_t &S, size_type b, size_type e ) {
+			char_type front = m_tab[0];
+			for (size_type i = b; i < e; i++) {
+				char_type r = S[i];
+				if (r != 0)	front = decode_char( r );
+				S[i] = front;
 			}
-			return (char_type)alph[0];
 		};
 
 		//! computes alphabet from underlying string S.
@@ -110,9 +195,14 @@ class mtf_coder {
 		   during execution)
 		*/
 		static void transform( string_t &S, string_t alph ) {
-			mtf_coder coder( std::move( alph ) );
-			for (size_type i = 0; i < S.size(); i++) {
-				S[i] = coder.encode_char( S[i] );
+			mtf_coder coder( alph );
+			char_type buf[4096];
+			for (size_type i = 0; i < S.size(); i += sizeof(buf) / sizeof(char_type)) {
+				size_type e = std::min<size_type>( S.size(), i + sizeof(buf) / sizeof(char_type) );
+				coder.encode_range( S, i, e, buf );
+				for (size_type j = i; j < e; j++) {
+					S[j] = buf[j-i];
+				}
 			}
 		};
 
@@ -123,10 +213,8 @@ class mtf_coder {
 		   throws invalid_argument if ranks in S are bigger than alphabet size
 		*/
 		static void retransform( string_t &S, string_t alph ) {
-			mtf_coder coder( std::move( alph ) );
-			for (size_type i = 0; i < S.size(); i++) {
-				S[i] = coder.decode_char( S[i] );
-			}
+			mtf_coder coder( alph );
+			coder.decode_range( S, 0, S.size() );
 		};
 };
 
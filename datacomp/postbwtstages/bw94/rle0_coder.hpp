@@ -174,6 +174,24 @@ class rle0_decoder {
 			return c;
 		};
 
+		//! fetches the pending output of the decoder as a run of equal characters.
+		/*! returns the length of the run and stores its character in c, or
+		  returns 0 if no more output is pending. Zeros are always fetched
+		  as a whole, all other characters have run length 1.
+		 */
+		size_type next_run( char_type &c ) {
+			size_type l = z2write;
+			if (l != 0) { //fetch zeros first
+				z2write = 0;
+				c = 0u;
+			} else if (lastchar != 0) {
+				l = 1;
+				c = lastchar;
+				lastchar = 0u;
+			}
+			return l;
+		};
+
 		//! decodes a rle0-encoded string and returns the size of the decoding.
 		/*! the given string must be large enough to cover the whole result.
 		  Also, the encoding must be placed at the back of the given string
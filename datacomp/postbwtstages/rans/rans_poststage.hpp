@@ -0,0 +1,303 @@
+/*
+ * rans_poststage.hpp for BWT Tunneling
+ * Copyright (c) 2020 Uwe Baier All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RANS_POSTSTAGE_HPP
+#define RANS_POSTSTAGE_HPP
+
+#include "mtf_coder.hpp"
+#include "rle0_coder.hpp"
+
+#include <algorithm>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <stdint.h>
+#include <vector>
+
+//! class which encodes a BWT with MTF + RLE0 + interleaved rANS as second stage
+/*! the rle0-coded mtf ranks are split into blocks, where each block is coded
+   with its own static frequency table. Symbols are distributed round-robin
+   over several rANS states, such that decoding consists of independent
+   dependency chains and a single table lookup per symbol.
+ */
+class rans_poststage {
+private:
+	typedef uint8_t  t_uchar_t;
+	typedef uint64_t t_size_t;
+	typedef uint64_t t_idx_t;
+	typedef uint16_t t_sym_t; //rle0-coded symbol, may take up to 257 values
+
+	static const uint32_t PROB_BITS = 12; //precision of frequency tables
+	static const uint32_t PROB_SCALE = 1u << PROB_BITS; //sum of a frequency table
+	static const uint32_t RANS_L = 1u << 23; //lower bound of normalized rANS states
+	static const uint32_t STATES = 4; //number of interleaved rANS states
+	static const t_size_t BLOCK_SIZE = 1ul << 16; //number of symbols per block
+	static const t_size_t MTF_BLOCK_SIZE = 1ul << 16; //number of characters mtf-coded at once
+
+	//decoding table entry of a slot
+	struct slot_entry {
+		uint16_t freq; //frequency of the symbol
+		uint16_t start; //cumulative frequency of the symbol
+		t_sym_t sym; //symbol
+	};
+
+	//// VARIABLE LENGTH INTEGERS /////////////////////////////////
+
+	static void write_varint( std::ostream &out, uint64_t v ) {
+		while (v >= 0x80u) {
+			out.put( (char)(v | 0x80u) );
+			v >>= 7;
+		}
+		out.put( (char)v );
+	};
+
+	static uint64_t read_varint( std::istream &in ) {
+		uint64_t v = 0;
+		for (uint32_t shift = 0; shift < 64; shift += 7) {
+			int c = in.get();
+			if (c == std::istream::traits_type::eof())	break;
+			v |= (uint64_t)(c & 0x7F) << shift;
+			if ((c & 0x80) == 0)	return v;
+		}
+		throw std::invalid_argument("corrupt rANS block header");
+	};
+
+	//// FREQUENCY TABLES /////////////////////////////////////////
+
+	//scales the symbol counts of a block of n symbols to sum up to PROB_SCALE,
+	//each occuring symbol keeps a frequency of at least 1.
+	static void normalize_freqs( std::vector<uint32_t> &freq, t_size_t n ) {
+		uint32_t sum = 0;
+		for (size_t s = 0; s < freq.size(); s++) {
+			if (freq[s] != 0) {
+				freq[s] = std::max<uint32_t>( 1, (uint64_t)freq[s] * PROB_SCALE / n );
+				sum += freq[s];
+			}
+		}
+		auto maxf = std::max_element( freq.begin(), freq.end() );
+		if (sum <= PROB_SCALE) { //give remainder to the most frequent symbol
+			*maxf += PROB_SCALE - sum;
+		} else while (sum > PROB_SCALE) { //steal from the most frequent symbols
+			--*maxf; --sum;
+			maxf = std::max_element( freq.begin(), freq.end() );
+		}
+	};
+
+	//// BLOCK CODING /////////////////////////////////////////////
+
+	//encodes a block of symbols in [0..sigma-1] and writes it to out.
+	static void encode_block( const std::vector<t_sym_t> &syms, size_t sigma,
+	                          std::vector<uint8_t> &buf, std::ostream &out ) {
+		//compute and store frequency table
+		std::vector<uint32_t> freq( sigma, 0 ), cum( sigma, 0 );
+		for (t_sym_t s : syms)	++freq[s];
+		normalize_freqs( freq, syms.size() );
+		for (size_t s = 1; s < sigma; s++)	cum[s] = cum[s-1] + freq[s-1];
+
+		write_varint( out, syms.size() );
+		for (size_t s = 0; s < sigma; s++)	write_varint( out, freq[s] );
+
+		//encode backwards, each symbol emits at most two bytes
+		buf.resize( 2 * syms.size() + 4 * STATES );
+		uint8_t *end = buf.data() + buf.size();
+		uint8_t *p = end;
+		uint32_t x[STATES];
+		std::fill( x, x + STATES, RANS_L );
+		for (size_t i = syms.size(); i-- > 0; ) {
+			uint32_t &xs = x[i % STATES];
+			uint32_t f = freq[syms[i]];
+			uint32_t x_max = ((RANS_L >> PROB_BITS) << 8) * f;
+			while (xs >= x_max) { //renormalize
+				*--p = (uint8_t)xs;
+				xs >>= 8;
+			}
+			xs = ((xs / f) << PROB_BITS) + (xs % f) + cum[syms[i]];
+		}
+		for (size_t j = STATES; j-- > 0; ) { //flush states, first state gets read first
+			for (size_t b = 0; b < 4; b++) { //big endian
+				*--p = (uint8_t)(x[j] >> (8 * b));
+			}
+		}
+
+		write_varint( out, end - p );
+		out.write( (const char *)p, end - p );
+	};
+
+	//decodes a block from in, storing its symbols in syms.
+	static void decode_block( std::istream &in, size_t sigma, std::vector<t_sym_t> &syms,
+	                          std::vector<uint8_t> &buf, std::vector<slot_entry> &lut ) {
+		t_size_t n = read_varint( in );
+		if (n == 0 || n > BLOCK_SIZE)
+			throw std::invalid_argument("corrupt rANS block header");
+
+		//read frequency table and build decoding table
+		lut.resize( PROB_SCALE );
+		uint32_t start = 0;
+		for (size_t s = 0; s < sigma; s++) {
+			uint64_t f = read_varint( in );
+			if (f > PROB_SCALE - start)
+				throw std::invalid_argument("corrupt rANS frequency table");
+			for (uint32_t k = start; k < start + f; k++) {
+				lut[k] = slot_entry{ (uint16_t)f, (uint16_t)start, (t_sym_t)s };
+			}
+			start += f;
+		}
+		if (start != PROB_SCALE)
+			throw std::invalid_argument("corrupt rANS frequency table");
+
+		//read payload
+		t_size_t len = read_varint( in );
+		if (len < 4 * STATES || len > 2 * n + 4 * STATES)
+			throw std::invalid_argument("corrupt rANS block header");
+		buf.resize( len );
+		if (!in.read( (char *)buf.data(), len ))
+			throw std::invalid_argument("unexpected end of rANS block");
+		const uint8_t *p = buf.data();
+		const uint8_t *end = buf.data() + len;
+
+		//initialize states
+		uint32_t x[STATES];
+		for (size_t j = 0; j < STATES; j++) {
+			x[j] = 0;
+			for (size_t b = 0; b < 4; b++) {
+				x[j] = (x[j] << 8) | *p++;
+			}
+		}
+
+		//decode symbols, states are advanced round-robin
+		syms.resize( n );
+		for (t_size_t i = 0; i < n; ) {
+			for (size_t j = 0; j < STATES && i < n; j++, i++) {
+				uint32_t slot = x[j] & (PROB_SCALE - 1);
+				const slot_entry &e = lut[slot];
+				syms[i] = e.sym;
+				x[j] = e.freq * (x[j] >> PROB_BITS) + slot - e.start;
+				while (x[j] < RANS_L) { //renormalize
+					if (p == end)
+						throw std::invalid_argument("unexpected end of rANS block");
+					x[j] = (x[j] << 8) | *p++;
+				}
+			}
+		}
+		//all states must have returned to their initial value
+		for (size_t j = 0; j < STATES; j++) {
+			if (x[j] != RANS_L)
+				throw std::invalid_argument("corrupt rANS block");
+		}
+		if (p != end)
+			throw std::invalid_argument("corrupt rANS block");
+	};
+
+	//appends a symbol to the current block, and encodes the block if it is full.
+	static void push_symbol( t_sym_t s, std::vector<t_sym_t> &syms, size_t sigma,
+	                         std::vector<uint8_t> &buf, std::ostream &out ) {
+		syms.push_back( s );
+		if (syms.size() == BLOCK_SIZE) {
+			encode_block( syms, sigma, buf, out );
+			syms.clear();
+		}
+	};
+public:
+	//! encodes the transform t using MTF + RLE0 + rANS
+	template<class T>
+	static void encode( T &t, std::ostream &out ) {
+		if (t.size() == 0u)	return;
+		//write alphabet
+		auto alph = mtf_coder<T>::compute_alph( t );
+		out.put( (t_uchar_t)alph.size() ); //store alphabet size (note that this stores 0 if full alphabet is used)
+		for (t_idx_t i = 0; i < alph.size(); i++) { //and the alphabet itself
+			out.put( alph[i] );
+		}
+
+		//prepare encoders
+		const size_t sigma = alph.size() + 1; //rle0 increases alphabet by one
+		mtf_coder<T> mtfcoder( alph );
+		rle0_encoder<T> rle0coder;
+		std::vector<t_uchar_t> mtfbuf( std::min<t_size_t>( t.size(), MTF_BLOCK_SIZE ) );
+		std::vector<t_sym_t> syms; syms.reserve( BLOCK_SIZE );
+		std::vector<uint8_t> buf;
+
+		//do encoding, mtf is computed blockwise
+		for (t_idx_t b = 0; b < t.size(); b += mtfbuf.size()) {
+			t_idx_t e = std::min<t_idx_t>( t.size(), b + mtfbuf.size() );
+			mtfcoder.encode_range( t, b, e, mtfbuf.data() );
+			for (t_idx_t j = 0; j < e - b; j++) {
+				if (!rle0coder.encode_char( mtfbuf[j] )) {
+					while (rle0coder.has_next_enc_char()) {
+						push_symbol( rle0coder.next_enc_char(), syms, sigma, buf, out );
+					}
+				}
+			}
+		}
+		while (rle0coder.has_next_enc_char()) { //write remaining zero run
+			push_symbol( rle0coder.next_enc_char(), syms, sigma, buf, out );
+		}
+		if (!syms.empty()) {
+			encode_block( syms, sigma, buf, out );
+		}
+	}
+
+	//! decodes the transform and stores it in t using MTF + RLE0 + rANS (t must have length of output)
+	template<class T>
+	static void decode( std::istream &in, T &t ) {
+		if (t.size() == 0u)	return;
+		t_size_t alphsize = in.get();
+		//check validity
+		if (alphsize == 0u) {
+			alphsize = std::numeric_limits<t_uchar_t>::max()+1u; //remember that on full alphabet 0 is stored
+		}
+		if (alphsize > t.size())
+			throw std::invalid_argument("alphabet must be smaller than encoded string size");
+
+		//read alphabet
+		T alph; alph.resize( alphsize );
+		for (t_idx_t i = 0; i < alph.size(); i++) {
+			alph[i] = in.get();
+		}
+
+		//set up required decoders
+		const size_t sigma = alph.size() + 1;
+		mtf_coder<T> mtfcoder( alph );
+		rle0_decoder<T> rle0coder;
+		std::vector<t_sym_t> syms;
+		std::vector<uint8_t> buf;
+		std::vector<slot_entry> lut;
+
+		//do decoding blockwise
+		for (t_idx_t i = 0; i < t.size(); ) {
+			decode_block( in, sigma, syms, buf, lut );
+			for (t_sym_t s : syms) {
+				rle0coder.decode_char( s );
+				t_uchar_t r;
+				for (t_size_t len; (len = rle0coder.next_run( r )) != 0; i += len) {
+					if (len > t.size() - i)
+						throw std::invalid_argument("encoded rle0-sequence is longer than text length");
+					mtfcoder.decode_run( t, i, len, r );
+				}
+			}
+		}
+	}
+};
+
+#endif
@@ -36,6 +36,7 @@
 #include <vector>
 #include <utility>
 #include <limits>
+#include <thread>
 
 class dbg_algorithms {
 	public:
@@ -44,6 +45,27 @@ class dbg_algorithms {
 	private:
 		typedef typename std::deque<std::pair<size_type,size_type>>   kmer_queue;
 
+		//counters of a single order collected by process_kmer_intervals
+		struct level_counts {
+			size_type nodes = 0;     // new nodes
+			size_type reduced = 0;   // edges removed from the current order
+			size_type fusible = 0;   // possible fusions in next order
+		};
+
+		//minimal number of k-mer intervals of an order processed by each thread
+		static const size_type min_intervals_per_thread = 4096;
+
+		//processes cnt k-mer intervals of an order, starting at the q-th interval of queue Q[c]
+		// and proceeding with the following queues, appending the k-mer intervals of the next order to N.
+		// B is not altered, ends of fusible intervals are reported to mark_fusible.
+		// stops as soon as node_limit new nodes were found
+		template<class t_csa_wt_type,
+		         class f_mark_fusible>
+		static void process_kmer_intervals( const t_csa_wt_type &csa, const sdsl::bit_vector &B,
+		                                    const std::vector<kmer_queue> &Q, size_type c, size_type q, size_type cnt,
+		                                    std::vector<kmer_queue> &N, level_counts &counts, size_type node_limit,
+		                                    f_mark_fusible mark_fusible );
+
 		//edge minimization algorithm
 		// stop_on_min: wether algorithm should stop if minimum is certain or proceed to kmax
 		// csa: fm-index
@@ -51,22 +73,26 @@ class dbg_algorithms {
 		// B: a bitvector of size csa.size() filled with ones
 		// nb_buffer: a buffer used to write the node bound indices occuring during the execution of the algorithm
 		// order_edgecnt_output: function that is called for every order k with the current edgecount and the order
+		// num_threads: maximal number of threads processing the k-mer intervals of an order,
+		//              the result does not depend on the number of threads
 		template<bool stop_on_min=true,
 		         class t_csa_wt_type,
 		         class f_order_edgecnt_output>
 		static std::pair<size_type,size_type> minimize_dbg_edges( const t_csa_wt_type &csa, size_type kmax, sdsl::bit_vector &B,
 		                                                          sdsl::int_vector_buffer<> &nb_buffer,
-		                                                          f_order_edgecnt_output order_edgecnt_output );
+		                                                          f_order_edgecnt_output order_edgecnt_output,
+		                                                          size_type num_threads = 1 );
 
 	public:		
 		//function behaves as calling dbg_edgecount for each values from 1 to (including) k,
 		// but in a more efficient manner.
 		// csa: a compressed suffix array of the string using a wavelet tree and the BWT
 		// k: maximal k from which the number of edges of the DBG shall be determined
+		// num_threads: maximal number of threads used
 		// function returns a vector of size k containing the edge count of each order k,
 		// where number of edges of an order k edge-reduced graph can be queried at index (k-1).
 		template<class t_csa_wt_type>
-		static std::vector<size_type> dbg_edgespectrum( const t_csa_wt_type &csa, size_type k ) {
+		static std::vector<size_type> dbg_edgespectrum( const t_csa_wt_type &csa, size_type k, size_type num_threads = 1 ) {
 			assert( k > 0 && k <= csa.size() );
 
 			//initialize B
@@ -79,7 +105,8 @@ class dbg_algorithms {
 			sdsl::int_vector_buffer<> nb_buffer("/dev/null", std::ios::out);
 
 			//compute spectrum
-			minimize_dbg_edges<false>( csa, k, B, nb_buffer, [&ES](size_type k,size_type m) { if (k > 0u) ES[k-1] = m; } );
+			minimize_dbg_edges<false>( csa, k, B, nb_buffer, [&ES](size_type k,size_type m) { if (k > 0u) ES[k-1] = m; },
+			                           num_threads );
 
 			return ES;
 		};
@@ -90,10 +117,12 @@ class dbg_algorithms {
 		// B: a bitvector where the upper bounds of the k-mer intervals of the smallest DBG will be marked.
 		//    After function call, B has size csa.size() + 1, and B[csa.size()] will always be 1
 		// config: a config indicating where temporary files should be saved
+		// num_threads: maximal number of threads used, neither the result nor B depend on it
 		// function returns a pair of two integers, where the first integer corresponds to the order k whilst
 		// the second integer indicates the minimal amount of edges.
 		template<class t_csa_wt_type>
-		static std::pair<size_type,size_type> find_min_dbg( const t_csa_wt_type &csa, sdsl::bit_vector &B, sdsl::cache_config &config ) {
+		static std::pair<size_type,size_type> find_min_dbg( const t_csa_wt_type &csa, sdsl::bit_vector &B, sdsl::cache_config &config,
+		                                                    size_type num_threads = 1 ) {
 			//prepare bitvector B
 			//initialize B
 			B.resize( csa.size() + 1 );
@@ -105,7 +134,7 @@ class dbg_algorithms {
 			sdsl::int_vector_buffer<> nb_buffer(tmp_file_name, std::ios::out);
 
 			//run algorithm
-			auto result = minimize_dbg_edges<true>( csa, csa.size(), B, nb_buffer, [](size_type,size_type) {} );
+			auto result = minimize_dbg_edges<true>( csa, csa.size(), B, nb_buffer, [](size_type,size_type) {}, num_threads );
 
 			//retain node bounds of optimal solution
 			for (auto nb : nb_buffer) B[nb] = 0;
@@ -168,13 +197,60 @@ class dbg_algorithms {
 ///////////////////////////////////////////////////////////////////////////////
 
 //// EDGE MINIMIZATION ALGORITHM ////
+template<class t_csa_wt_type,
+         class f_mark_fusible>
+void dbg_algorithms::process_kmer_intervals( const t_csa_wt_type &csa, const sdsl::bit_vector &B,
+                                             const std::vector<kmer_queue> &Q, size_type c, size_type q, size_type cnt,
+                                             std::vector<kmer_queue> &N, level_counts &counts, size_type node_limit,
+                                             f_mark_fusible mark_fusible ) {
+	//variables needed for interval_symbols function
+	size_type iv_chars;
+	std::vector<unsigned char> cs ( csa.sigma );
+	std::vector<size_type> rank_c_i( csa.sigma );
+	std::vector<size_type> rank_c_j( csa.sigma );
+
+	for (; cnt > 0; cnt--, q++) {
+		while (q == Q[c].size()) {  // in alphabetical order
+			c++; q = 0;
+		}
+		size_type lb = Q[c][q].first, rb = Q[c][q].second;
+
+		sdsl::interval_symbols( csa.wavelet_tree, lb, rb + 1, iv_chars, cs, rank_c_i, rank_c_j );
+		if (iv_chars == 1) {  // reclassify edges
+			auto c = csa.char2comp[cs[0]];
+			auto i = csa.C[c] + rank_c_i[0];
+			auto j = csa.C[c] + rank_c_j[0] - 1;
+			if (B[i] == 1 && B[j+1] == 1) {  // node has no siblings
+				counts.reduced += (rb - lb);
+			} else {
+				counts.fusible += (rb - lb);  // possible fusion in next order
+			}
+			mark_fusible( rb );
+		}
+		for (size_type c_i = 0; c_i < iv_chars; c_i++) {
+			auto c = csa.char2comp[cs[c_i]];
+			auto i = csa.C[c] + rank_c_i[c_i];
+			auto j = csa.C[c] + rank_c_j[c_i] - 1 ;
+			if (B[i] == 0 || B[j+1] == 0) {
+				if (B[j+1] == 0) {
+					if (++counts.nodes >= node_limit) {
+						return;
+					}
+				}
+				N[c].emplace_back(i,j);
+			}
+		}
+	}
+}
+
 template<bool stop_on_min,
          class t_csa_wt_type,
          class f_order_edgecnt_output>
 std::pair<dbg_algorithms::size_type,dbg_algorithms::size_type> 
 dbg_algorithms::minimize_dbg_edges( const t_csa_wt_type &csa, size_type kmax, sdsl::bit_vector &B,
                                     sdsl::int_vector_buffer<> &nb_buffer,
-                                    f_order_edgecnt_output order_edgecnt_output ) {
+                                    f_order_edgecnt_output order_edgecnt_output,
+                                    size_type num_threads ) {
 	assert( csa.size() < std::numeric_limits<size_type>::max() );
 	//ensure some input is given
 	if (csa.size() == 0) {
@@ -182,69 +258,95 @@ dbg_algorithms::minimize_dbg_edges( const t_csa_wt_type &csa, size_type kmax, sd
 	}
 	size_type n = csa.size();   // initialize
 	sdsl::bit_vector F(n); 
-	std::vector<std::deque<std::pair<size_type,size_type>>> Q(csa.sigma);
-	std::vector<size_type> qsize(csa.sigma);
+	std::vector<kmer_queue> Q(csa.sigma), N(csa.sigma);
+	num_threads = std::max( num_threads, (size_type)1 );
 
 	B[0] = B[n] = 1;                  // boundaries of the root node
 	size_type nG = 1, m = n;          // node counter and edge counter
 	size_type ks = 1, ms = n;         // order with minimum number of edges ms
-	size_type fusible = 0;            // inherited fusions
 
-	//variables needed for interval_symbols function
-	size_type iv_chars;
-	std::vector<unsigned char> cs ( csa.sigma );
-	std::vector<size_type> rank_c_i( csa.sigma );
-	std::vector<size_type> rank_c_j( csa.sigma );
+	//per-thread results of an order, merged in thread order
+	std::vector<level_counts> part_counts;
+	std::vector<std::vector<kmer_queue>> part_N;
+	std::vector<std::vector<size_type>> part_F;
 
 	//queue initialization
 	Q.front().emplace_back( 0, csa.size() - 1 );
 
 	for (size_type k = 0; k <= kmax; k++) {  
-		fusible = 0;		
+		size_type qsize = 0;
 		for (size_type c = 0; c < csa.sigma; c++) {
-			qsize[c] = Q[c].size();
+			qsize += Q[c].size();
 		}
-		for (size_type c = 0; c < csa.sigma; c++) {  // in alphabetical order
-			for (size_type q = 0; q < qsize[c]; q++) {
-				auto iv = Q[c].front();
-				Q[c].pop_front();
-				size_type lb = iv.first, rb = iv.second;
-
-				sdsl::interval_symbols( csa.wavelet_tree, lb, rb + 1, iv_chars, cs, rank_c_i, rank_c_j );
-				if (iv_chars == 1) {  // reclassify edges
-					auto c = csa.char2comp[cs[0]];
-					auto i = csa.C[c] + rank_c_i[0];
-					auto j = csa.C[c] + rank_c_j[0] - 1;
-					if (B[i] == 1 && B[j+1] == 1) {  // node has no siblings
-						m -= (rb - lb);
-					} else {
-						fusible += (rb - lb);  // possible fusion in next order
-					}
-					F[rb] = 1; 
+		size_type node_limit = stop_on_min ? ms - nG : std::numeric_limits<size_type>::max();
+		size_type threads = std::min( num_threads, std::max( qsize / min_intervals_per_thread, (size_type)1 ) );
+
+		level_counts counts;
+		if (threads == 1) {
+			process_kmer_intervals( csa, B, Q, 0, 0, qsize, N, counts, node_limit,
+			                        [&F](size_type rb) { F[rb] = 1; } );
+		} else {
+			//split intervals of this order into consecutive parts, the first one being
+			//processed by this thread directly into N
+			if (part_counts.size() < threads) {
+				part_counts.resize( threads );
+				part_N.resize( threads - 1, std::vector<kmer_queue>( csa.sigma ) );
+				part_F.resize( threads - 1 );
+			}
+			std::vector<std::thread> workers;
+			size_type c = 0, q = 0;
+			for (size_type t = 0; t < threads; t++) {
+				size_type cnt = qsize * (t+1) / threads - qsize * t / threads;
+				part_counts[t] = level_counts();
+				if (t > 0) {
+					workers.emplace_back( [&,c,q,cnt,t]() {
+						process_kmer_intervals( csa, B, Q, c, q, cnt, part_N[t-1], part_counts[t], node_limit,
+						                        [&part_F,t](size_type rb) { part_F[t-1].push_back( rb ); } );
+					} );
 				}
-				for (size_type c_i = 0; c_i < iv_chars; c_i++) {
-					auto c = csa.char2comp[cs[c_i]];
-					auto i = csa.C[c] + rank_c_i[c_i];
-					auto j = csa.C[c] + rank_c_j[c_i] - 1 ;
-					if (B[i] == 0 || B[j+1] == 0) {
-						if (B[j+1] == 0) {
-							nG++;
-							if (stop_on_min && nG >= ms) {
-								return std::make_pair( ks, ms );
-							}
-						}
-						Q[c].emplace_back(i,j);
-					}
+				//advance to the start of the next part
+				for (q += cnt; c + 1 < csa.sigma && q >= Q[c].size(); c++) {
+					q -= Q[c].size();
+				}
+			}
+			process_kmer_intervals( csa, B, Q, 0, 0, qsize / threads, N, part_counts[0], node_limit,
+			                        [&F](size_type rb) { F[rb] = 1; } );
+			for (auto &worker : workers) {
+				worker.join();
+			}
+
+			//merge results in the order of the parts, as if processed sequentially
+			for (size_type t = 0; t < threads; t++) {
+				counts.nodes += part_counts[t].nodes;
+				counts.reduced += part_counts[t].reduced;
+				counts.fusible += part_counts[t].fusible;
+			}
+			for (size_type t = 1; t < threads; t++) {
+				for (auto rb : part_F[t-1]) F[rb] = 1;
+				part_F[t-1].clear();
+				for (size_type c = 0; c < csa.sigma; c++) {
+					N[c].insert( N[c].end(), part_N[t-1][c].begin(), part_N[t-1][c].end() );
+					part_N[t-1][c].clear();
 				}
 			}
 		}
+		nG += counts.nodes;
+		if (stop_on_min && nG >= ms) {
+			return std::make_pair( ks, ms );
+		}
+		m -= counts.reduced;
+		for (size_type c = 0; c < csa.sigma; c++) {
+			Q[c].clear();
+		}
+		std::swap( Q, N );
+
 		order_edgecnt_output( k, m );
 		if (m < ms) {
 			ks = k;
 			ms = m;
 			nb_buffer.reset(); //EXTERNAL CLEAR
 		}
-		m -= fusible;  // establish new inherited fusions
+		m -= counts.fusible;  // establish new inherited fusions
 		size_type last = std::numeric_limits<size_type>::max();
 		for (size_type c = 0; c < csa.sigma; c++) {
 			for (auto iv : Q[c]) {
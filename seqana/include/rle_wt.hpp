@@ -0,0 +1,254 @@
+/*
+ * rle_wt.hpp for BWT Tunneling
+ * Copyright (c) 2020 Uwe Baier All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RLE_WT_HPP
+#define RLE_WT_HPP
+
+#include <sdsl/bit_vectors.hpp>
+#include <sdsl/int_vector.hpp>
+#include <sdsl/int_vector_buffer.hpp>
+#include <sdsl/io.hpp>
+#include <sdsl/sd_vector.hpp>
+#include <sdsl/sdsl_concepts.hpp>
+#include <sdsl/util.hpp>
+#include <sdsl/wavelet_trees.hpp>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+//! a run-length encoded wavelet tree over a byte sequence. The first character of each run
+//! (run head) is stored in a wavelet tree, the starts of all runs are marked in a sparse bitvector,
+//! and the runs of each character are concatenated in a second sparse bitvector in order
+//! of characters. Hence, space is proportional to the number of runs rather than to the length.
+//! The class supports the operations of a wavelet tree needed by a tunneled fm index
+//! (access, rank, select and inverse_select), so it can be used as tfm_index<rle_wt<>>.
+template<class t_wt_type =       sdsl::wt_blcd<>,
+         class t_bv_type =       sdsl::sd_vector<>,
+         class t_rank_type =     typename t_bv_type::rank_1_type,
+         class t_select_type =   typename t_bv_type::select_1_type>
+class rle_wt {
+public:
+	typedef sdsl::int_vector<>::size_type           size_type;
+	typedef typename t_wt_type::value_type          value_type;
+	typedef sdsl::byte_alphabet_tag                 alphabet_category;
+
+	typedef t_wt_type                               wt_type;
+	//bitvector type of the run heads, used as default bitvector type of tunneled fm indexes
+	typedef typename t_wt_type::bit_vector_type     bit_vector_type;
+	typedef t_bv_type                               run_bv_type;
+	typedef t_rank_type                             run_rank_type;
+	typedef t_select_type                           run_select_type;
+
+private:
+	size_type                                       m_size = 0;
+	size_type                                       m_sigma = 0;
+	wt_type                                         m_heads; //first character of each run
+	run_bv_type                                     m_run_start; //marks the first position of each run
+	run_rank_type                                   m_run_start_rank;
+	run_select_type                                 m_run_start_select;
+	run_bv_type                                     m_char_run; //runs grouped by character, block of c starts at m_C[c]
+	run_rank_type                                   m_char_run_rank;
+	run_select_type                                 m_char_run_select;
+	std::vector<size_type>                          m_C; //number of occurrences of smaller characters
+	std::vector<size_type>                          m_run_C; //number of runs of smaller characters
+
+	//! returns the run containing position i
+	size_type run_of( size_type i ) const {
+		return m_run_start_rank( i + 1 ) - 1;
+	}
+
+	//! returns the number of occurrences of c within the first j runs of c
+	size_type run_prefix_count( value_type c, size_type j ) const {
+		return m_char_run_select( m_run_C[c] + j + 1 ) - m_C[c];
+	}
+
+	void init_supports() {
+		sdsl::util::init_support( m_run_start_rank, &m_run_start );
+		sdsl::util::init_support( m_run_start_select, &m_run_start );
+		sdsl::util::init_support( m_char_run_rank, &m_char_run );
+		sdsl::util::init_support( m_char_run_select, &m_char_run );
+		m_sigma = m_heads.sigma;
+	}
+
+public:
+	const size_type &                               sigma = m_sigma;
+	const wt_type &                                 heads = m_heads;
+	const run_bv_type &                             run_start = m_run_start;
+
+	rle_wt() {}
+	rle_wt( const rle_wt & ) = delete;
+	rle_wt &operator=( const rle_wt & ) = delete;
+
+	rle_wt &operator=( rle_wt &&other ) {
+		m_size = other.m_size;
+		m_heads = std::move( other.m_heads );
+		m_run_start = std::move( other.m_run_start );
+		m_char_run = std::move( other.m_char_run );
+		m_C = std::move( other.m_C );
+		m_run_C = std::move( other.m_run_C );
+		init_supports();
+		return *this;
+	}
+
+	//! constructs the run-length encoded wavelet tree from the first size entries of buf.
+	//! The run heads are buffered in a temporary file next to buf.
+	rle_wt( sdsl::int_vector_buffer<8> &buf, size_type size ) : m_size( size ) {
+		//count occurrences and runs of each character
+		m_C.assign( 257, 0 );
+		m_run_C.assign( 257, 0 );
+		for (size_type i = 0; i < size; i++) {
+			m_C[buf[i] + 1]++;
+			if (i == 0 || buf[i] != buf[i-1]) {
+				m_run_C[buf[i] + 1]++;
+			}
+		}
+		for (size_type c = 0; c < 256; c++) {
+			m_C[c+1] += m_C[c];
+			m_run_C[c+1] += m_run_C[c];
+		}
+
+		//mark runs in order of positions and in order of characters, and collect run heads
+		std::string heads_file = sdsl::tmp_file( buf.filename(), "_rle_heads" );
+		{
+			sdsl::int_vector_buffer<8> heads_buf( heads_file, std::ios::out );
+			sdsl::bit_vector run_start( size + 1, 0 );
+			sdsl::bit_vector char_run( size + 1, 0 );
+			std::vector<size_type> next( m_C.begin(), m_C.end() - 1 );
+			for (size_type i = 0, s = 0; i < size; i++) {
+				if (i + 1 == size || buf[i+1] != buf[i]) { //end of run [s,i]
+					value_type c = buf[i];
+					heads_buf.push_back( c );
+					run_start[s] = 1;
+					char_run[next[c]] = 1;
+					next[c] += i + 1 - s;
+					s = i + 1;
+				}
+			}
+			run_start[size] = 1;
+			char_run[size] = 1;
+			m_run_start = run_bv_type( run_start );
+			m_char_run = run_bv_type( char_run );
+			m_heads = wt_type( heads_buf, heads_buf.size() );
+		}
+		sdsl::remove( heads_file );
+		init_supports();
+	}
+
+	//! returns the length of the sequence
+	size_type size() const {
+		return m_size;
+	}
+
+	//! returns the number of runs
+	size_type runs() const {
+		return m_heads.size();
+	}
+
+	//! returns the i-th character
+	value_type operator[]( size_type i ) const {
+		return m_heads[run_of( i )];
+	}
+
+	//! returns the number of occurrences of c in the prefix [0,i)
+	size_type rank( size_type i, value_type c ) const {
+		if (i == 0) return 0;
+		size_type k = run_of( i - 1 );
+		auto is = m_heads.inverse_select( k );
+		if (is.second == c) {
+			return run_prefix_count( c, is.first ) + i - m_run_start_select( k + 1 );
+		}
+		return run_prefix_count( c, m_heads.rank( k, c ) );
+	}
+
+	//! returns the position of the k-th occurrence of c (k >= 1)
+	size_type select( size_type k, value_type c ) const {
+		size_type p = m_C[c] + k - 1;
+		size_type j = m_char_run_rank( p + 1 ); //runs of characters up to c, including the run of p
+		size_type offset = p - m_char_run_select( j );
+		return m_run_start_select( m_heads.select( j - m_run_C[c], c ) + 1 ) + offset;
+	}
+
+	//! returns the number of occurrences of the i-th character in the prefix [0,i), and the character itself
+	std::pair<size_type,value_type> inverse_select( size_type i ) const {
+		size_type k = run_of( i );
+		auto is = m_heads.inverse_select( k );
+		return std::make_pair( run_prefix_count( is.second, is.first ) + i - m_run_start_select( k + 1 ),
+		                       is.second );
+	}
+
+	//! lists the k distinct characters cs of the interval [i,j), and their ranks at the interval bounds
+	void interval_symbols( size_type i, size_type j, size_type &k, std::vector<value_type> &cs,
+	                       std::vector<size_type> &rank_c_i, std::vector<size_type> &rank_c_j ) const {
+		k = 0;
+		if (i >= j) return;
+		sdsl::interval_symbols( m_heads, run_of( i ), run_of( j - 1 ) + 1, k, cs, rank_c_i, rank_c_j );
+		for (size_type x = 0; x < k; x++) {
+			rank_c_i[x] = rank( i, cs[x] );
+			rank_c_j[x] = rank( j, cs[x] );
+		}
+	}
+
+	//! serializes opbject
+	size_type serialize(std::ostream &out, sdsl::structure_tree_node *v, std::string name) const {
+		sdsl::structure_tree_node *child =
+			sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+		size_type written_bytes = 0;
+		written_bytes += sdsl::write_member(m_size, out, child, "size");
+		written_bytes += m_heads.serialize(out, child, "heads");
+
+		written_bytes += m_run_start.serialize(out, child, "run_start");
+		written_bytes += m_run_start_rank.serialize(out, child, "run_start_rank");
+		written_bytes += m_run_start_select.serialize(out, child, "run_start_select");
+
+		written_bytes += m_char_run.serialize(out, child, "char_run");
+		written_bytes += m_char_run_rank.serialize(out, child, "char_run_rank");
+		written_bytes += m_char_run_select.serialize(out, child, "char_run_select");
+
+		written_bytes += sdsl::serialize(m_C, out, child, "C");
+		written_bytes += sdsl::serialize(m_run_C, out, child, "run_C");
+
+		sdsl::structure_tree::add_size(child, written_bytes);
+		return written_bytes;
+	}
+
+	//! loads a serialized object
+	void load(std::istream &in) {
+		sdsl::read_member( m_size, in );
+		m_heads.load(in);
+
+		m_run_start.load(in);
+		m_run_start_rank.load(in, &m_run_start);
+		m_run_start_select.load(in, &m_run_start);
+
+		m_char_run.load(in);
+		m_char_run_rank.load(in, &m_char_run);
+		m_char_run_select.load(in, &m_char_run);
+
+		sdsl::load(m_C, in);
+		sdsl::load(m_run_C, in);
+		m_sigma = m_heads.sigma;
+	}
+};
+
+#endif
@@ -38,25 +38,74 @@
 #include <sdsl/io.hpp>
 #include <sdsl/construct_lcp_helper.hpp>
 #include <sdsl/rank_support.hpp>
+#include <sdsl/sd_vector.hpp>
 #include <sdsl/sdsl_concepts.hpp>
 #include <sdsl/select_support.hpp>
 #include <sdsl/util.hpp>
 #include <sdsl/wavelet_trees.hpp>
 
 #include <algorithm>
+#include <fstream>
 #include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unistd.h>
 #include <utility>
+#include <vector>
 
 #include "dbg_algorithms.hpp"
+#include "tfm_index_queries.hpp"
+#include "tfm_nav_bitvectors.hpp"
 
 struct tfm_index_tag {};
 
+//! serialized format of a tfm index. Its members are preceded by tfm_format_magic, the format
+//! version and flags marking the optional members which are stored. Files of the initial format
+//! start with the text length instead and end after the navigation bitvectors.
+const uint64_t tfm_format_magic = 0x5845444e494d4654ULL; //"TFMINDEX"
+const uint64_t tfm_format_version = 1;
+const uint64_t tfm_format_samples = 1;     //flag, sampled text positions are stored
+const uint64_t tfm_format_checkpoints = 2; //flag, checkpoints are stored
+const uint64_t tfm_format_rle_L = 4;       //flag, L is a run-length encoded wavelet tree (see rle_wt.hpp)
+const uint64_t tfm_format_fused_nav = 8;   //flag, din and dout are fused (see tfm_fused_nav_bv)
+
+template<class t_wt_type, class t_bv_type, class t_rank_type, class t_select_type>
+class rle_wt;
+
+//! format flags describing the representation of L
+template<class t_wt_type>
+struct tfm_format_L {
+	static uint64_t flags() { return 0; }
+};
+
+template<class t_wt_type, class t_bv_type, class t_rank_type, class t_select_type>
+struct tfm_format_L<rle_wt<t_wt_type,t_bv_type,t_rank_type,t_select_type>> {
+	static uint64_t flags() { return tfm_format_rle_L; }
+};
+
+//! reads the format flags of a serialized tfm index from the start of the given file, such that
+//! the type of the index can be chosen before loading it. Indices of the initial format have no flags.
+//! Returns false if the file can not be read.
+inline bool load_tfm_format_flags( const std::string &file, uint64_t &flags ) {
+	std::ifstream in( file, std::ios::binary );
+	uint64_t magic = 0, version = 0;
+	flags = 0;
+	sdsl::read_member( magic, in );
+	if (magic == tfm_format_magic) {
+		sdsl::read_member( version, in );
+		sdsl::read_member( flags, in );
+	}
+	return (bool)in;
+}
+
 //! a class representing a tunneled fm-index
 template<class t_wt_type =       sdsl::wt_blcd<>,
          class t_bv_type =       typename t_wt_type::bit_vector_type,
          class t_rank_type =     typename t_bv_type::rank_1_type,
          class t_select_type =   typename t_bv_type::select_1_type>
-class tfm_index {
+class tfm_index : public tfm_index_queries<tfm_index<t_wt_type,t_bv_type,t_rank_type,t_select_type>,
+                                           typename t_wt_type::value_type> {
 public:
 	typedef tfm_index_tag                           index_category;
 	typedef sdsl::byte_alphabet_tag                 alphabet_category;
@@ -66,9 +115,16 @@ public:
 	typedef typename t_wt_type::value_type          value_type;
 
 	typedef t_wt_type                               wt_type;
-        typedef t_bv_type                               bit_vector_type;
-        typedef t_rank_type                             rank_type;
-	typedef t_select_type                           select_type;
+	//bundle of din and dout, either separate bitvectors or the fused layout tfm_fused_nav_bv
+	typedef typename tfm_nav_bundle<t_bv_type,t_rank_type,t_select_type>::type nav_bundle_type;
+	typedef typename nav_bundle_type::bv_type       bit_vector_type;
+	typedef typename nav_bundle_type::rank_type     rank_type;
+	typedef typename nav_bundle_type::select_type   select_type;
+
+	//bitvector marking the first row of the original BWT represented by each entry of L
+	typedef sdsl::sd_vector<>                       row_bv_type;
+	typedef typename row_bv_type::rank_1_type       row_rank_type;
+	typedef typename row_bv_type::select_1_type     row_select_type;
 
 	//first index is next outgoing edge, second index is tunnel entry offset
 	typedef std::pair<size_type,size_type>          nav_type;
@@ -77,70 +133,96 @@ private:
 	template <typename t_tfm_index_type>
 	friend void construct_tfm_index( t_tfm_index_type &tfm_index, uint64_t text_len, 
 		sdsl::int_vector_buffer<8> &&L_buf, sdsl::bit_vector &&dout, sdsl::bit_vector &&din );
+	template <typename t_tfm_index_type>
+	friend void construct_tfm_samples( t_tfm_index_type &tfm_index, uint64_t sample_rate,
+		sdsl::int_vector<> &&sample_rows );
+	template <typename t_tfm_index_type>
+	friend void construct_tfm_checkpoints( t_tfm_index_type &tfm_index, uint64_t checkpoint_rate,
+		sdsl::int_vector<> &&checkpoint_rows );
 
 	size_type                                       text_len; //original textlen
 	wt_type                                         m_L;
 	std::vector<size_type>                          m_C;
-	bit_vector_type                                 m_dout;
-	rank_type                                       m_dout_rank;
-	select_type                                     m_dout_select;
-        bit_vector_type                                 m_din;
-	rank_type                                       m_din_rank;
-	select_type                                     m_din_select;
+	nav_bundle_type                                 m_nav;
+	row_bv_type                                     m_row_start;
+	row_rank_type                                   m_row_start_rank;
+	row_select_type                                 m_row_start_select;
+	size_type                                       m_sample_rate = 0; //zero if no text positions are sampled
+	row_bv_type                                     m_sampled;
+	row_rank_type                                   m_sampled_rank;
+	sdsl::int_vector<>                              m_samples;
+	size_type                                       m_checkpoint_rate = 0; //zero if no checkpoints are stored
+	sdsl::int_vector<>                              m_checkpoint_pos;
+	sdsl::int_vector<>                              m_checkpoint_offset;
+
+	//! returns the format flags describing the representation of L, din and dout
+	static uint64_t representation_flags() {
+		return tfm_format_L<t_wt_type>::flags()
+		     | (std::is_same<t_bv_type,tfm_fused_nav_bv>::value ? tfm_format_fused_nav : 0);
+	}
+
+	//! computes the row starts, all entries of L represent a single row of the original BWT,
+	//! except of those within a tunnel, which represent as many rows as the tunnel is wide
+	void construct_row_start() {
+		sdsl::int_vector<> width( L.size(), 1, sdsl::bits::hi( text_len ) + 1 );
+		for (size_type j = 0, r = 0; j + 1 < din.size(); j++) {
+			if (din[j] == 0) continue;
+			r++;
+			if (din[j+1] == 1) continue;
+
+			//node r has multiple incoming edges, follow the tunnel until it fans out again
+			size_type w = din_select( r + 1 ) - j;
+			size_type i = dout_select( r );
+			while (dout[i+1] == 1) {
+				width[i] = w;
+				auto is = L.inverse_select( i );
+				i = dout_select( din_rank( C[is.second] + is.first + 1 ) );
+			}
+		}
+		sdsl::bit_vector row_start( text_len + 1, 0 );
+		for (size_type i = 0, row = 0; i < width.size(); row += width[i++]) {
+			row_start[row] = 1;
+		}
+		row_start[text_len] = 1;
+		sdsl::int_vector<>().swap( width );
+		m_row_start = row_bv_type( row_start );
+		sdsl::util::init_support( m_row_start_rank, &m_row_start );
+		sdsl::util::init_support( m_row_start_select, &m_row_start );
+	}
 
 public:
 	const wt_type &                                        L = m_L;
 	const std::vector<size_type> &                         C = m_C;
-        const bit_vector_type &                                dout = m_dout;
-	const rank_type &                                      dout_rank = m_dout_rank;
-	const select_type &                                    dout_select = m_dout_select;
-	const bit_vector_type &                                din = m_din;
-	const rank_type &                                      din_rank = m_din_rank;
-	const select_type &                                    din_select = m_din_select;
+	const bit_vector_type &                                dout = m_nav.dout;
+	const rank_type &                                      dout_rank = m_nav.dout_rank;
+	const select_type &                                    dout_select = m_nav.dout_select;
+	const bit_vector_type &                                din = m_nav.din;
+	const rank_type &                                      din_rank = m_nav.din_rank;
+	const select_type &                                    din_select = m_nav.din_select;
+	const row_bv_type &                                    row_start = m_row_start;
+	const row_rank_type &                                  row_start_rank = m_row_start_rank;
+	const row_select_type &                                row_start_select = m_row_start_select;
+	const row_bv_type &                                    sampled = m_sampled;
+	const row_rank_type &                                  sampled_rank = m_sampled_rank;
+	const sdsl::int_vector<> &                             samples = m_samples;
+	const sdsl::int_vector<> &                             checkpoint_pos = m_checkpoint_pos;
+	const sdsl::int_vector<> &                             checkpoint_offset = m_checkpoint_offset;
 
 	//! returns the size of the original string
 	size_type size() const {
 		return text_len;
 	};
 
-	//! returns the end, i.e. the position in L where the string ends
-	nav_type end() const {
-		return std::make_pair( (size_type)0, (size_type)0 );
+	//! returns the distance of sampled text positions, zero if the index contains no samples
+	size_type sample_rate() const {
+		return m_sample_rate;
 	}
 
-	//! returns the character preceding the current position
-	value_type preceding_char( const nav_type &pos ) const {
-		return L[pos.first];
+	//! returns the distance of text positions stored as checkpoints, zero if the index contains no checkpoints
+	size_type checkpoint_rate() const {
+		return m_checkpoint_rate;
 	}
 
-	//! Operation performs an backward step from current position.
-	//! function sets posm to the new value and returns the result
-	//! of preceding_char( pos ) before the backward step was performed
-	value_type backwardstep( nav_type &pos ) const {
-		size_type &i = pos.first; //create references into position pair
-		size_type &o = pos.second;
-
-		//navigate to next entry
-		auto is = L.inverse_select( i );
-		auto c = is.second;
-		i = C[c] + is.first;
-
-		//check for the start of a tunnel
-		auto din_rank_ip1 = din_rank( i + 1 );
-		if (din[i] == 0) {
-			o = i - din_select( din_rank_ip1 ); //save offset to uppermost entry edge
-		}
-		//navigate to outedges of current node
-		i = dout_select( din_rank_ip1 );
-
-		//check for end of a tunnel
-		if (dout[i+1] == 0) {
-			i += o; //jump back offset
-			o = 0;
-		}
-		return c;
-	};
-
 	//! serializes opbject
 	size_type serialize(std::ostream &out, sdsl::structure_tree_node *v,
                           std::string name) const {
@@ -148,43 +230,129 @@ public:
 		sdsl::structure_tree_node *child =
 			sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this));
 		size_type written_bytes = 0;
+		uint64_t flags = representation_flags()
+		               | (m_sample_rate > 0 ? tfm_format_samples : 0)
+		               | (m_checkpoint_rate > 0 ? tfm_format_checkpoints : 0);
+		written_bytes += sdsl::write_member(tfm_format_magic, out, child, "magic");
+		written_bytes += sdsl::write_member(tfm_format_version, out, child, "version");
+		written_bytes += sdsl::write_member(flags, out, child, "flags");
 		written_bytes += sdsl::write_member(text_len, out, child, "text_len");
 
 		written_bytes += m_L.serialize(out, child, "L");
 		written_bytes += sdsl::serialize(m_C, out, child, "C");
 
-		written_bytes += m_dout.serialize(out, child, "dout");
-		written_bytes += m_dout_rank.serialize(out, child, "dout_rank");
-		written_bytes += m_dout_select.serialize(out, child, "dout_select");
+		written_bytes += m_nav.serialize(out, child, "nav");
 
-		written_bytes += m_din.serialize(out, child, "din");
-		written_bytes += m_din_rank.serialize(out, child, "din_rank");
-		written_bytes += m_din_select.serialize(out, child, "din_select");
+		written_bytes += m_row_start.serialize(out, child, "row_start");
+		written_bytes += m_row_start_rank.serialize(out, child, "row_start_rank");
+		written_bytes += m_row_start_select.serialize(out, child, "row_start_select");
+
+		if (flags & tfm_format_samples) {
+			written_bytes += sdsl::write_member(m_sample_rate, out, child, "sample_rate");
+			written_bytes += m_sampled.serialize(out, child, "sampled");
+			written_bytes += m_sampled_rank.serialize(out, child, "sampled_rank");
+			written_bytes += m_samples.serialize(out, child, "samples");
+		}
+
+		if (flags & tfm_format_checkpoints) {
+			written_bytes += sdsl::write_member(m_checkpoint_rate, out, child, "checkpoint_rate");
+			written_bytes += m_checkpoint_pos.serialize(out, child, "checkpoint_pos");
+			written_bytes += m_checkpoint_offset.serialize(out, child, "checkpoint_offset");
+		}
 
 		sdsl::structure_tree::add_size(child, written_bytes);
 		return written_bytes;
 	};
 
-	//! loads a serialized object
+	//! loads a serialized object, either of the current or of the initial format (see tfm_format_magic).
+	//! Throws a runtime_error if the format version or the stored members are unknown, or if the
+	//! index was stored with a different representation of L or of din and dout (see load_tfm_format_flags).
 	void load(std::istream &in) {
 
-		sdsl::read_member( text_len, in );
+		uint64_t magic = 0, flags = 0;
+		sdsl::read_member( magic, in );
+		if (magic == tfm_format_magic) {
+			uint64_t version = 0;
+			sdsl::read_member( version, in );
+			if (version != tfm_format_version) {
+				throw std::runtime_error( "unsupported format version " + std::to_string( version ) + " of tunneled fm index" );
+			}
+			sdsl::read_member( flags, in );
+			if (flags & ~(tfm_format_samples | tfm_format_checkpoints | tfm_format_rle_L | tfm_format_fused_nav)) {
+				throw std::runtime_error( "unsupported members of tunneled fm index" );
+			}
+			sdsl::read_member( text_len, in );
+		}
+		else {
+			text_len = magic; //initial format
+		}
+		if ((flags & (tfm_format_rle_L | tfm_format_fused_nav)) != representation_flags()) {
+			throw std::runtime_error( "tunneled fm index uses a different representation of L or of din and dout" );
+		}
 
 		m_L.load(in);
 		sdsl::load(m_C, in);
 
-		m_dout.load(in);
-		m_dout_rank.load(in, &m_dout);
-		m_dout_select.load(in, &m_dout);
+		m_nav.load(in);
+
+		if (magic == tfm_format_magic) {
+			m_row_start.load(in);
+			m_row_start_rank.load(in, &m_row_start);
+			m_row_start_select.load(in, &m_row_start);
+		}
+		else {
+			construct_row_start();
+		}
 
-		m_din.load(in);
-		m_din_rank.load(in, &m_din);
-		m_din_select.load(in, &m_din);
+		m_sample_rate = 0;
+		m_sampled = row_bv_type();
+		m_sampled_rank = row_rank_type();
+		m_samples = sdsl::int_vector<>();
+		if (flags & tfm_format_samples) {
+			sdsl::read_member( m_sample_rate, in );
+			m_sampled.load(in);
+			m_sampled_rank.load(in, &m_sampled);
+			m_samples.load(in);
+		}
+
+		m_checkpoint_rate = 0;
+		m_checkpoint_pos = sdsl::int_vector<>();
+		m_checkpoint_offset = sdsl::int_vector<>();
+		if (flags & tfm_format_checkpoints) {
+			sdsl::read_member( m_checkpoint_rate, in );
+			m_checkpoint_pos.load(in);
+			m_checkpoint_offset.load(in);
+		}
 	};
 };
 
 //// SPECIAL CONSTRUCTION FOR TUNNELED FM INDEX ///////////////////////////////
 
+//! placement of the buffer holding L while the wavelet tree of a tfm index is constructed
+enum class tfm_buffer_mode {
+	automatic, //in memory if the buffer fits into tfm_buffer_ram_limit(), streamed otherwise
+	memory,    //in memory as sdsl RAM file, the wavelet tree is built without disk accesses
+	stream     //streamed through a file, such that L is held in memory only as wavelet tree
+};
+
+//! returns the number of bytes an in-memory buffer may occupy in automatic mode,
+//! which is half of the currently available physical memory
+inline uint64_t tfm_buffer_ram_limit() {
+	long pages = sysconf( _SC_AVPHYS_PAGES );
+	long page_size = sysconf( _SC_PAGESIZE );
+	return (pages > 0 && page_size > 0) ? (uint64_t)pages * (uint64_t)page_size / 2 : 0;
+}
+
+//! returns the name of a buffer of size bytes, either the given file (streaming mode)
+//! or a RAM file of the same name (memory mode)
+inline std::string tfm_buffer_file_name( const std::string &file, uint64_t size, tfm_buffer_mode mode ) {
+	if (mode == tfm_buffer_mode::memory
+	    || (mode == tfm_buffer_mode::automatic && size <= tfm_buffer_ram_limit())) {
+		return sdsl::ram_file_name( file );
+	}
+	return file;
+}
+
 template <class t_index>
 void construct(t_index &idx, const std::string &file, sdsl::cache_config &config,
                uint8_t num_bytes, tfm_index_tag) {
@@ -206,11 +374,17 @@ void construct(t_index &idx, const std::string &file, sdsl::cache_config &config
 
 //! function constructs a tfm index using a compressed suffix array in form of a BWT in a wavelet tree.
 //! note that the csa is erased during construction
+//! if sample_rate is nonzero, every sample_rate-th text position is sampled to support locate queries
+//! if checkpoint_rate is nonzero, every checkpoint_rate-th text position is stored as a checkpoint to support extraction
+//! the compacted L is buffered as given by buffer_mode, see tfm_buffer_mode
+//! the minimal edge-reduced DBG is searched using at most num_threads threads
 //! function returns the result of the dbg_algorithms::find_min_dbg - function
 template<class t_tfm_index_type,
          class t_csa_wt_type>
 std::pair<typename t_tfm_index_type::size_type,typename t_tfm_index_type::size_type>
-construct_tfm_index( t_tfm_index_type &tfm_index, t_csa_wt_type &&csa, sdsl::cache_config &config ) {
+construct_tfm_index( t_tfm_index_type &tfm_index, t_csa_wt_type &&csa, sdsl::cache_config &config,
+                     uint64_t sample_rate = 0, uint64_t checkpoint_rate = 0,
+                     tfm_buffer_mode buffer_mode = tfm_buffer_mode::automatic, uint64_t num_threads = 1 ) {
 	typedef typename t_tfm_index_type::size_type size_type;
 	std::pair<size_type,size_type> dbg_res;
 
@@ -218,7 +392,7 @@ construct_tfm_index( t_tfm_index_type &tfm_index, t_csa_wt_type &&csa, sdsl::cac
         sdsl::bit_vector B;
 	{
 		auto event = sdsl::memory_monitor::event("FINDMINDBG");
-		dbg_res = dbg_algorithms::find_min_dbg( csa, B, config );
+		dbg_res = dbg_algorithms::find_min_dbg( csa, B, config, num_threads );
 	}
 
 	//use bitvector to determine prefix intervals to be tunneled
@@ -229,7 +403,8 @@ construct_tfm_index( t_tfm_index_type &tfm_index, t_csa_wt_type &&csa, sdsl::cac
 
 	//create a buffer for newly constructed L
 	std::string tmp_key = sdsl::util::to_string(sdsl::util::pid())+"_"+sdsl::util::to_string(sdsl::util::id());
-	std::string tmp_file_name = sdsl::cache_file_name(tmp_key, config);
+	std::string tmp_file_name = tfm_buffer_file_name( sdsl::cache_file_name(tmp_key, config),
+	                                                  sdsl::util::cnt_one_bits( din ), buffer_mode );
 	{
 		sdsl::int_vector_buffer<8> L_buf(tmp_file_name, std::ios::out);
 
@@ -249,10 +424,38 @@ construct_tfm_index( t_tfm_index_type &tfm_index, t_csa_wt_type &&csa, sdsl::cac
 		dout.resize( p );
 		din.resize( q );
 
+		//collect rows of sampled text positions and checkpoints by walking backwards through the csa
 		uint64_t text_len = csa.size();
+		sdsl::int_vector<> sample_rows;
+		sdsl::int_vector<> checkpoint_rows;
+		if (sample_rate > 0) {
+			sample_rows = sdsl::int_vector<>( (text_len - 1) / sample_rate + 1, 0, sdsl::bits::hi( text_len ) + 1 );
+		}
+		if (checkpoint_rate > 0) {
+			checkpoint_rows = sdsl::int_vector<>( (text_len - 1) / checkpoint_rate + 1, 0, sdsl::bits::hi( text_len ) + 1 );
+		}
+		if (sample_rate > 0 || checkpoint_rate > 0) {
+			size_type row = 0;
+			for (size_type k = text_len; k-- > 0; ) {
+				if (sample_rate > 0 && k % sample_rate == 0) {
+					sample_rows[k / sample_rate] = row;
+				}
+				if (checkpoint_rate > 0 && k % checkpoint_rate == 0) {
+					checkpoint_rows[k / checkpoint_rate] = row;
+				}
+				auto is = csa.wavelet_tree.inverse_select( row );
+				row = csa.C[csa.char2comp[is.second]] + is.first;
+			}
+		}
 		csa = t_csa_wt_type(); //remove csa object as it is no longer required
 
 		construct_tfm_index( tfm_index, text_len, std::move( L_buf ), std::move( dout ), std::move( din ) );
+		if (sample_rate > 0) {
+			construct_tfm_samples( tfm_index, sample_rate, std::move( sample_rows ) );
+		}
+		if (checkpoint_rate > 0) {
+			construct_tfm_checkpoints( tfm_index, checkpoint_rate, std::move( checkpoint_rows ) );
+		}
 	}
 	//remove buffer for L
 	sdsl::remove(tmp_file_name);
@@ -266,21 +469,92 @@ void construct_tfm_index( t_tfm_index_type &tfm_index, uint64_t text_len, sdsl::
 
 	//construct tfm index from L, din and dout
 	typedef typename t_tfm_index_type::wt_type         wt_type;
-	typedef typename t_tfm_index_type::bit_vector_type bv_type;
 
 	//wavelet tree of L
 	tfm_index.m_L = wt_type( L_buf, L_buf.size() );
 	sdsl::create_C_array( tfm_index.m_C, tfm_index.m_L );
 
-	//dout
-	tfm_index.m_dout = bv_type( std::move( dout ) );
-	sdsl::util::init_support( tfm_index.m_dout_rank, &tfm_index.m_dout );
-	sdsl::util::init_support( tfm_index.m_dout_select, &tfm_index.m_dout );
+	//dout and din
+	tfm_index.m_nav.init( std::move( dout ), std::move( din ) );
+
+	//row starts
+	tfm_index.construct_row_start();
+};
+
+//! function samples the text positions of a tfm index, where sample_rows[j] has to be the
+//! row of the original BWT corresponding to text position j * sample_rate
+template<class t_tfm_index_type>
+void construct_tfm_samples( t_tfm_index_type &tfm_index, uint64_t sample_rate, sdsl::int_vector<> &&sample_rows ) {
+	typedef typename t_tfm_index_type::size_type size_type;
+
+	//mark sampled rows
+	sdsl::bit_vector sampled( tfm_index.size(), 0 );
+	for (size_type j = 0; j < sample_rows.size(); j++) {
+		sampled[sample_rows[j]] = 1;
+	}
+	tfm_index.m_sample_rate = sample_rate;
+	tfm_index.m_sampled = typename t_tfm_index_type::row_bv_type( sampled );
+	sdsl::util::init_support( tfm_index.m_sampled_rank, &tfm_index.m_sampled );
+	sdsl::bit_vector().swap( sampled );
+
+	//store sampled text positions in order of rows
+	tfm_index.m_samples = sdsl::int_vector<>( sample_rows.size(), 0, sdsl::bits::hi( sample_rows.size() ) + 1 );
+	for (size_type j = 0; j < sample_rows.size(); j++) {
+		tfm_index.m_samples[tfm_index.m_sampled_rank( sample_rows[j] )] = j;
+	}
+};
+
+//! function samples every sample_rate-th text position of an already constructed tfm index,
+//! by walking backwards through the whole index
+template<class t_tfm_index_type>
+void construct_tfm_samples( t_tfm_index_type &tfm_index, uint64_t sample_rate ) {
+	typedef typename t_tfm_index_type::size_type size_type;
+	assert( sample_rate > 0 );
+
+	sdsl::int_vector<> sample_rows( (tfm_index.size() - 1) / sample_rate + 1, 0, sdsl::bits::hi( tfm_index.size() ) + 1 );
+	auto pos = tfm_index.end();
+	for (size_type k = tfm_index.size(); k-- > 0; ) {
+		if (k % sample_rate == 0) {
+			sample_rows[k / sample_rate] = tfm_index.nav_to_row( pos );
+		}
+		tfm_index.backwardstep( pos );
+	}
+	construct_tfm_samples( tfm_index, sample_rate, std::move( sample_rows ) );
+};
+
+//! function stores checkpoints of a tfm index, where checkpoint_rows[j] has to be the
+//! row of the original BWT corresponding to text position j * checkpoint_rate
+template<class t_tfm_index_type>
+void construct_tfm_checkpoints( t_tfm_index_type &tfm_index, uint64_t checkpoint_rate, sdsl::int_vector<> &&checkpoint_rows ) {
+	typedef typename t_tfm_index_type::size_type size_type;
+
+	tfm_index.m_checkpoint_rate = checkpoint_rate;
+	tfm_index.m_checkpoint_pos = sdsl::int_vector<>( checkpoint_rows.size(), 0, sdsl::bits::hi( tfm_index.m_L.size() ) + 1 );
+	tfm_index.m_checkpoint_offset = sdsl::int_vector<>( checkpoint_rows.size(), 0, sdsl::bits::hi( tfm_index.size() ) + 1 );
+	for (size_type j = 0; j < checkpoint_rows.size(); j++) {
+		auto pos = tfm_index.row_to_nav( checkpoint_rows[j] );
+		tfm_index.m_checkpoint_pos[j] = pos.first;
+		tfm_index.m_checkpoint_offset[j] = pos.second;
+	}
+	sdsl::util::bit_compress( tfm_index.m_checkpoint_offset );
+};
 
-	//din
-	tfm_index.m_din = bv_type( std::move( din ) );
-	sdsl::util::init_support( tfm_index.m_din_rank, &tfm_index.m_din );
-	sdsl::util::init_support( tfm_index.m_din_select, &tfm_index.m_din );
+//! function stores every checkpoint_rate-th text position of an already constructed tfm index
+//! as checkpoint, by walking backwards through the whole index
+template<class t_tfm_index_type>
+void construct_tfm_checkpoints( t_tfm_index_type &tfm_index, uint64_t checkpoint_rate ) {
+	typedef typename t_tfm_index_type::size_type size_type;
+	assert( checkpoint_rate > 0 );
+
+	sdsl::int_vector<> checkpoint_rows( (tfm_index.size() - 1) / checkpoint_rate + 1, 0, sdsl::bits::hi( tfm_index.size() ) + 1 );
+	auto pos = tfm_index.end();
+	for (size_type k = tfm_index.size(); k-- > 0; ) {
+		if (k % checkpoint_rate == 0) {
+			checkpoint_rows[k / checkpoint_rate] = tfm_index.nav_to_row( pos );
+		}
+		tfm_index.backwardstep( pos );
+	}
+	construct_tfm_checkpoints( tfm_index, checkpoint_rate, std::move( checkpoint_rows ) );
 };
 
 #endif
@@ -0,0 +1,427 @@
+/*
+ * tfm_index_queries.hpp for BWT Tunneling
+ * Copyright (c) 2020 Uwe Baier All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TFM_INDEX_QUERIES_HPP
+#define TFM_INDEX_QUERIES_HPP
+
+#include <sdsl/int_vector.hpp>
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//! queries of a tunneled fm index, shared by tfm_index and tfm_index_view.
+//! The index t_derived derives from this class and provides its members as
+//! L (with rank, select, inverse_select and access), C, dout, din, row_start, sampled
+//! (with access), their rank and select supports dout_select, din_rank, din_select,
+//! row_start_rank, row_start_select and sampled_rank, samples, checkpoint_pos,
+//! checkpoint_offset, as well as size(), sample_rate() and checkpoint_rate().
+template<class t_derived, class t_value_type>
+class tfm_index_queries {
+public:
+	typedef sdsl::int_vector<>::size_type           size_type;
+	typedef t_value_type                            value_type;
+
+	//first index is next outgoing edge, second index is tunnel entry offset
+	typedef std::pair<size_type,size_type>          nav_type;
+
+	//! number of positions advanced in lock-step by backwardstep_batch
+	static const size_type batch_size = 64;
+
+	//! returns the end, i.e. the position in L where the string ends
+	nav_type end() const {
+		return std::make_pair( (size_type)0, (size_type)0 );
+	}
+
+	//! returns the character preceding the current position
+	value_type preceding_char( const nav_type &pos ) const {
+		return index().L[pos.first];
+	}
+
+	//! Operation performs an backward step from current position.
+	//! function sets posm to the new value and returns the result
+	//! of preceding_char( pos ) before the backward step was performed
+	value_type backwardstep( nav_type &pos ) const {
+		const t_derived &idx = index();
+		size_type &i = pos.first; //create references into position pair
+		size_type &o = pos.second;
+
+		//navigate to next entry
+		auto is = idx.L.inverse_select( i );
+		auto c = is.second;
+		i = idx.C[c] + is.first;
+
+		//check for the start of a tunnel
+		auto din_rank_ip1 = idx.din_rank( i + 1 );
+		if (idx.din[i] == 0) {
+			o = i - idx.din_select( din_rank_ip1 ); //save offset to uppermost entry edge
+		}
+		//navigate to outedges of current node
+		i = idx.dout_select( din_rank_ip1 );
+
+		//check for end of a tunnel
+		if (idx.dout[i+1] == 0) {
+			i += o; //jump back offset
+			o = 0;
+		}
+		return c;
+	}
+
+	//! performs a backward step on k independent positions, and writes the preceding characters to cs
+	//! (if given). Positions are advanced in lock-step phases of batch_size positions, such that the
+	//! memory accesses of different positions overlap instead of stalling one after another.
+	void backwardstep_batch( nav_type *positions, size_type k, value_type *cs = nullptr ) const {
+		const t_derived &idx = index();
+		size_type in[batch_size];
+		size_type node[batch_size];
+		for (size_type b = 0; b < k; b += batch_size) {
+			nav_type *pos = positions + b;
+			size_type m = (k - b < batch_size) ? k - b : batch_size; //no std::min, which would odr-use batch_size
+
+			//navigate to next entries
+			for (size_type j = 0; j < m; j++) {
+				auto is = idx.L.inverse_select( pos[j].first );
+				in[j] = idx.C[is.second] + is.first;
+				if (cs != nullptr) cs[b + j] = is.second;
+				prefetch_bit( idx.din, in[j] );
+			}
+			//check for the start of tunnels and find nodes
+			for (size_type j = 0; j < m; j++) {
+				node[j] = idx.din_rank( in[j] + 1 );
+				if (idx.din[in[j]] == 0) {
+					pos[j].second = in[j] - idx.din_select( node[j] );
+				}
+			}
+			//navigate to outedges of nodes
+			for (size_type j = 0; j < m; j++) {
+				pos[j].first = idx.dout_select( node[j] );
+				prefetch_bit( idx.dout, pos[j].first + 1 );
+			}
+			//check for ends of tunnels
+			for (size_type j = 0; j < m; j++) {
+				if (idx.dout[pos[j].first + 1] == 0) {
+					pos[j].first += pos[j].second;
+					pos[j].second = 0;
+				}
+			}
+		}
+	}
+
+	//! returns the position of the given row of the original (untunneled) BWT,
+	//! rows collapsed by a tunnel are addressed by their offset within the tunnel
+	nav_type row_to_nav( size_type row ) const {
+		size_type i = index().row_start_rank( row + 1 ) - 1;
+		return std::make_pair( i, row - index().row_start_select( i + 1 ) );
+	}
+
+	//! returns the row of the original (untunneled) BWT represented by a position
+	size_type nav_to_row( const nav_type &pos ) const {
+		return index().row_start_select( pos.first + 1 ) + pos.second;
+	}
+
+	//! performs a backward search step with character c on the half-open interval [sp,ep)
+	//! of rows of the original BWT. Function updates the interval and returns its new size,
+	//! in case that no row is preceded by c, sp = ep afterwards.
+	size_type backward_search_step( value_type c, size_type &sp, size_type &ep ) const {
+		nav_type bounds[2];
+		if (!preceding_bounds( c, sp, ep, bounds )) {
+			sp = ep;
+			return 0;
+		}
+		//bounds follow the tunnels like any other position
+		backwardstep( bounds[0] );
+		backwardstep( bounds[1] );
+		sp = nav_to_row( bounds[0] );
+		ep = nav_to_row( bounds[1] ) + 1;
+		return ep - sp;
+	}
+
+	//! searches the pattern [begin,end) backwards, starting with the interval [sp,ep)
+	//! of rows of the original BWT. Function returns the number of occurrences,
+	//! and sets [sp,ep) to the rows prefixed by the pattern.
+	template<class t_pat_iter>
+	size_type backward_search( t_pat_iter begin, t_pat_iter end, size_type &sp, size_type &ep ) const {
+		while (begin != end && sp < ep) {
+			--end;
+			backward_search_step( *end, sp, ep );
+		}
+		return ep - sp;
+	}
+
+	//! returns the number of occurrences of the pattern [begin,end) in the original string
+	template<class t_pat_iter>
+	size_type count( t_pat_iter begin, t_pat_iter end ) const {
+		size_type sp = 0, ep = index().size();
+		return backward_search( begin, end, sp, ep );
+	}
+
+	//! counts the occurrences of several patterns at once, where the j-th pattern is given by
+	//! [patterns[j].first,patterns[j].second). The patterns are searched in lock-step, such that
+	//! the backward steps of all interval bounds are performed using backwardstep_batch.
+	template<class t_pat_iter>
+	std::vector<size_type> count_batch( const std::vector<std::pair<t_pat_iter,t_pat_iter>> &patterns ) const {
+		std::vector<size_type> sp( patterns.size(), 0 ), ep( patterns.size(), index().size() );
+		std::vector<t_pat_iter> end( patterns.size() );
+		std::vector<size_type> active; //patterns that are not completely searched yet
+		for (size_type j = 0; j < patterns.size(); j++) {
+			end[j] = patterns[j].second;
+			if (patterns[j].first != end[j]) active.push_back( j );
+		}
+		std::vector<nav_type> bounds( 2 * active.size() );
+		while (!active.empty()) {
+			//find bounds of all active intervals, and remove patterns that do not occur
+			size_type a = 0;
+			for (auto j : active) {
+				if (preceding_bounds( *--end[j], sp[j], ep[j], &bounds[2*a] )) {
+					active[a++] = j;
+				} else {
+					sp[j] = ep[j];
+				}
+			}
+			active.resize( a );
+			backwardstep_batch( bounds.data(), 2 * a );
+
+			//update intervals, and remove completely searched patterns
+			a = 0;
+			for (size_type b = 0; b < active.size(); b++) {
+				auto j = active[b];
+				sp[j] = nav_to_row( bounds[2*b] );
+				ep[j] = nav_to_row( bounds[2*b+1] ) + 1;
+				if (patterns[j].first != end[j]) active[a++] = j;
+			}
+			active.resize( a );
+		}
+		for (size_type j = 0; j < patterns.size(); j++) {
+			sp[j] = ep[j] - sp[j];
+		}
+		return sp;
+	}
+
+	//! returns the text position of the given row of the original BWT.
+	//! requires sampled text positions, and walks backwards until a sampled row is found.
+	size_type locate_row( size_type row ) const {
+		const t_derived &idx = index();
+		if (idx.sample_rate() == 0) {
+			throw std::logic_error( "tunneled fm index contains no sampled text positions" );
+		}
+		nav_type pos = row_to_nav( row );
+		size_type steps = 0;
+		while (idx.sampled[row] == 0) {
+			backwardstep( pos );
+			row = nav_to_row( pos );
+			steps++;
+		}
+		return idx.samples[idx.sampled_rank( row )] * idx.sample_rate() + steps;
+	}
+
+	//! returns the text positions of all occurrences of the pattern [begin,end) in the original string.
+	//! requires sampled text positions, positions are reported in order of the suffixes starting there.
+	template<class t_pat_iter>
+	std::vector<size_type> locate( t_pat_iter begin, t_pat_iter end ) const {
+		const t_derived &idx = index();
+		size_type sp = 0, ep = idx.size();
+		backward_search( begin, end, sp, ep );
+		std::vector<size_type> occ( ep - sp );
+		if (ep > sp && idx.sample_rate() == 0) {
+			throw std::logic_error( "tunneled fm index contains no sampled text positions" );
+		}
+		//walk backwards from all rows in lock-step, until sampled rows are reached
+		std::vector<nav_type> pos;
+		std::vector<size_type> active; //occurrences whose sample is not found yet
+		for (size_type row = sp; row < ep; row++) {
+			pos.push_back( row_to_nav( row ) );
+			active.push_back( row - sp );
+		}
+		for (size_type steps = 0; !active.empty(); steps++) {
+			size_type a = 0;
+			for (size_type b = 0; b < active.size(); b++) {
+				size_type row = nav_to_row( pos[b] );
+				if (idx.sampled[row] == 1) {
+					occ[active[b]] = idx.samples[idx.sampled_rank( row )] * idx.sample_rate() + steps;
+				} else {
+					pos[a] = pos[b];
+					active[a++] = active[b];
+				}
+			}
+			pos.resize( a );
+			active.resize( a );
+			backwardstep_batch( pos.data(), a );
+		}
+		return occ;
+	}
+
+	//! returns the j-th checkpoint, i.e. the position of text position j * checkpoint_rate()
+	nav_type checkpoint( size_type j ) const {
+		return std::make_pair( (size_type)index().checkpoint_pos[j], (size_type)index().checkpoint_offset[j] );
+	}
+
+	//! returns the first checkpoint at or behind the given text position, together with its text position.
+	//! in case that no checkpoints are stored, the end of the string is returned.
+	std::pair<nav_type,size_type> next_checkpoint( size_type i ) const {
+		const t_derived &idx = index();
+		size_type rate = idx.checkpoint_rate();
+		if (rate > 0) {
+			size_type j = (i + rate - 1) / rate;
+			if (j < idx.checkpoint_pos.size() && j * rate < idx.size() - 1) {
+				return std::make_pair( checkpoint( j ), j * rate );
+			}
+		}
+		return std::make_pair( end(), idx.size() - 1 );
+	}
+
+	//! writes the substring [from,to) of the original string to s, starting from the nearest checkpoint.
+	//! throws std::out_of_range if the range does not lie within the original string.
+	void extract( size_type from, size_type to, char *s ) const {
+		check_range( from, to );
+		auto start = next_checkpoint( to );
+		nav_type pos = start.first;
+		for (size_type i = start.second; i > from; ) {
+			auto c = backwardstep( pos );
+			if (--i < to) {
+				s[i - from] = (char)c;
+			}
+		}
+	}
+
+	//! extracts the substring [from,to) of the original string, starting from the nearest checkpoint.
+	//! throws std::out_of_range if the range does not lie within the original string.
+	std::string extract( size_type from, size_type to ) const {
+		check_range( from, to );
+		std::string s( to - from, '\0' );
+		extract( from, to, &s[0] );
+		return s;
+	}
+
+	//! writes the original string to S, which must provide space for size() - 1 characters.
+	//! the string is split at checkpoints into at most num_threads segments, which are
+	//! inverted in parallel. Without checkpoints, the string is inverted sequentially.
+	void invert( char *S, size_type num_threads = 1 ) const {
+		size_type n = index().size() - 1;
+		if (index().checkpoint_rate() == 0 || num_threads == 0) {
+			num_threads = 1;
+		}
+
+		//segment bounds are checkpoints, so no thread walks further than its segment
+		std::vector<size_type> bounds( 1, 0 );
+		for (size_type t = 1; t < num_threads; t++) {
+			size_type b = next_checkpoint( n / num_threads * t ).second;
+			if (b > bounds.back() && b < n) {
+				bounds.push_back( b );
+			}
+		}
+		bounds.push_back( n );
+
+		std::vector<std::thread> threads;
+		for (size_type t = 1; t + 1 < bounds.size(); t++) {
+			threads.emplace_back( [this,S,&bounds,t]() {
+				invert_segment( bounds[t], bounds[t+1], S );
+			} );
+		}
+		invert_segment( bounds[0], bounds[1], S );
+		for (auto &thread : threads) {
+			thread.join();
+		}
+	}
+
+private:
+	const t_derived &index() const {
+		return static_cast<const t_derived &>( *this );
+	}
+
+	//! throws std::out_of_range if [from,to) is no range of the original string
+	void check_range( size_type from, size_type to ) const {
+		if (from > to || to >= index().size()) {
+			throw std::out_of_range( "extracted range exceeds the original string" );
+		}
+	}
+
+	//! finds the positions of the uppermost and lowermost row within [sp,ep) preceded by c,
+	//! i.e. the positions whose backward steps are the bounds of the next search interval.
+	//! returns false if no row is preceded by c
+	bool preceding_bounds( value_type c, size_type sp, size_type ep, nav_type *bounds ) const {
+		const t_derived &idx = index();
+		if (sp >= ep) {
+			return false;
+		}
+		nav_type &first = bounds[0] = row_to_nav( sp );
+		nav_type &last = bounds[1] = row_to_nav( ep - 1 );
+
+		//find uppermost and lowermost entry of L within the interval preceded by c
+		size_type rank_first = idx.L.rank( first.first, c );
+		size_type rank_last = idx.L.rank( last.first + 1, c );
+		if (rank_first == rank_last) {
+			return false;
+		}
+		if (idx.L[first.first] != c) {
+			first = std::make_pair( idx.L.select( rank_first + 1, c ), (size_type)0 );
+		}
+		if (idx.L[last.first] != c) {
+			size_type i = idx.L.select( rank_last, c );
+			last = std::make_pair( i, idx.row_start_select( i + 2 ) - idx.row_start_select( i + 1 ) - 1 );
+		}
+		return true;
+	}
+
+	//! prefetches the word of a plain bitvector containing bit i
+	static void prefetch_bit( const sdsl::bit_vector &bv, size_type i ) {
+		__builtin_prefetch( bv.data() + (i >> 6) );
+	}
+	//! prefetches bit i of bitvectors providing a prefetch operation (e.g. tfm_fused_nav_bv::bv_view)
+	template<class t_bv>
+	static auto prefetch_bit( const t_bv &bv, size_type i ) -> decltype( bv.prefetch( i ) ) {
+		bv.prefetch( i );
+	}
+	//! does nothing for other bitvectors
+	template<class t_bv>
+	static void prefetch_bit( const t_bv &, ... ) {}
+
+	//! writes the substring [from,to) of the original string to S + from, where from and to are
+	//! text positions of checkpoints (or the end of the string). The segments between consecutive
+	//! checkpoints are inverted in lock-step using backwardstep_batch.
+	void invert_segment( size_type from, size_type to, char *S ) const {
+		size_type rate = index().checkpoint_rate();
+		std::vector<nav_type> pos;
+		std::vector<size_type> ends; //end positions of segments
+		size_type full_to = from;
+		if (rate > 0) {
+			for (size_type i = from + rate; i <= to && i < index().size() - 1; i += rate) {
+				pos.push_back( checkpoint( i / rate ) );
+				ends.push_back( i );
+				full_to = i;
+			}
+		}
+		std::vector<value_type> cs( pos.size() );
+		for (size_type k = 1; k <= rate && !pos.empty(); k++) {
+			backwardstep_batch( pos.data(), pos.size(), cs.data() );
+			for (size_type j = 0; j < pos.size(); j++) {
+				S[ends[j] - k] = (char)cs[j];
+			}
+		}
+		//remainder behind the last checkpoint
+		extract( full_to, to, S + full_to );
+	}
+};
+
+#endif
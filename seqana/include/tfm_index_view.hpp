@@ -0,0 +1,724 @@
+/*
+ * tfm_index_view.hpp for BWT Tunneling
+ * Copyright (c) 2020 Uwe Baier All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TFM_INDEX_VIEW_HPP
+#define TFM_INDEX_VIEW_HPP
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <sdsl/bits.hpp>
+#include <sdsl/int_vector.hpp>
+#include <sdsl/io.hpp>
+#include <sdsl/util.hpp>
+
+#include <fstream>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tfm_index_queries.hpp"
+
+//////////////////////////////////////// MAPPED LAYOUT ////////////////////////////////////////
+// A mapped file consists of 64-bit words. Every structure is written as a sequence of
+// sections, where each section starts at a multiple of 64 bytes, so that structures
+// can be used in place after mapping the file into memory.
+
+//! appends words to a mapped file
+class mapped_writer {
+	std::ostream &m_out;
+	uint64_t m_words = 0;
+public:
+	mapped_writer( std::ostream &out ) : m_out( out ) {}
+
+	void write( uint64_t x ) {
+		m_out.write( (const char *)&x, sizeof(x) );
+		m_words++;
+	}
+	void write( const uint64_t *data, uint64_t n ) {
+		m_out.write( (const char *)data, n * sizeof(uint64_t) );
+		m_words += n;
+	}
+	//! pads the file with zero words up to the next multiple of 64 bytes
+	void align() {
+		while (m_words % 8 != 0) write( 0 );
+	}
+	uint64_t written_bytes() const {
+		return m_words * sizeof(uint64_t);
+	}
+};
+
+//! reads sections of a mapped file in place
+class mapped_reader {
+	const uint64_t *m_pos;
+	const uint64_t *m_end;
+public:
+	mapped_reader( const uint64_t *begin, const uint64_t *end ) : m_pos( begin ), m_end( end ) {}
+
+	//! returns the next n words
+	const uint64_t *take( uint64_t n ) {
+		if (n > (uint64_t)(m_end - m_pos)) {
+			throw std::runtime_error( "mapped file is truncated" );
+		}
+		const uint64_t *p = m_pos;
+		m_pos += n;
+		return p;
+	}
+	uint64_t read() {
+		return *take( 1 );
+	}
+	//! skips padding up to the next multiple of 64 bytes
+	void align() {
+		while (((uintptr_t)m_pos) % 64 != 0 && m_pos < m_end) m_pos++;
+	}
+};
+
+//! mapped bitvector with rank and select support. Rank is answered using absolute counts
+//! of ones in front of every 512-bit block, select using the blocks of every 4096-th one (or zero).
+class mapped_bit_vector {
+public:
+	typedef uint64_t                                size_type;
+	static const size_type block_bits = 512;
+	static const size_type select_sample_rate = 4096;
+
+private:
+	size_type                                       m_size = 0;
+	size_type                                       m_ones = 0;
+	const uint64_t *                                m_words = nullptr;
+	const uint64_t *                                m_rank = nullptr; //ones in front of each block
+	const uint64_t *                                m_select1 = nullptr; //block of every 4096-th one
+	const uint64_t *                                m_select0 = nullptr; //block of every 4096-th zero
+
+	static size_type blocks( size_type n ) {
+		return n / block_bits + 1;
+	}
+	static size_type samples( size_type n ) {
+		return (n + select_sample_rate - 1) / select_sample_rate;
+	}
+	size_type ones_before( size_type b, bool one ) const {
+		return one ? m_rank[b] : b * block_bits - m_rank[b];
+	}
+
+	//! finds the k-th one (or zero) using the sampled blocks
+	size_type select( size_type k, bool one ) const {
+		const uint64_t *sample = one ? m_select1 : m_select0;
+		size_type s = (k - 1) / select_sample_rate;
+		size_type lo = sample[s];
+		size_type hi = (s + 1 < samples( one ? m_ones : m_size - m_ones )) ? sample[s+1] : blocks( m_size ) - 1;
+		while (lo < hi) { //last block with less than k ones in front of it
+			size_type mid = lo + (hi - lo + 1) / 2;
+			if (ones_before( mid, one ) < k)	lo = mid;
+			else					hi = mid - 1;
+		}
+		k -= ones_before( lo, one );
+		size_type w = lo * (block_bits / 64);
+		uint64_t word = one ? m_words[w] : ~m_words[w];
+		for (size_type c = sdsl::bits::cnt( word ); c < k; c = sdsl::bits::cnt( word )) {
+			k -= c;
+			word = one ? m_words[++w] : ~m_words[++w];
+		}
+		return 64 * w + sdsl::bits::sel( word, k );
+	}
+
+public:
+	//! writes a bitvector in mapped layout
+	static void write( mapped_writer &out, const sdsl::bit_vector &bv ) {
+		size_type n = bv.size();
+		size_type words = (n + 63) / 64;
+		std::vector<uint64_t> rank( blocks( n ), 0 );
+		std::vector<uint64_t> select[2];
+		size_type cnt[2] = { 0, 0 };
+		for (size_type b = 0; b < rank.size(); b++) {
+			rank[b] = cnt[1];
+			for (size_type i = b * block_bits; i < std::min( n, (b + 1) * block_bits ); i++) {
+				bool one = bv[i];
+				if (cnt[one] % select_sample_rate == 0) {
+					select[one].push_back( b );
+				}
+				cnt[one]++;
+			}
+		}
+		out.write( n );
+		out.write( cnt[1] );
+		out.align();
+		out.write( bv.data(), words );
+		out.align();
+		out.write( rank.data(), rank.size() );
+		out.align();
+		out.write( select[1].data(), select[1].size() );
+		out.align();
+		out.write( select[0].data(), select[0].size() );
+		out.align();
+	}
+
+	//! maps a bitvector in place
+	void map( mapped_reader &in ) {
+		m_size = in.read();
+		m_ones = in.read();
+		in.align();
+		m_words = in.take( (m_size + 63) / 64 );
+		in.align();
+		m_rank = in.take( blocks( m_size ) );
+		in.align();
+		m_select1 = in.take( samples( m_ones ) );
+		in.align();
+		m_select0 = in.take( samples( m_size - m_ones ) );
+		in.align();
+	}
+
+	size_type size() const {
+		return m_size;
+	}
+
+	uint64_t operator[]( size_type i ) const {
+		return (m_words[i >> 6] >> (i & 63)) & 1ULL;
+	}
+
+	//! prefetches the word containing bit i
+	void prefetch( size_type i ) const {
+		__builtin_prefetch( m_words + (i >> 6) );
+	}
+
+	//! number of ones in [0,i)
+	size_type rank1( size_type i ) const {
+		size_type b = i / block_bits;
+		size_type r = m_rank[b];
+		for (size_type w = b * (block_bits / 64); w < (i >> 6); w++) {
+			r += sdsl::bits::cnt( m_words[w] );
+		}
+		if (i & 63) {
+			r += sdsl::bits::cnt( m_words[i >> 6] & ((1ULL << (i & 63)) - 1) );
+		}
+		return r;
+	}
+
+	//! position of the k-th one (k >= 1)
+	size_type select1( size_type k ) const {
+		return select( k, true );
+	}
+
+	//! position of the k-th zero (k >= 1)
+	size_type select0( size_type k ) const {
+		return select( k, false );
+	}
+};
+
+//! mapped vector of integers of fixed bit width
+class mapped_int_vector {
+public:
+	typedef uint64_t                                size_type;
+
+private:
+	size_type                                       m_size = 0;
+	size_type                                       m_width = 0;
+	const uint64_t *                                m_words = nullptr;
+
+public:
+	//! writes n integers of the given width in mapped layout, where get( i ) returns the i-th integer
+	template<class t_get>
+	static void write( mapped_writer &out, size_type n, size_type width, t_get get ) {
+		out.write( n );
+		out.write( width );
+		out.align();
+		uint64_t word = 0;
+		size_type used = 0; //bits used in word
+		for (size_type i = 0; i < n && width > 0; i++) {
+			uint64_t x = get( i );
+			word |= x << used;
+			if (used + width >= 64) {
+				out.write( word );
+				word = (used > 0 && used + width > 64) ? x >> (64 - used) : 0;
+				used = used + width - 64;
+			} else {
+				used += width;
+			}
+		}
+		if (used > 0) out.write( word );
+		out.align();
+	}
+	static void write( mapped_writer &out, const sdsl::int_vector<> &v ) {
+		write( out, v.size(), v.width(), [&v]( size_type i ) { return (uint64_t)v[i]; } );
+	}
+
+	//! maps a vector in place
+	void map( mapped_reader &in ) {
+		m_size = in.read();
+		m_width = in.read();
+		in.align();
+		m_words = in.take( (m_size * m_width + 63) / 64 );
+		in.align();
+	}
+
+	size_type size() const {
+		return m_size;
+	}
+
+	uint64_t operator[]( size_type i ) const {
+		if (m_width == 0) return 0;
+		size_type p = i * m_width;
+		uint64_t x = m_words[p >> 6] >> (p & 63);
+		if ((p & 63) + m_width > 64) {
+			x |= m_words[(p >> 6) + 1] << (64 - (p & 63));
+		}
+		return (m_width == 64) ? x : x & ((1ULL << m_width) - 1);
+	}
+};
+
+//! mapped elias-fano encoded sparse bitvector, the mapped counterpart of sdsl::sd_vector
+class mapped_sd_vector {
+public:
+	typedef uint64_t                                size_type;
+
+private:
+	size_type                                       m_size = 0;
+	size_type                                       m_ones = 0;
+	size_type                                       m_low_width = 0;
+	mapped_int_vector                               m_low; //lower bits of each one
+	mapped_bit_vector                               m_high; //unary coded upper bits
+
+public:
+	//! writes a sparse bitvector of size n with m ones in mapped layout,
+	//! where get( k ) returns the position of the (k+1)-th one
+	template<class t_get>
+	static void write( mapped_writer &out, size_type n, size_type m, t_get get ) {
+		size_type l = (m > 0 && n / m > 1) ? sdsl::bits::hi( n / m ) : 0;
+		out.write( n );
+		out.write( m );
+		out.write( l );
+		out.align();
+		mapped_int_vector::write( out, m, l, [&]( size_type k ) { return get( k ) & ((1ULL << l) - 1); } );
+		sdsl::bit_vector high( m + (n >> l) + 1, 0 );
+		for (size_type k = 0; k < m; k++) {
+			high[(get( k ) >> l) + k] = 1;
+		}
+		mapped_bit_vector::write( out, high );
+	}
+
+	//! maps a sparse bitvector in place
+	void map( mapped_reader &in ) {
+		m_size = in.read();
+		m_ones = in.read();
+		m_low_width = in.read();
+		in.align();
+		m_low.map( in );
+		m_high.map( in );
+	}
+
+	size_type size() const {
+		return m_size;
+	}
+
+	//! number of ones in [0,i)
+	size_type rank1( size_type i ) const {
+		size_type hi = i >> m_low_width;
+		size_type p = (hi == 0) ? 0 : m_high.select0( hi ) + 1; //first entry of bucket hi
+		size_type k = p - hi;
+		uint64_t lo = i & ((1ULL << m_low_width) - 1);
+		while (k < m_ones && m_high[p] == 1 && m_low[k] < lo) {
+			p++;
+			k++;
+		}
+		return k;
+	}
+
+	//! position of the k-th one (k >= 1)
+	size_type select1( size_type k ) const {
+		return ((m_high.select1( k ) - (k - 1)) << m_low_width) | m_low[k-1];
+	}
+
+	uint64_t operator[]( size_type i ) const {
+		return rank1( i + 1 ) - rank1( i );
+	}
+};
+
+//! mapped wavelet matrix over a byte sequence, supporting the operations of a wavelet tree
+//! needed by a tunneled fm index. Characters are mapped to a compact alphabet first.
+class mapped_wavelet_matrix {
+public:
+	typedef uint64_t                                size_type;
+	typedef unsigned char                           value_type;
+
+private:
+	size_type                                       m_size = 0;
+	size_type                                       m_sigma = 0;
+	size_type                                       m_levels = 0;
+	const uint64_t *                                m_zeros = nullptr; //number of zeros of each level
+	const unsigned char *                           m_comp2char = nullptr;
+	std::vector<mapped_bit_vector>                  m_level;
+	size_type                                       m_char2comp[256];
+	size_type                                       m_start[256]; //first position of each character at the last level
+
+public:
+	//! writes a byte sequence of size n in mapped layout, where get( i ) returns the i-th byte
+	template<class t_get>
+	static void write( mapped_writer &out, size_type n, t_get get ) {
+		//compact alphabet
+		std::vector<size_type> char2comp( 256, 0 );
+		for (size_type i = 0; i < n; i++) {
+			char2comp[get( i )] = 1;
+		}
+		uint64_t comp2char[32] = {};
+		size_type sigma = 0;
+		for (size_type c = 0; c < 256; c++) {
+			if (char2comp[c] == 0) continue;
+			comp2char[sigma / 8] |= (uint64_t)c << (8 * (sigma % 8));
+			char2comp[c] = sigma++;
+		}
+		size_type levels = std::max( (size_type)1, (size_type)(sdsl::bits::hi( std::max( sigma, (size_type)2 ) - 1 ) + 1) );
+
+		//levels are built by stable partitioning of the current sequence
+		sdsl::int_vector<8> seq( n );
+		for (size_type i = 0; i < n; i++) {
+			seq[i] = char2comp[get( i )];
+		}
+		std::vector<sdsl::bit_vector> level( levels );
+		std::vector<uint64_t> zeros( levels, 0 );
+		sdsl::int_vector<8> next( n );
+		for (size_type l = 0; l < levels; l++) {
+			size_type shift = levels - 1 - l;
+			level[l] = sdsl::bit_vector( n, 0 );
+			for (size_type i = 0; i < n; i++) {
+				level[l][i] = (seq[i] >> shift) & 1;
+				zeros[l] += 1 - level[l][i];
+			}
+			size_type z = 0, o = zeros[l];
+			for (size_type i = 0; i < n; i++) {
+				if (level[l][i])	next[o++] = seq[i];
+				else			next[z++] = seq[i];
+			}
+			seq.swap( next );
+		}
+
+		out.write( n );
+		out.write( sigma );
+		out.write( levels );
+		out.align();
+		out.write( zeros.data(), levels );
+		out.align();
+		out.write( comp2char, 32 );
+		out.align();
+		for (size_type l = 0; l < levels; l++) {
+			mapped_bit_vector::write( out, level[l] );
+		}
+	}
+
+	//! maps a wavelet matrix in place
+	void map( mapped_reader &in ) {
+		m_size = in.read();
+		m_sigma = in.read();
+		m_levels = in.read();
+		//a byte alphabet needs at most 8 levels
+		if (m_sigma > 256 || m_levels > 8) {
+			throw std::runtime_error( "corrupt wavelet matrix" );
+		}
+		in.align();
+		m_zeros = in.take( m_levels );
+		in.align();
+		m_comp2char = (const unsigned char *)in.take( 32 );
+		in.align();
+		m_level.assign( m_levels, mapped_bit_vector() );
+		for (size_type l = 0; l < m_levels; l++) {
+			m_level[l].map( in );
+		}
+		//characters not occuring are mapped to sigma
+		for (size_type c = 0; c < 256; c++) {
+			m_char2comp[c] = m_sigma;
+		}
+		for (size_type x = 0; x < m_sigma; x++) {
+			m_char2comp[m_comp2char[x]] = x;
+			size_type p = 0;
+			for (size_type l = 0; l < m_levels; l++) {
+				size_type r = m_level[l].rank1( p );
+				p = ((x >> (m_levels - 1 - l)) & 1) ? m_zeros[l] + r : p - r;
+			}
+			m_start[x] = p;
+		}
+	}
+
+	size_type size() const {
+		return m_size;
+	}
+
+	value_type operator[]( size_type i ) const {
+		return inverse_select( i ).second;
+	}
+
+	//! returns the number of occurrences of c in [0,i)
+	size_type rank( size_type i, value_type c ) const {
+		size_type x = m_char2comp[c];
+		if (x == m_sigma) return 0;
+		for (size_type l = 0; l < m_levels; l++) {
+			size_type r = m_level[l].rank1( i );
+			i = ((x >> (m_levels - 1 - l)) & 1) ? m_zeros[l] + r : i - r;
+		}
+		return i - m_start[x];
+	}
+
+	//! returns the position of the k-th occurrence of c (k >= 1)
+	size_type select( size_type k, value_type c ) const {
+		size_type x = m_char2comp[c];
+		size_type p = m_start[x] + k - 1;
+		for (size_type l = m_levels; l-- > 0; ) {
+			if ((x >> (m_levels - 1 - l)) & 1)	p = m_level[l].select1( p - m_zeros[l] + 1 );
+			else					p = m_level[l].select0( p + 1 );
+		}
+		return p;
+	}
+
+	//! returns the number of occurrences of the i-th character in [0,i), and the character itself
+	std::pair<size_type,value_type> inverse_select( size_type i ) const {
+		size_type x = 0;
+		for (size_type l = 0; l < m_levels; l++) {
+			size_type r = m_level[l].rank1( i );
+			if (m_level[l][i]) {
+				x = (x << 1) | 1;
+				i = m_zeros[l] + r;
+			} else {
+				x = x << 1;
+				i = i - r;
+			}
+		}
+		return std::make_pair( i - m_start[x], m_comp2char[x] );
+	}
+};
+
+//! rank support of a mapped bitvector, called like the rank supports of sdsl
+template<class t_bv>
+class mapped_rank_1 {
+	const t_bv *m_bv;
+public:
+	mapped_rank_1( const t_bv *bv ) : m_bv( bv ) {}
+	uint64_t operator()( uint64_t i ) const {
+		return m_bv->rank1( i );
+	}
+};
+
+//! select support of a mapped bitvector, called like the select supports of sdsl
+template<class t_bv>
+class mapped_select_1 {
+	const t_bv *m_bv;
+public:
+	mapped_select_1( const t_bv *bv ) : m_bv( bv ) {}
+	uint64_t operator()( uint64_t k ) const {
+		return m_bv->select1( k );
+	}
+};
+
+//////////////////////////////////////// INDEX VIEW ////////////////////////////////////////
+
+//! a read-only view on a tunneled fm index stored in mapped layout (see store_to_view_file).
+//! The file is mapped into memory and queries are answered in place, so opening is immediate
+//! and several processes share the same pages of the page cache.
+class tfm_index_view : public tfm_index_queries<tfm_index_view,unsigned char> {
+public:
+	typedef sdsl::int_vector<>::size_type           size_type;
+	typedef unsigned char                           value_type;
+	typedef mapped_wavelet_matrix                   wt_type;
+	typedef mapped_bit_vector                       bit_vector_type;
+	typedef mapped_sd_vector                        row_bv_type;
+	typedef mapped_rank_1<bit_vector_type>          rank_type;
+	typedef mapped_select_1<bit_vector_type>        select_type;
+	typedef mapped_rank_1<row_bv_type>              row_rank_type;
+	typedef mapped_select_1<row_bv_type>            row_select_type;
+
+	//first index is next outgoing edge, second index is tunnel entry offset
+	typedef std::pair<size_type,size_type>          nav_type;
+
+	static const uint64_t magic = 0x31574549564d4654ULL; //"TFMVIEW1"
+
+private:
+	void *                                          m_map = nullptr;
+	size_t                                          m_map_size = 0;
+
+	size_type                                       text_len = 0;
+	size_type                                       m_sample_rate = 0;
+	size_type                                       m_checkpoint_rate = 0;
+	const uint64_t *                                m_C = nullptr;
+	wt_type                                         m_L;
+	bit_vector_type                                 m_dout;
+	bit_vector_type                                 m_din;
+	row_bv_type                                     m_row_start;
+	row_bv_type                                     m_sampled;
+	mapped_int_vector                               m_samples;
+	mapped_int_vector                               m_checkpoint_pos;
+	mapped_int_vector                               m_checkpoint_offset;
+
+public:
+	const wt_type &                                 L = m_L;
+	const uint64_t * const &                        C = m_C;
+	const bit_vector_type &                         dout = m_dout;
+	const rank_type                                 dout_rank{ &m_dout };
+	const select_type                               dout_select{ &m_dout };
+	const bit_vector_type &                         din = m_din;
+	const rank_type                                 din_rank{ &m_din };
+	const select_type                               din_select{ &m_din };
+	const row_bv_type &                             row_start = m_row_start;
+	const row_rank_type                             row_start_rank{ &m_row_start };
+	const row_select_type                           row_start_select{ &m_row_start };
+	const row_bv_type &                             sampled = m_sampled;
+	const row_rank_type                             sampled_rank{ &m_sampled };
+	const mapped_int_vector &                       samples = m_samples;
+	const mapped_int_vector &                       checkpoint_pos = m_checkpoint_pos;
+	const mapped_int_vector &                       checkpoint_offset = m_checkpoint_offset;
+
+	tfm_index_view() {}
+	tfm_index_view( const tfm_index_view & ) = delete;
+	tfm_index_view &operator=( const tfm_index_view & ) = delete;
+	~tfm_index_view() {
+		close();
+	}
+
+	//! maps the given file into memory, returns false if it can not be mapped or is no index view
+	bool open( const std::string &file ) {
+		close();
+		int fd = ::open( file.c_str(), O_RDONLY );
+		if (fd < 0) {
+			return false;
+		}
+		struct stat st;
+		if (fstat( fd, &st ) == 0 && st.st_size > 0) {
+			m_map_size = st.st_size;
+			m_map = mmap( nullptr, m_map_size, PROT_READ, MAP_SHARED, fd, 0 );
+		}
+		::close( fd );
+		if (m_map == MAP_FAILED || m_map == nullptr) {
+			m_map = nullptr;
+			return false;
+		}
+		try {
+			const uint64_t *words = (const uint64_t *)m_map;
+			mapped_reader in( words, words + m_map_size / sizeof(uint64_t) );
+			if (in.read() != magic) {
+				throw std::runtime_error( "no tunneled fm index view" );
+			}
+			text_len = in.read();
+			m_sample_rate = in.read();
+			m_checkpoint_rate = in.read();
+			in.align();
+			m_C = in.take( 257 );
+			in.align();
+			m_L.map( in );
+			m_dout.map( in );
+			m_din.map( in );
+			m_row_start.map( in );
+			m_sampled.map( in );
+			m_samples.map( in );
+			m_checkpoint_pos.map( in );
+			m_checkpoint_offset.map( in );
+		} catch (const std::runtime_error &) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	//! unmaps the file
+	void close() {
+		if (m_map != nullptr) {
+			munmap( m_map, m_map_size );
+			m_map = nullptr;
+			m_map_size = 0;
+		}
+	}
+
+	//! returns the size of the original string
+	size_type size() const {
+		return text_len;
+	}
+
+	//! returns the distance of sampled text positions, zero if the index contains no samples
+	size_type sample_rate() const {
+		return m_sample_rate;
+	}
+
+	//! returns the distance of text positions stored as checkpoints, zero if the index contains no checkpoints
+	size_type checkpoint_rate() const {
+		return m_checkpoint_rate;
+	}
+
+	//! serializes opbject, i.e. writes the mapped file
+	size_type serialize(std::ostream &out, sdsl::structure_tree_node *v, std::string name) const {
+		sdsl::structure_tree_node *child =
+			sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+		out.write( (const char *)m_map, m_map_size );
+		sdsl::structure_tree::add_size(child, m_map_size);
+		return m_map_size;
+	}
+};
+
+//! stores a tunneled fm index in mapped layout, such that it can be opened with tfm_index_view
+template<class t_tfm_index_type>
+void store_to_view_file( const t_tfm_index_type &tfm, std::ostream &os ) {
+	typedef typename t_tfm_index_type::size_type size_type;
+	mapped_writer out( os );
+	out.write( tfm_index_view::magic );
+	out.write( tfm.size() );
+	out.write( tfm.sample_rate() );
+	out.write( tfm.checkpoint_rate() );
+	out.align();
+	for (size_type c = 0; c < 257; c++) {
+		out.write( c < tfm.C.size() ? tfm.C[c] : tfm.L.size() );
+	}
+	out.align();
+	mapped_wavelet_matrix::write( out, tfm.L.size(), [&tfm]( size_type i ) { return (unsigned char)tfm.L[i]; } );
+
+	{
+		sdsl::bit_vector dout( tfm.dout.size(), 0 );
+		for (size_type i = 0; i < dout.size(); i++) dout[i] = tfm.dout[i];
+		mapped_bit_vector::write( out, dout );
+	}
+	{
+		sdsl::bit_vector din( tfm.din.size(), 0 );
+		for (size_type i = 0; i < din.size(); i++) din[i] = tfm.din[i];
+		mapped_bit_vector::write( out, din );
+	}
+
+	mapped_sd_vector::write( out, tfm.row_start.size(), tfm.L.size() + 1,
+		[&tfm]( size_type k ) { return (uint64_t)tfm.row_start_select( k + 1 ); } );
+	std::vector<uint64_t> sampled_rows;
+	for (size_type row = 0; row < tfm.sampled.size(); row++) {
+		if (tfm.sampled[row]) sampled_rows.push_back( row );
+	}
+	mapped_sd_vector::write( out, tfm.sampled.size(), sampled_rows.size(),
+		[&sampled_rows]( size_type k ) { return sampled_rows[k]; } );
+	mapped_int_vector::write( out, tfm.samples );
+	mapped_int_vector::write( out, tfm.checkpoint_pos );
+	mapped_int_vector::write( out, tfm.checkpoint_offset );
+}
+
+//! stores a tunneled fm index in mapped layout to the given file, returns false on failure
+template<class t_tfm_index_type>
+bool store_to_view_file( const t_tfm_index_type &tfm, const std::string &file ) {
+	std::ofstream out( file, std::ios::binary | std::ios::trunc );
+	if (!out) {
+		return false;
+	}
+	store_to_view_file( tfm, out );
+	return (bool)out;
+}
+
+#endif
@@ -0,0 +1,308 @@
+/*
+ * tfm_nav_bitvectors.hpp for BWT Tunneling
+ * Copyright (c) 2020 Uwe Baier All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TFM_NAV_BITVECTORS_HPP
+#define TFM_NAV_BITVECTORS_HPP
+
+#include <sdsl/bits.hpp>
+#include <sdsl/int_vector.hpp>
+#include <sdsl/io.hpp>
+#include <sdsl/util.hpp>
+
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <utility>
+
+//! bundle of the navigation bitvectors dout and din of a tunneled fm index,
+//! stored as separate bitvectors with separate rank and select supports
+template<class t_bv_type, class t_rank_type, class t_select_type>
+class tfm_nav_bitvectors {
+public:
+	typedef sdsl::int_vector<>::size_type           size_type;
+	typedef t_bv_type                               bv_type;
+	typedef t_rank_type                             rank_type;
+	typedef t_select_type                           select_type;
+
+private:
+	bv_type                                         m_dout;
+	rank_type                                       m_dout_rank;
+	select_type                                     m_dout_select;
+	bv_type                                         m_din;
+	rank_type                                       m_din_rank;
+	select_type                                     m_din_select;
+
+public:
+	const bv_type &                                 dout = m_dout;
+	const rank_type &                               dout_rank = m_dout_rank;
+	const select_type &                             dout_select = m_dout_select;
+	const bv_type &                                 din = m_din;
+	const rank_type &                               din_rank = m_din_rank;
+	const select_type &                             din_select = m_din_select;
+
+	//! initializes the bundle with the given bitvectors
+	void init( sdsl::bit_vector &&dout, sdsl::bit_vector &&din ) {
+		m_dout = bv_type( std::move( dout ) );
+		sdsl::util::init_support( m_dout_rank, &m_dout );
+		sdsl::util::init_support( m_dout_select, &m_dout );
+
+		m_din = bv_type( std::move( din ) );
+		sdsl::util::init_support( m_din_rank, &m_din );
+		sdsl::util::init_support( m_din_select, &m_din );
+	}
+
+	//! serializes opbject
+	size_type serialize(std::ostream &out, sdsl::structure_tree_node *v, std::string name) const {
+		sdsl::structure_tree_node *child =
+			sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+		size_type written_bytes = 0;
+		written_bytes += m_dout.serialize(out, child, "dout");
+		written_bytes += m_dout_rank.serialize(out, child, "dout_rank");
+		written_bytes += m_dout_select.serialize(out, child, "dout_select");
+
+		written_bytes += m_din.serialize(out, child, "din");
+		written_bytes += m_din_rank.serialize(out, child, "din_rank");
+		written_bytes += m_din_select.serialize(out, child, "din_select");
+
+		sdsl::structure_tree::add_size(child, written_bytes);
+		return written_bytes;
+	}
+
+	//! loads a serialized object
+	void load(std::istream &in) {
+		m_dout.load(in);
+		m_dout_rank.load(in, &m_dout);
+		m_dout_select.load(in, &m_dout);
+
+		m_din.load(in);
+		m_din_rank.load(in, &m_din);
+		m_din_select.load(in, &m_din);
+	}
+};
+
+//! bundle of the navigation bitvectors dout and din of a tunneled fm index, where both
+//! bitvectors are interleaved with their rank samples in cache line sized blocks.
+//! Each block consists of 8 words: the number of ones of dout and din before the block,
+//! followed by 192 bits of dout and 192 bits of din. Hence, accessing and ranking both
+//! bitvectors touches a single cache line, select is answered using sampled blocks.
+//! Use it as bitvector type of a tunneled fm index, i.e. tfm_index<t_wt_type,tfm_fused_nav_bv>
+class tfm_fused_nav_bv {
+public:
+	typedef sdsl::int_vector<>::size_type           size_type;
+
+	static const size_type block_bits = 192; //bits of each bitvector per block
+	static const size_type block_words = 8;
+	static const size_type select_sample_rate = 512; //every 512th one is sampled for select
+
+	//! view on one of the bundled bitvectors, part 0 is dout, part 1 is din
+	class bv_view {
+		const tfm_fused_nav_bv *m_nav;
+		size_type m_part;
+	public:
+		bv_view( const tfm_fused_nav_bv *nav, size_type part ) : m_nav( nav ), m_part( part ) {}
+		uint64_t operator[]( size_type i ) const {
+			return m_nav->access( m_part, i );
+		}
+		size_type size() const {
+			return m_nav->m_size;
+		}
+		//! prefetches the block containing bit i
+		void prefetch( size_type i ) const {
+			__builtin_prefetch( m_nav->m_data + (i / block_bits) * block_words );
+		}
+	};
+	class rank_view {
+		const tfm_fused_nav_bv *m_nav;
+		size_type m_part;
+	public:
+		rank_view( const tfm_fused_nav_bv *nav, size_type part ) : m_nav( nav ), m_part( part ) {}
+		size_type operator()( size_type i ) const {
+			return m_nav->rank( m_part, i );
+		}
+	};
+	class select_view {
+		const tfm_fused_nav_bv *m_nav;
+		size_type m_part;
+	public:
+		select_view( const tfm_fused_nav_bv *nav, size_type part ) : m_nav( nav ), m_part( part ) {}
+		size_type operator()( size_type k ) const {
+			return m_nav->select( m_part, k );
+		}
+	};
+
+	typedef bv_view                                 bv_type;
+	typedef rank_view                               rank_type;
+	typedef select_view                             select_type;
+	typedef rank_view                               rank_1_type;
+	typedef select_view                             select_1_type;
+
+private:
+	size_type                                       m_size = 0; //size of each bitvector
+	size_type                                       m_blocks = 0;
+	sdsl::int_vector<64>                            m_buf; //blocks, with some slack for alignment
+	uint64_t *                                      m_data = nullptr; //first block, aligned to 64 bytes
+	sdsl::int_vector<>                              m_select_samples[2];
+
+	//! allocates space for the given number of blocks, such that the first block is aligned
+	void allocate( size_type blocks ) {
+		m_blocks = blocks;
+		m_buf = sdsl::int_vector<64>( blocks * block_words + block_words, 0 );
+		uintptr_t addr = (uintptr_t)m_buf.data();
+		m_data = m_buf.data() + ((64 - addr % 64) % 64) / sizeof(uint64_t);
+	}
+
+	uint64_t access( size_type part, size_type i ) const {
+		size_type o = i % block_bits;
+		const uint64_t *w = m_data + (i / block_bits) * block_words + 2 + 3 * part;
+		return (w[o >> 6] >> (o & 63)) & 1ULL;
+	}
+
+	size_type rank( size_type part, size_type i ) const {
+		size_type o = i % block_bits;
+		const uint64_t *b = m_data + (i / block_bits) * block_words;
+		const uint64_t *w = b + 2 + 3 * part;
+		size_type r = b[part];
+		for (size_type k = 0; k < (o >> 6); k++) {
+			r += sdsl::bits::cnt( w[k] );
+		}
+		if (o & 63) {
+			r += sdsl::bits::cnt( w[o >> 6] & ((1ULL << (o & 63)) - 1) );
+		}
+		return r;
+	}
+
+	size_type select( size_type part, size_type k ) const {
+		//binary search for the last block with less than k ones in front of it
+		size_type s = (k - 1) / select_sample_rate;
+		size_type lo = m_select_samples[part][s];
+		size_type hi = (s + 1 < m_select_samples[part].size()) ? m_select_samples[part][s+1] : m_blocks - 1;
+		while (lo < hi) {
+			size_type mid = lo + (hi - lo + 1) / 2;
+			if (m_data[mid * block_words + part] < k)	lo = mid;
+			else						hi = mid - 1;
+		}
+		//scan the words of the block
+		k -= m_data[lo * block_words + part];
+		const uint64_t *w = m_data + lo * block_words + 2 + 3 * part;
+		size_type j = 0;
+		for (size_type c = sdsl::bits::cnt( w[j] ); c < k; c = sdsl::bits::cnt( w[++j] )) {
+			k -= c;
+		}
+		return lo * block_bits + 64 * j + sdsl::bits::sel( w[j], k );
+	}
+
+	//! samples the blocks containing every select_sample_rate-th one of the given part
+	void init_select_samples( size_type part ) {
+		size_type ones = rank( part, m_size );
+		m_select_samples[part] = sdsl::int_vector<>( (ones + select_sample_rate - 1) / select_sample_rate, 0,
+		                                             sdsl::bits::hi( m_blocks ) + 1 );
+		for (size_type b = 0, s = 0; b < m_blocks && s < m_select_samples[part].size(); b++) {
+			//ones in front of the next block
+			size_type next = (b + 1 < m_blocks) ? m_data[(b + 1) * block_words + part] : ones;
+			while (s < m_select_samples[part].size() && s * select_sample_rate < next) {
+				m_select_samples[part][s++] = b;
+			}
+		}
+	}
+
+public:
+	const bv_view                                   dout{ this, 0 };
+	const rank_view                                 dout_rank{ this, 0 };
+	const select_view                               dout_select{ this, 0 };
+	const bv_view                                   din{ this, 1 };
+	const rank_view                                 din_rank{ this, 1 };
+	const select_view                               din_select{ this, 1 };
+
+	tfm_fused_nav_bv() {}
+	tfm_fused_nav_bv( const tfm_fused_nav_bv & ) = delete;
+	tfm_fused_nav_bv &operator=( const tfm_fused_nav_bv & ) = delete;
+
+	//! initializes the bundle with the given bitvectors, which must be of equal size
+	void init( sdsl::bit_vector &&dout, sdsl::bit_vector &&din ) {
+		if (dout.size() != din.size()) {
+			throw std::invalid_argument( "dout and din must be of equal size" );
+		}
+		m_size = dout.size();
+		allocate( m_size / block_bits + 1 );
+		const sdsl::bit_vector *bv[2] = { &dout, &din };
+		size_type ones[2] = { 0, 0 };
+		for (size_type b = 0; b < m_blocks; b++) {
+			uint64_t *block = m_data + b * block_words;
+			for (size_type part = 0; part < 2; part++) {
+				block[part] = ones[part];
+				for (size_type k = 0; k < 3; k++) {
+					size_type i = b * block_bits + 64 * k;
+					uint64_t w = 0;
+					if (i < m_size) {
+						w = bv[part]->get_int( i, std::min( (size_type)64, m_size - i ) );
+					}
+					block[2 + 3 * part + k] = w;
+					ones[part] += sdsl::bits::cnt( w );
+				}
+			}
+		}
+		sdsl::bit_vector().swap( dout );
+		sdsl::bit_vector().swap( din );
+		init_select_samples( 0 );
+		init_select_samples( 1 );
+	}
+
+	//! serializes opbject
+	size_type serialize(std::ostream &out, sdsl::structure_tree_node *v, std::string name) const {
+		sdsl::structure_tree_node *child =
+			sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+		size_type written_bytes = 0;
+		written_bytes += sdsl::write_member(m_size, out, child, "size");
+		written_bytes += sdsl::write_member(m_blocks, out, child, "blocks");
+		out.write( (const char *)m_data, m_blocks * block_words * sizeof(uint64_t) );
+		written_bytes += m_blocks * block_words * sizeof(uint64_t);
+		written_bytes += m_select_samples[0].serialize(out, child, "dout_select_samples");
+		written_bytes += m_select_samples[1].serialize(out, child, "din_select_samples");
+		sdsl::structure_tree::add_size(child, written_bytes);
+		return written_bytes;
+	}
+
+	//! loads a serialized object
+	void load(std::istream &in) {
+		size_type blocks;
+		sdsl::read_member( m_size, in );
+		sdsl::read_member( blocks, in );
+		allocate( blocks );
+		in.read( (char *)m_data, m_blocks * block_words * sizeof(uint64_t) );
+		m_select_samples[0].load(in);
+		m_select_samples[1].load(in);
+	}
+};
+
+//! selects the bundle of navigation bitvectors for the bitvector configuration of a tunneled fm index
+template<class t_bv_type, class t_rank_type, class t_select_type>
+struct tfm_nav_bundle {
+	typedef tfm_nav_bitvectors<t_bv_type,t_rank_type,t_select_type> type;
+};
+
+template<class t_rank_type, class t_select_type>
+struct tfm_nav_bundle<tfm_fused_nav_bv,t_rank_type,t_select_type> {
+	typedef tfm_fused_nav_bv type;
+};
+
+#endif
@@ -0,0 +1,205 @@
+/*
+ * tfm_count.cpp for BWT Tunneling
+ * Copyright (c) 2020 Uwe Baier All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <string.h>
+#include <utility>
+#include <vector>
+
+#include <sdsl/memory_management.hpp>
+
+#include "rle_wt.hpp"
+#include "tfm_index.hpp"
+#include "tfm_index_view.hpp"
+
+using namespace std;
+using namespace sdsl;
+
+void printUsage( char **argv ) {
+	cerr << "USAGE: " << argv[0] << " [OPTIONS] TFMFILE" << endl;
+	cerr << "DESCRIPTION: Program counts (or locates) the occurrences of newline-separated patterns read from stdin" << endl;
+	cerr << "  Output is written to stdout and consists of one line per pattern," << endl;
+	cerr << "  containing the number of occurrences of the pattern in the indexed string." << endl;
+	cerr << "OPTIONS:" << endl;
+	cerr << "  -l\tLocate occurrences, i.e. print the text positions of all occurrences" << endl;
+	cerr << "    \tafter the number of occurrences (requires an index with sampled text positions)" << endl;
+	cerr << "  -m\tTFMFILE is an index in mapped layout (see tfm_index_view.x), which is used without loading it" << endl;
+	cerr << "  -i\tEnable informative mode, printing memory peak (in bytes) and" << endl;
+	cerr << "    \tsearch timing (in milliseconds) during search" << endl;
+	cerr << "TFMFILE: a file containing a serialized tunneled fm index" << endl;
+};
+
+//little hack to get extra information from memory managemant
+const format_type leet_format = (format_type)1337;
+namespace sdsl {
+	template<>
+	void write_mem_log<leet_format>(ostream& out,const memory_monitor& m) {
+
+		//get all memory events
+		auto events = m.completed_events;
+		std::sort( events.begin(), events.end() );
+		auto e = events.begin();
+
+		//scan for timing
+		int64_t mem_peak = 0;
+		auto start = m.start_log;
+		auto end = start;
+		while (e != events.end()) {
+			for (auto alloc : e->allocations) {
+				mem_peak = std::max(mem_peak, alloc.usage);
+				end = alloc.timestamp;
+			}
+			++e;
+		}
+
+		//print results
+		out << "count_mem_peak\t" << mem_peak << endl;
+		out << "count_time\t" << chrono::duration_cast<chrono::milliseconds>(end-start).count() << endl;
+	};
+};
+
+//! loads a serialized index, or maps an index in mapped layout
+template<class t_tfm_index>
+bool load_index( t_tfm_index &tfm, const string &file ) {
+	return load_from_file( tfm, file );
+}
+bool load_index( tfm_index_view &tfm, const string &file ) {
+	return tfm.open( file );
+}
+
+//! counts (or locates) the patterns read from stdin using a tunneled fm index of the given type
+template<class t_tfm_index>
+int count_patterns( const string &tfmfile, bool locate, bool informative ) {
+	t_tfm_index tfm;
+	size_t num_patterns = 0; //number of processed patterns
+	size_t occ = 0; //total number of occurrences
+	memory_monitor::start();
+	{
+		auto event = memory_monitor::event("COUNT");
+		if (!load_index( tfm, tfmfile )) {
+			cerr << "Unable to open file " << tfmfile << endl;
+			return 1;
+		}
+		if (locate && tfm.sample_rate() == 0) {
+			cerr << "Index " << tfmfile << " contains no sampled text positions, unable to locate" << endl;
+			return 1;
+		}
+
+		//process patterns line by line, counting is done in batches of patterns
+		const size_t batch = 1024;
+		vector<string> patterns;
+		vector<pair<string::const_iterator,string::const_iterator>> ranges;
+		string pattern;
+		while (cin) {
+			patterns.clear();
+			while (patterns.size() < batch && getline( cin, pattern )) {
+				patterns.push_back( pattern );
+			}
+			if (locate) {
+				for (const auto &pattern : patterns) {
+					auto pos = tfm.locate( pattern.begin(), pattern.end() );
+					std::sort( pos.begin(), pos.end() );
+					cout << pos.size();
+					for (auto p : pos) {
+						cout << "\t" << p;
+					}
+					cout << "\n";
+					occ += pos.size();
+				}
+			} else {
+				ranges.clear();
+				for (const auto &pattern : patterns) {
+					ranges.emplace_back( pattern.begin(), pattern.end() );
+				}
+				for (auto cnt : tfm.count_batch( ranges )) {
+					cout << cnt << "\n";
+					occ += cnt;
+				}
+			}
+			num_patterns += patterns.size();
+		}
+		cout.flush();
+	}
+	memory_monitor::stop();
+
+	if (informative) { //output further information
+		cout << "input_length\t" << tfm.size() << endl;
+		cout << "tfm_length\t" << tfm.L.size() << endl;
+		cout << "tfm_index_size\t" << size_in_bytes( tfm ) << endl;
+		cout << "num_patterns\t" << num_patterns << endl;
+		cout << "num_occurrences\t" << occ << endl;
+
+		memory_monitor::write_memory_log<leet_format>(cout);
+	}
+	return 0;
+}
+
+int main( int argc, char **argv ) {
+	//check arguments
+	bool informative = false;
+	bool locate = false;
+	bool mapped = false;
+	string tfmfile;
+
+	if (argc < 2) {
+		printUsage( argv );
+		return 1;
+	}
+	for (int i = 1; i < argc - 1; i++) {
+		if (argv[i] == string("-i")) {
+			informative = true;
+		}
+		else if (argv[i] == string("-m")) {
+			mapped = true;
+		}
+		else if (argv[i] == string("-l")) {
+			locate = true;
+		}
+		else {
+			printUsage( argv );
+			cerr << "Unknown option " << argv[i] << endl;
+			return 1;
+		}
+	}
+	tfmfile = argv[argc-1];
+
+	if (mapped) {
+		return count_patterns<tfm_index_view>( tfmfile, locate, informative );
+	}
+	//choose the representation of L stored in the index
+	uint64_t flags;
+	if (!load_tfm_format_flags( tfmfile, flags )) {
+		cerr << "Unable to open file " << tfmfile << endl;
+		return 1;
+	}
+	if (flags & tfm_format_fused_nav) {
+		cerr << "Index " << tfmfile << " uses fused navigation bitvectors, which are not supported" << endl;
+		return 1;
+	}
+	if (flags & tfm_format_rle_L) {
+		return count_patterns<tfm_index<rle_wt<>>>( tfmfile, locate, informative );
+	}
+	return count_patterns<tfm_index<>>( tfmfile, locate, informative );
+}
@@ -28,12 +28,15 @@
 
 #include <iostream>
 #include <map>
+#include <stdlib.h>
 #include <deque>
 #include <utility>
 #include <vector>
+#include <thread>
 
 #include <sdsl/util.hpp>
 
+#include "rle_wt.hpp"
 #include "tfm_index.hpp"
 
 using namespace std;
@@ -47,6 +50,17 @@ void printUsage( char **argv ) {
 	cerr << "  -sa\tChoose suffix array construction algorithm. Must be followed by one of:" << endl;
 	cerr << "     \tDIVSUFSORT   use divsufsort (fast but memory-intensive)" << endl;
 	cerr << "     \tSE_SAIS         use a semi-external algorithm (slower but lower mem peak)" << endl;
+	cerr << "  -s\tSample every RATE-th text position to support locate queries. Must be followed by RATE," << endl;
+	cerr << "    \tby default no text positions are sampled" << endl;
+	cerr << "  -c\tStore every RATE-th text position as checkpoint to speed up extraction. Must be followed by RATE," << endl;
+	cerr << "    \tby default no checkpoints are stored" << endl;
+	cerr << "  -b\tChoose where L is buffered during construction. Must be followed by one of:" << endl;
+	cerr << "    \tAUTO     in memory if it fits into half of the available memory, streamed otherwise (default)" << endl;
+	cerr << "    \tMEMORY   in memory, without accessing the disk" << endl;
+	cerr << "    \tSTREAM   streamed through a file in the current directory, saving memory" << endl;
+	cerr << "  -r\tStore L run-length encoded, which is favorable for highly repetitive inputs" << endl;
+	cerr << "  -t\tUse at most THREADS threads to find the minimal edge-reduced de Bruijn graph." << endl;
+	cerr << "    \tMust be followed by THREADS, by default all available hardware threads are used" << endl;
 	cerr << "INFILE:" << endl;
 	cerr << "  File to construct tunneled FM index from, nullbytes are permitted" << endl;
 	cerr << "TFMOUTFILE:" << endl;
@@ -114,10 +128,60 @@ namespace sdsl {
 	};
 };
 
+//! constructs a tunneled fm index of the given type and stores it to outfile
+template<class t_tfm_index>
+int construct_index( const string &infile, const string &outfile, uint64_t sample_rate, uint64_t checkpoint_rate,
+                     tfm_buffer_mode buffer_mode, uint64_t num_threads, bool informative ) {
+	//construct tunneled fm index
+	int64_t fm_size, tfm_size, tfm_sample_size, tfm_checkpoint_size;
+	int64_t min_k, min_edges;
+	t_tfm_index tfm;
+	memory_monitor::start();
+	{
+		cache_config config(true, "./", util::basename(infile) );
+		csa_wt<sdsl::wt_blcd<>,0xFFFFFFFF,0xFFFFFFFF> csa;
+		construct( csa, infile, config, 1 );
+		fm_size = size_in_bytes( csa );
+		auto res = construct_tfm_index( tfm, move( csa ), config, sample_rate, checkpoint_rate, buffer_mode, num_threads );
+		tfm_size = size_in_bytes( tfm );
+		tfm_sample_size = size_in_bytes( tfm.sampled ) + size_in_bytes( tfm.sampled_rank ) + size_in_bytes( tfm.samples );
+		tfm_checkpoint_size = size_in_bytes( tfm.checkpoint_pos ) + size_in_bytes( tfm.checkpoint_offset );
+		min_k = res.first;
+		min_edges = res.second;
+	}
+	memory_monitor::stop();
+	
+	//print infos if wanted
+	if (informative) {
+		//print additional information
+		cout << "input_length\t" << tfm.size() << endl;
+		cout << "tfm_length\t" << tfm.L.size() << endl;
+		
+		cout << "fm_index_size\t" << fm_size << endl;
+		cout << "tfm_index_size\t" << tfm_size << endl;
+		cout << "tfm_sample_size\t" << tfm_sample_size << endl;
+		cout << "tfm_checkpoint_size\t" << tfm_checkpoint_size << endl;
+
+		cout << "min_dbg_k\t" << min_k << endl;
+		cout << "min_dbg_edges\t" << min_edges << endl;
+
+		memory_monitor::write_memory_log<leet_format>(cout);
+	}
+
+	//serialize result
+	store_to_file(tfm, outfile);
+	return 0;
+}
+
 int main(int argc, char **argv) {
 	//set default configuration
 	construct_config::byte_algo_sa = LIBDIVSUFSORT;
 	bool informative = false; //informative mode
+	bool rle = false; //run-length encoded L
+	uint64_t sample_rate = 0; //distance of sampled text positions
+	uint64_t checkpoint_rate = 0; //distance of checkpoints
+	tfm_buffer_mode buffer_mode = tfm_buffer_mode::automatic; //buffer of L
+	uint64_t num_threads = max( thread::hardware_concurrency(), 1u ); //threads of edge minimization
 	string infile = "Makefile";
 	string outfile = "Makefile.tfm";
 
@@ -127,7 +191,7 @@ int main(int argc, char **argv) {
 		cerr << "At least 2 parameters expected" << endl;
 		return 1;
 	}
-	enum { SA, IN, NO } last_option; //enumeration for last option
+	enum { SA, SR, CR, BM, TH, IN, NO } last_option; //enumeration for last option
 	last_option = NO;
 	for (int i = 1; i < argc - 2; i++) { //analyze options
 		switch (last_option) {
@@ -137,9 +201,25 @@ int main(int argc, char **argv) {
 				last_option = IN;
 				informative = true;
 			}
+			else if (strcmp(argv[i], "-r") == 0) {
+				last_option = IN;
+				rle = true;
+			}
 			else if (strcmp(argv[i], "-sa") == 0) {
 				last_option = SA;
 			}
+			else if (strcmp(argv[i], "-s") == 0) {
+				last_option = SR;
+			}
+			else if (strcmp(argv[i], "-c") == 0) {
+				last_option = CR;
+			}
+			else if (strcmp(argv[i], "-b") == 0) {
+				last_option = BM;
+			}
+			else if (strcmp(argv[i], "-t") == 0) {
+				last_option = TH;
+			}
 			else {
 				printUsage(argv);
 				cerr << "Unknown option " << argv[i] << endl;
@@ -160,44 +240,57 @@ int main(int argc, char **argv) {
 			}
 			last_option = NO;
 			break;
+		case SR: //choose sample rate
+			sample_rate = strtoull( argv[i], nullptr, 10 );
+			if (sample_rate == 0) {
+				printUsage( argv );
+				cerr << "Invalid sample rate " << argv[i] << endl;
+				return 1;
+			}
+			last_option = NO;
+			break;
+		case BM: //choose buffer of L
+			if (strcmp(argv[i], "AUTO") == 0) {
+				buffer_mode = tfm_buffer_mode::automatic;
+			}
+			else if (strcmp(argv[i], "MEMORY") == 0) {
+				buffer_mode = tfm_buffer_mode::memory;
+			}
+			else if (strcmp(argv[i], "STREAM") == 0) {
+				buffer_mode = tfm_buffer_mode::stream;
+			}
+			else {
+				printUsage( argv );
+				cerr << "Unknown buffer mode " << argv[i] << endl;
+				return 1;
+			}
+			last_option = NO;
+			break;
+		case TH: //choose number of threads
+			num_threads = strtoull( argv[i], nullptr, 10 );
+			if (num_threads == 0) {
+				printUsage( argv );
+				cerr << "Invalid number of threads " << argv[i] << endl;
+				return 1;
+			}
+			last_option = NO;
+			break;
+		case CR: //choose checkpoint rate
+			checkpoint_rate = strtoull( argv[i], nullptr, 10 );
+			if (checkpoint_rate == 0) {
+				printUsage( argv );
+				cerr << "Invalid checkpoint rate " << argv[i] << endl;
+				return 1;
+			}
+			last_option = NO;
+			break;
 		}
 	}
 	infile = argv[argc-2];
 	outfile = argv[argc-1];
 
-	//construct tunneled fm index
-	int64_t fm_size, tfm_size;
-	int64_t min_k, min_edges;
-	tfm_index<> tfm;
-	memory_monitor::start();
-	{
-		cache_config config(true, "./", util::basename(infile) );
-		csa_wt<sdsl::wt_blcd<>,0xFFFFFFFF,0xFFFFFFFF> csa;
-		construct( csa, infile, config, 1 );
-		fm_size = size_in_bytes( csa );
-		auto res = construct_tfm_index( tfm, move( csa ), config );
-		tfm_size = size_in_bytes( tfm );
-		min_k = res.first;
-		min_edges = res.second;
+	if (rle) {
+		return construct_index<tfm_index<rle_wt<>>>( infile, outfile, sample_rate, checkpoint_rate, buffer_mode, num_threads, informative );
 	}
-	memory_monitor::stop();
-	
-	//print infos if wanted
-	if (informative) {
-		//print additional information
-		cout << "input_length\t" << tfm.size() << endl;
-		cout << "tfm_length\t" << tfm.L.size() << endl;
-		
-		cout << "fm_index_size\t" << fm_size << endl;
-		cout << "tfm_index_size\t" << tfm_size << endl;
-
-		cout << "min_dbg_k\t" << min_k << endl;
-		cout << "min_dbg_edges\t" << min_edges << endl;
-
-		memory_monitor::write_memory_log<leet_format>(cout);
-	}
-
-	//serialize result
-	store_to_file(tfm, outfile);
-	return 0;
+	return construct_index<tfm_index<>>( infile, outfile, sample_rate, checkpoint_rate, buffer_mode, num_threads, informative );
 }
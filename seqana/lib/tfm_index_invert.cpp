@@ -24,10 +24,16 @@
 #include <iostream>
 #include <map>
 #include <deque>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
 #include <utility>
 #include <vector>
 
+#include "rle_wt.hpp"
 #include "tfm_index.hpp"
+#include "tfm_index_view.hpp"
 
 using namespace std;
 using namespace sdsl;
@@ -35,33 +41,94 @@ using namespace sdsl;
 typedef typename sdsl::int_vector<>::size_type size_type;
 
 void printUsage( char **argv ) {
-	cerr << "USAGE: " << argv[0] << " TFMFILE" << endl;
+	cerr << "USAGE: " << argv[0] << " [OPTIONS] TFMFILE" << endl;
+	cerr << "OPTIONS:" << endl;
+	cerr << "  -t\tNumber of threads used for inversion, must be followed by a number." << endl;
+	cerr << "    \tDefaults to the number of available cores. Inversion is split at the checkpoints" << endl;
+	cerr << "    \tof the index (see option -c of tfm_index_construct.x), without checkpoints" << endl;
+	cerr << "    \tthe string is inverted sequentially" << endl;
+	cerr << "  -m\tTFMFILE is an index in mapped layout (see tfm_index_view.x), which is used without loading it" << endl;
 	cerr << "TFMFILE:" << endl;
 	cerr << "  File where to store the serialized trie" << endl;
 };
 
-int main(int argc, char **argv) {
-	//check parameters
-	if (argc != 2) {
-		printUsage( argv );
-		cerr << "At least 1 parameter expected" << endl;
+//! loads a serialized index, or maps an index in mapped layout
+template<class t_tfm_index>
+bool load_index( t_tfm_index &tfm, const string &file ) {
+	return load_from_file( tfm, file );
+}
+bool load_index( tfm_index_view &tfm, const string &file ) {
+	return tfm.open( file );
+}
+
+//! inverts the given tunneled fm index and writes the original string to stdout
+template<class t_tfm_index>
+int invert_index( const char *tfmfile, size_type num_threads ) {
+	//load tunneled fm index
+	t_tfm_index tfm;
+	if (!load_index( tfm, tfmfile )) {
+		cerr << "Unable to open file " << tfmfile << endl;
 		return 1;
 	}
-	
-	//load tunneled fm index
-	tfm_index<> tfm;
-	load_from_file( tfm, argv[1] );
 
 	//reconstruct original string using tunneled fm index
-	char *S = new char[tfm.size()];
-	S[tfm.size()-1] = '\0';
+	size_type n = tfm.size() - 1;
+	char *S = new char[n];
+	tfm.invert( S, num_threads );
 
-	auto p = tfm.end();
-	for (size_type i = 1; i < tfm.size(); i++) {
-		S[tfm.size() - i - 1] = (char)tfm.backwardstep( p );
+	//print result with a single large write
+	for (size_type written = 0; written < n; ) {
+		auto w = write( STDOUT_FILENO, S + written, n - written );
+		if (w <= 0) {
+			cerr << "Unable to write result" << endl;
+			return 1;
+		}
+		written += w;
 	}
-
-	//print result
-	cout << S;
+	delete[] S;
 	return 0;
 }
+
+int main(int argc, char **argv) {
+	//check parameters
+	if (argc < 2) {
+		printUsage( argv );
+		cerr << "At least 1 parameter expected" << endl;
+		return 1;
+	}
+	size_type num_threads = std::max( std::thread::hardware_concurrency(), 1u );
+	bool mapped = false;
+	for (int i = 1; i < argc - 1; i++) {
+		if (strcmp(argv[i], "-t") == 0 && i + 1 < argc - 1) {
+			num_threads = strtoull( argv[++i], nullptr, 10 );
+		} else if (strcmp(argv[i], "-m") == 0) {
+			mapped = true;
+		} else {
+			printUsage( argv );
+			cerr << "Unknown option " << argv[i] << endl;
+			return 1;
+		}
+	}
+	if (num_threads == 0) {
+		printUsage( argv );
+		cerr << "Invalid number of threads" << endl;
+		return 1;
+	}
+	if (mapped) {
+		return invert_index<tfm_index_view>( argv[argc-1], num_threads );
+	}
+	//choose the representation of L stored in the index
+	uint64_t flags;
+	if (!load_tfm_format_flags( argv[argc-1], flags )) {
+		cerr << "Unable to open file " << argv[argc-1] << endl;
+		return 1;
+	}
+	if (flags & tfm_format_fused_nav) {
+		cerr << "Index " << argv[argc-1] << " uses fused navigation bitvectors, which are not supported" << endl;
+		return 1;
+	}
+	if (flags & tfm_format_rle_L) {
+		return invert_index<tfm_index<rle_wt<>>>( argv[argc-1], num_threads );
+	}
+	return invert_index<tfm_index<>>( argv[argc-1], num_threads );
+}
@@ -0,0 +1,78 @@
+/*
+ * tfm_index_view.cpp for BWT Tunneling
+ * Copyright (c) 2020 Uwe Baier All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <iostream>
+#include <string>
+
+#include "rle_wt.hpp"
+#include "tfm_index.hpp"
+#include "tfm_index_view.hpp"
+
+using namespace std;
+using namespace sdsl;
+
+void printUsage( char **argv ) {
+	cerr << "USAGE: " << argv[0] << " TFMFILE VIEWFILE" << endl;
+	cerr << "DESCRIPTION: Program stores a tunneled fm index in a memory-mappable layout, which" << endl;
+	cerr << "  can be used directly from the mapped file (see option -m of tfm_count.x and tfm_index_invert.x)" << endl;
+	cerr << "TFMFILE: a file containing a serialized tunneled fm index" << endl;
+	cerr << "VIEWFILE: file where to store the index in mapped layout" << endl;
+};
+
+//! loads the given tunneled fm index and stores it in mapped layout
+template<class t_tfm_index>
+int store_view( const string &tfmfile, const string &viewfile ) {
+	t_tfm_index tfm;
+	if (!load_from_file( tfm, tfmfile )) {
+		cerr << "Unable to open file " << tfmfile << endl;
+		return 1;
+	}
+	if (!store_to_view_file( tfm, viewfile )) {
+		cerr << "Unable to write file " << viewfile << endl;
+		return 1;
+	}
+	return 0;
+}
+
+int main( int argc, char **argv ) {
+	//check arguments
+	if (argc != 3) {
+		printUsage( argv );
+		return 1;
+	}
+
+	//choose the representation of L stored in the index
+	uint64_t flags;
+	if (!load_tfm_format_flags( argv[1], flags )) {
+		cerr << "Unable to open file " << argv[1] << endl;
+		return 1;
+	}
+	if (flags & tfm_format_fused_nav) {
+		cerr << "Index " << argv[1] << " uses fused navigation bitvectors, which are not supported" << endl;
+		return 1;
+	}
+	if (flags & tfm_format_rle_L) {
+		return store_view<tfm_index<rle_wt<>>>( argv[1], argv[2] );
+	}
+	return store_view<tfm_index<>>( argv[1], argv[2] );
+}
@@ -0,0 +1,159 @@
+/*
+ * tfm_nav_benchmark.cpp for BWT Tunneling
+ * Copyright (c) 2020 Uwe Baier All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <stdlib.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tfm_index.hpp"
+
+using namespace std;
+using namespace sdsl;
+
+typedef tfm_index<> tfm_default_type;
+typedef tfm_index<wt_blcd<>,tfm_fused_nav_bv> tfm_fused_type;
+
+void printUsage( char **argv ) {
+	cerr << "USAGE: " << argv[0] << " [OPTIONS] TFMFILE" << endl;
+	cerr << "DESCRIPTION: Program compares the speed of backward steps of a tunneled fm index" << endl;
+	cerr << "  using separate navigation bitvectors (default) against fused navigation bitvectors," << endl;
+	cerr << "  where din, dout and their rank samples share cache line sized blocks." << endl;
+	cerr << "  Output is written to stdout and contains backward steps per second and index sizes." << endl;
+	cerr << "OPTIONS:" << endl;
+	cerr << "  -r ROUNDS\tRepeat each measurement ROUNDS times and report the best one (default 3)" << endl;
+	cerr << "TFMFILE: a file containing a serialized tunneled fm index (with default configuration)" << endl;
+};
+
+//! converts the default index into an index with fused navigation bitvectors
+void convert( const tfm_default_type &tfm, tfm_fused_type &fused, const string &tfmfile ) {
+	string L_file = tmp_file( tfmfile, "_nav_L" );
+	{
+		int_vector_buffer<8> L_buf( L_file, std::ios::out );
+		for (size_t i = 0; i < tfm.L.size(); i++) {
+			L_buf.push_back( tfm.L[i] );
+		}
+		bit_vector dout( tfm.dout.size() ), din( tfm.din.size() );
+		for (size_t i = 0; i < dout.size(); i++) dout[i] = tfm.dout[i];
+		for (size_t i = 0; i < din.size(); i++) din[i] = tfm.din[i];
+		construct_tfm_index( fused, tfm.size(), std::move( L_buf ), std::move( dout ), std::move( din ) );
+	}
+	sdsl::remove( L_file );
+}
+
+//! walks backwards over the whole string, returns elapsed seconds and a checksum of the visited characters
+template<class t_tfm>
+pair<double,uint64_t> time_walk( const t_tfm &tfm ) {
+	auto start = chrono::steady_clock::now();
+	uint64_t checksum = 0;
+	auto pos = tfm.end();
+	for (size_t i = 1; i < tfm.size(); i++) {
+		checksum = checksum * 31 + tfm.backwardstep( pos );
+	}
+	auto end = chrono::steady_clock::now();
+	return make_pair( chrono::duration<double>( end - start ).count(), checksum );
+}
+
+//! advances k positions spread over the string in lock-step, performing about size() backward steps
+//! in total. Returns elapsed seconds and a checksum of the visited characters
+template<class t_tfm>
+pair<double,uint64_t> time_batch( const t_tfm &tfm, size_t k ) {
+	vector<typename t_tfm::nav_type> pos( k );
+	vector<typename t_tfm::value_type> cs( k );
+	for (size_t j = 0; j < k; j++) {
+		pos[j] = tfm.row_to_nav( (tfm.size() / k) * j );
+	}
+	auto start = chrono::steady_clock::now();
+	uint64_t checksum = 0;
+	for (size_t r = 0; r < tfm.size() / k; r++) {
+		tfm.backwardstep_batch( pos.data(), k, cs.data() );
+		for (size_t j = 0; j < k; j++) {
+			checksum = checksum * 31 + cs[j];
+		}
+	}
+	auto end = chrono::steady_clock::now();
+	return make_pair( chrono::duration<double>( end - start ).count(), checksum );
+}
+
+int main( int argc, char **argv ) {
+	//check arguments
+	size_t rounds = 3;
+	string tfmfile;
+
+	if (argc < 2) {
+		printUsage( argv );
+		return 1;
+	}
+	for (int i = 1; i < argc - 1; i++) {
+		if (argv[i] == string("-r") && i + 1 < argc - 1) {
+			rounds = max( 1L, atol( argv[++i] ) );
+		}
+		else {
+			printUsage( argv );
+			cerr << "Unknown option " << argv[i] << endl;
+			return 1;
+		}
+	}
+	tfmfile = argv[argc-1];
+
+	tfm_default_type tfm;
+	if (!load_from_file( tfm, tfmfile )) {
+		cerr << "Unable to open file " << tfmfile << endl;
+		return 1;
+	}
+	tfm_fused_type fused;
+	convert( tfm, fused, tfmfile );
+
+	//measure, best of all rounds
+	const size_t k = 16 * tfm_default_type::batch_size;
+	double walk[2] = { 1e100, 1e100 }, batch[2] = { 1e100, 1e100 };
+	for (size_t r = 0; r < rounds; r++) {
+		auto wd = time_walk( tfm ), wf = time_walk( fused );
+		auto bd = time_batch( tfm, k ), bf = time_batch( fused, k );
+		if (wd.second != wf.second || bd.second != bf.second) {
+			cerr << "Default and fused index differ, aborting" << endl;
+			return 1;
+		}
+		walk[0] = min( walk[0], wd.first ); walk[1] = min( walk[1], wf.first );
+		batch[0] = min( batch[0], bd.first ); batch[1] = min( batch[1], bf.first );
+	}
+	size_t walk_steps = tfm.size() - 1;
+	size_t batch_steps = (tfm.size() / k) * k;
+
+	cout << "input_length\t" << tfm.size() << endl;
+	cout << "tfm_length\t" << tfm.L.size() << endl;
+	//both indices differ only in their navigation bitvectors
+	size_t nav_size = size_in_bytes( tfm.dout ) + size_in_bytes( tfm.dout_rank ) + size_in_bytes( tfm.dout_select ) +
+	                  size_in_bytes( tfm.din ) + size_in_bytes( tfm.din_rank ) + size_in_bytes( tfm.din_select );
+	cout << "default_nav_size\t" << nav_size << endl;
+	cout << "fused_nav_size\t" << size_in_bytes( fused ) - (size_in_bytes( tfm ) - nav_size) << endl;
+	cout << "default_tfm_index_size\t" << size_in_bytes( tfm ) << endl;
+	cout << "fused_tfm_index_size\t" << size_in_bytes( fused ) << endl;
+	cout << "default_steps_per_second\t" << (size_t)(walk_steps / walk[0]) << endl;
+	cout << "fused_steps_per_second\t" << (size_t)(walk_steps / walk[1]) << endl;
+	cout << "default_batch_steps_per_second\t" << (size_t)(batch_steps / batch[0]) << endl;
+	cout << "fused_batch_steps_per_second\t" << (size_t)(batch_steps / batch[1]) << endl;
+	return 0;
+}